@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cmath>
+
+// Radial basis functors for BasisKernelField. Each one is a stateless struct whose static evaluate() takes the
+// squared distance r2 and the shape parameter eta in the field's scalar type, so a kernel loop instantiated
+// with it inlines the basis completely. POLYNOMIAL_TERMS is the size of the polynomial the interpolant must be
+// augmented with for the kernel system to be solvable (0 for positive definite bases). derivative() is
+// d evaluate / d r2, so the gradient with respect to the point is 2 * derivative() * (x - center).
+//     -eta keeps the meaning it has for the Gaussian, exp(-eta * r^2): the bases scale r by sqrt(eta)
+
+// exp(-eta r^2); positive definite
+struct GaussianBasis
+{
+	static const unsigned int POLYNOMIAL_TERMS = 0u;
+
+	template <typename Scalar>
+	static Scalar evaluate(Scalar r2, Scalar eta)
+	{
+		return std::exp(-eta * r2);
+	}
+
+	template <typename Scalar>
+	static Scalar derivative(Scalar r2, Scalar eta)
+	{
+		return -eta * std::exp(-eta * r2);
+	}
+
+	static const char* getName() { return "gaussian"; }
+};
+
+// 1 / sqrt(1 + eta r^2); positive definite
+struct InverseMultiquadricBasis
+{
+	static const unsigned int POLYNOMIAL_TERMS = 0u;
+
+	template <typename Scalar>
+	static Scalar evaluate(Scalar r2, Scalar eta)
+	{
+		return Scalar(1) / std::sqrt(Scalar(1) + eta * r2);
+	}
+
+	template <typename Scalar>
+	static Scalar derivative(Scalar r2, Scalar eta)
+	{
+		Scalar s = Scalar(1) + eta * r2;
+		return Scalar(-0.5) * eta / (s * std::sqrt(s));
+	}
+
+	static const char* getName() { return "imq"; }
+};
+
+// sqrt(1 + eta r^2); conditionally positive definite of order 1, so a constant is added
+struct MultiquadricBasis
+{
+	static const unsigned int POLYNOMIAL_TERMS = 1u;
+
+	template <typename Scalar>
+	static Scalar evaluate(Scalar r2, Scalar eta)
+	{
+		return std::sqrt(Scalar(1) + eta * r2);
+	}
+
+	template <typename Scalar>
+	static Scalar derivative(Scalar r2, Scalar eta)
+	{
+		return Scalar(0.5) * eta / std::sqrt(Scalar(1) + eta * r2);
+	}
+
+	static const char* getName() { return "mq"; }
+};
+
+// r^2 log r, scale free (eta unused); conditionally positive definite of order 2, so 1, x, y and z are added
+struct ThinPlateBasis
+{
+	static const unsigned int POLYNOMIAL_TERMS = 4u;
+
+	template <typename Scalar>
+	static Scalar evaluate(Scalar r2, Scalar)
+	{
+		// r^2 log r = r^2 log(r^2) / 2, which tends to 0 at r = 0
+		return r2 > Scalar(0) ? Scalar(0.5) * r2 * std::log(r2) : Scalar(0);
+	}
+
+	// (log(r^2) + 1) / 2; the log singularity is multiplied by x - center = 0 at r = 0
+	template <typename Scalar>
+	static Scalar derivative(Scalar r2, Scalar)
+	{
+		return r2 > Scalar(0) ? Scalar(0.5) * (std::log(r2) + Scalar(1)) : Scalar(0);
+	}
+
+	static const char* getName() { return "tps"; }
+};
+
+// Wendland C2 (1 - r)^4 (4r + 1) with support radius 1 / sqrt(eta); positive definite in 3D
+struct WendlandC2Basis
+{
+	static const unsigned int POLYNOMIAL_TERMS = 0u;
+
+	template <typename Scalar>
+	static Scalar evaluate(Scalar r2, Scalar eta)
+	{
+		Scalar r = std::sqrt(eta * r2);
+		Scalar t = r < Scalar(1) ? Scalar(1) - r : Scalar(0);
+		Scalar t2 = t * t;
+
+		return t2 * t2 * (Scalar(4) * r + Scalar(1));
+	}
+
+	// d/dr is -20 r (1 - r)^3 and dr/d(r^2) is eta / (2 r), so the r cancels
+	template <typename Scalar>
+	static Scalar derivative(Scalar r2, Scalar eta)
+	{
+		Scalar r = std::sqrt(eta * r2);
+		Scalar t = r < Scalar(1) ? Scalar(1) - r : Scalar(0);
+
+		return Scalar(-10) * eta * t * t * t;
+	}
+
+	static const char* getName() { return "wendland2"; }
+};
@@ -0,0 +1,290 @@
+#pragma once
+
+#include <vector>
+#include <chrono>
+
+#include <glm/glm.hpp>
+
+#include <Eigen/Dense>
+
+#include "KernelField.h"
+
+// KernelField for a compile-time basis functor (see BasisFunctions.h) and scalar type. Centers and weights
+// are kept as structure-of-arrays in Scalar, and the evaluation loop over them is plain arithmetic on those
+// arrays with the basis inlined, which the compiler vectorizes for the instantiated type. Bases that need
+// it get their polynomial term solved for along with the weights (the usual saddle point system).
+template <typename Basis, typename Scalar>
+class BasisKernelField : public KernelField
+{
+public:
+	typedef Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> Matrix;
+
+	static const unsigned int POLYNOMIAL_TERMS = Basis::POLYNOMIAL_TERMS;
+
+	// Independent partial sums per point, one 256-bit register of Scalar; the center arrays are padded to a
+	// multiple of this with zero-weight centers
+	static const unsigned int LANES = 32u / sizeof(Scalar);
+
+public:
+	BasisKernelField()
+		: m_Eta(1)
+		, m_pFactorization("none")
+		, m_dFitSeconds(0.0)
+	{
+		m_matPolynomial = Matrix::Zero(POLYNOMIAL_TERMS, 3);
+	}
+
+	bool fit(const std::vector<glm::vec3> &positions, const Eigen::MatrixXf &values, float eta, float mu) override
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+
+		Eigen::Index n = static_cast<Eigen::Index>(positions.size());
+		Eigen::Index m = n + POLYNOMIAL_TERMS;
+
+		m_Eta = static_cast<Scalar>(eta);
+
+		size_t padded = ((static_cast<size_t>(n) + LANES - 1u) / LANES) * LANES;
+
+		m_vX.assign(padded, Scalar(0));
+		m_vY.assign(padded, Scalar(0));
+		m_vZ.assign(padded, Scalar(0));
+		for (Eigen::Index i = 0; i < n; ++i)
+		{
+			m_vX[i] = static_cast<Scalar>(positions[i].x);
+			m_vY[i] = static_cast<Scalar>(positions[i].y);
+			m_vZ[i] = static_cast<Scalar>(positions[i].z);
+		}
+
+		// [K + mu I, P; P^T, 0] [lambda; c] = [F; 0], with P the polynomial terms at the centers
+		Matrix system = Matrix::Zero(m, m);
+		for (Eigen::Index i = 0; i < n; ++i)
+		{
+			system(i, i) = Basis::evaluate(Scalar(0), m_Eta) + static_cast<Scalar>(mu);
+			for (Eigen::Index j = 0; j < i; ++j)
+			{
+				Scalar dx = m_vX[i] - m_vX[j];
+				Scalar dy = m_vY[i] - m_vY[j];
+				Scalar dz = m_vZ[i] - m_vZ[j];
+				system(i, j) = system(j, i) = Basis::evaluate(dx * dx + dy * dy + dz * dz, m_Eta);
+			}
+
+			Scalar monomials[4] = { Scalar(1), m_vX[i], m_vY[i], m_vZ[i] };
+			for (unsigned int k = 0u; k < POLYNOMIAL_TERMS; ++k)
+				system(i, n + k) = system(n + k, i) = monomials[k];
+		}
+
+		Matrix rhs = Matrix::Zero(m, 3);
+		rhs.topRows(n) = values.cast<Scalar>();
+
+		Matrix solution;
+		bool solved = false;
+
+		// positive definite kernels try Cholesky first; the saddle point systems are indefinite by construction
+		if (POLYNOMIAL_TERMS == 0u)
+		{
+			Eigen::LLT<Matrix> llt(system);
+			if (llt.info() == Eigen::Success)
+			{
+				solution = llt.solve(rhs);
+				solved = solution.allFinite();
+				m_pFactorization = "LLT";
+			}
+		}
+
+		if (!solved)
+		{
+			Eigen::PartialPivLU<Matrix> lu(system);
+			solution = lu.solve(rhs);
+			solved = solution.allFinite();
+			m_pFactorization = "PartialPivLU";
+		}
+
+		if (!solved)
+			solution = Matrix::Zero(m, 3);
+
+		m_vLambdaX.assign(padded, Scalar(0));
+		m_vLambdaY.assign(padded, Scalar(0));
+		m_vLambdaZ.assign(padded, Scalar(0));
+		for (Eigen::Index i = 0; i < n; ++i)
+		{
+			m_vLambdaX[i] = solution(i, 0);
+			m_vLambdaY[i] = solution(i, 1);
+			m_vLambdaZ[i] = solution(i, 2);
+		}
+
+		m_matPolynomial = solution.bottomRows(POLYNOMIAL_TERMS);
+
+		m_dFitSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		return solved;
+	}
+
+	void evaluate(const float *xyz, size_t n, float *out) const override
+	{
+		const size_t nCenters = m_vX.size(); // padded
+		const Scalar eta = m_Eta;
+
+		const Scalar *cx = m_vX.data();
+		const Scalar *cy = m_vY.data();
+		const Scalar *cz = m_vZ.data();
+		const Scalar *lx = m_vLambdaX.data();
+		const Scalar *ly = m_vLambdaY.data();
+		const Scalar *lz = m_vLambdaZ.data();
+
+		for (size_t i = 0u; i < n; ++i)
+		{
+			const Scalar px = static_cast<Scalar>(xyz[3u * i + 0u]);
+			const Scalar py = static_cast<Scalar>(xyz[3u * i + 1u]);
+			const Scalar pz = static_cast<Scalar>(xyz[3u * i + 2u]);
+
+			Scalar accX[LANES], accY[LANES], accZ[LANES];
+			for (unsigned int l = 0u; l < LANES; ++l)
+				accX[l] = accY[l] = accZ[l] = Scalar(0);
+
+			// no calls once Basis::evaluate is inlined, and each lane sums its own centers in order, so the inner
+			// loop maps onto vector registers without reassociating any floating point sum
+			for (size_t j = 0u; j < nCenters; j += LANES)
+			{
+				for (unsigned int l = 0u; l < LANES; ++l)
+				{
+					Scalar dx = px - cx[j + l];
+					Scalar dy = py - cy[j + l];
+					Scalar dz = pz - cz[j + l];
+					Scalar phi = Basis::evaluate(dx * dx + dy * dy + dz * dz, eta);
+
+					accX[l] += phi * lx[j + l];
+					accY[l] += phi * ly[j + l];
+					accZ[l] += phi * lz[j + l];
+				}
+			}
+
+			Scalar sumX(0), sumY(0), sumZ(0);
+			for (unsigned int l = 0u; l < LANES; ++l)
+			{
+				sumX += accX[l];
+				sumY += accY[l];
+				sumZ += accZ[l];
+			}
+
+			Scalar monomials[4] = { Scalar(1), px, py, pz };
+			for (unsigned int k = 0u; k < POLYNOMIAL_TERMS; ++k)
+			{
+				sumX += monomials[k] * m_matPolynomial(k, 0);
+				sumY += monomials[k] * m_matPolynomial(k, 1);
+				sumZ += monomials[k] * m_matPolynomial(k, 2);
+			}
+
+			out[3u * i + 0u] = static_cast<float>(sumX);
+			out[3u * i + 1u] = static_cast<float>(sumY);
+			out[3u * i + 2u] = static_cast<float>(sumZ);
+		}
+	}
+
+	void evaluateJacobian(const float *xyz, size_t n, float *out, float *jacobian) const override
+	{
+		const size_t nCenters = m_vX.size(); // padded
+		const Scalar eta = m_Eta;
+
+		const Scalar *centers[3] = { m_vX.data(), m_vY.data(), m_vZ.data() };
+		const Scalar *lambdas[3] = { m_vLambdaX.data(), m_vLambdaY.data(), m_vLambdaZ.data() };
+
+		for (size_t i = 0u; i < n; ++i)
+		{
+			const Scalar p[3] = { static_cast<Scalar>(xyz[3u * i + 0u]), static_cast<Scalar>(xyz[3u * i + 1u]), static_cast<Scalar>(xyz[3u * i + 2u]) };
+
+			// per lane: the value sums and the gradient moments sum lambda_c * basis'(r2) * (p_d - center_d)
+			Scalar acc[3][LANES], moment[9][LANES];
+			for (unsigned int l = 0u; l < LANES; ++l)
+			{
+				for (unsigned int c = 0u; c < 3u; ++c)
+					acc[c][l] = Scalar(0);
+				for (unsigned int k = 0u; k < 9u; ++k)
+					moment[k][l] = Scalar(0);
+			}
+
+			for (size_t j = 0u; j < nCenters; j += LANES)
+			{
+				for (unsigned int l = 0u; l < LANES; ++l)
+				{
+					Scalar d[3];
+					for (unsigned int k = 0u; k < 3u; ++k)
+						d[k] = p[k] - centers[k][j + l];
+
+					Scalar r2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+					Scalar phi = Basis::evaluate(r2, eta);
+					Scalar dPhi = Basis::derivative(r2, eta);
+
+					for (unsigned int c = 0u; c < 3u; ++c)
+					{
+						Scalar lambda = lambdas[c][j + l];
+						acc[c][l] += phi * lambda;
+						for (unsigned int k = 0u; k < 3u; ++k)
+							moment[3u * c + k][l] += dPhi * lambda * d[k];
+					}
+				}
+			}
+
+			for (unsigned int c = 0u; c < 3u; ++c)
+			{
+				Scalar sum(0);
+				for (unsigned int l = 0u; l < LANES; ++l)
+					sum += acc[c][l];
+
+				// the polynomial is 1, x, y, z: its value, and the x, y and z coefficients as its gradient
+				Scalar monomials[4] = { Scalar(1), p[0], p[1], p[2] };
+				for (unsigned int k = 0u; k < POLYNOMIAL_TERMS; ++k)
+					sum += monomials[k] * m_matPolynomial(k, c);
+
+				out[3u * i + c] = static_cast<float>(sum);
+
+				for (unsigned int k = 0u; k < 3u; ++k)
+				{
+					Scalar gradient(0);
+					for (unsigned int l = 0u; l < LANES; ++l)
+						gradient += moment[3u * c + k][l];
+					gradient *= Scalar(2);
+
+					if (k + 1u < POLYNOMIAL_TERMS)
+						gradient += m_matPolynomial(k + 1u, c);
+
+					jacobian[9u * i + 3u * c + k] = static_cast<float>(gradient);
+				}
+			}
+		}
+	}
+
+	const char* getName() const override
+	{
+		return "kernel field";
+	}
+
+	const char* getBasisName() const override
+	{
+		return Basis::getName();
+	}
+
+	const char* getScalarName() const override
+	{
+		return sizeof(Scalar) == sizeof(double) ? "double" : "float";
+	}
+
+	const char* getFactorization() const override
+	{
+		return m_pFactorization;
+	}
+
+	double getFitSeconds() const override
+	{
+		return m_dFitSeconds;
+	}
+
+private:
+	Scalar m_Eta;
+
+	std::vector<Scalar> m_vX, m_vY, m_vZ;
+	std::vector<Scalar> m_vLambdaX, m_vLambdaY, m_vLambdaZ;
+	Matrix m_matPolynomial; // POLYNOMIAL_TERMS x 3
+
+	const char *m_pFactorization;
+	double m_dFitSeconds;
+};
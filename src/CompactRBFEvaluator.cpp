@@ -0,0 +1,131 @@
+#include "CompactRBFEvaluator.h"
+
+#include <cmath>
+
+CompactRBFEvaluator::CompactRBFEvaluator()
+	: m_eBasis(WENDLAND_C2)
+	, m_fSupportRadius(1.f)
+{
+}
+
+CompactRBFEvaluator::~CompactRBFEvaluator()
+{
+}
+
+void CompactRBFEvaluator::setControlPoints(const std::vector<glm::vec3> &positions, const Eigen::VectorXf &lambdaX, const Eigen::VectorXf &lambdaY, const Eigen::VectorXf &lambdaZ, Basis basis, float supportRadius)
+{
+	m_eBasis = basis;
+	m_fSupportRadius = supportRadius;
+
+	m_Grid.build(positions, supportRadius);
+
+	const std::vector<unsigned int> &order = m_Grid.getOrder();
+	size_t n = order.size();
+
+	m_vX.resize(n);
+	m_vY.resize(n);
+	m_vZ.resize(n);
+	m_vLambdaX.resize(n);
+	m_vLambdaY.resize(n);
+	m_vLambdaZ.resize(n);
+
+	for (size_t s = 0u; s < n; ++s)
+	{
+		unsigned int i = order[s];
+		m_vX[s] = positions[i].x;
+		m_vY[s] = positions[i].y;
+		m_vZ[s] = positions[i].z;
+		m_vLambdaX[s] = lambdaX[i];
+		m_vLambdaY[s] = lambdaY[i];
+		m_vLambdaZ[s] = lambdaZ[i];
+	}
+}
+
+void CompactRBFEvaluator::evaluate(const float *xyz, size_t n, float *out) const
+{
+	const float invRadius = 1.f / m_fSupportRadius;
+	const Basis basis = m_eBasis;
+
+	for (size_t i = 0u; i < n; ++i)
+	{
+		const float px = xyz[3u * i + 0u];
+		const float py = xyz[3u * i + 1u];
+		const float pz = xyz[3u * i + 2u];
+
+		float sumX = 0.f, sumY = 0.f, sumZ = 0.f;
+
+		m_Grid.forEachCellRange(glm::vec3(px, py, pz), [&](unsigned int begin, unsigned int end) {
+			for (unsigned int s = begin; s < end; ++s)
+			{
+				float dx = px - m_vX[s];
+				float dy = py - m_vY[s];
+				float dz = pz - m_vZ[s];
+				float r = std::sqrt(dx * dx + dy * dy + dz * dz) * invRadius;
+
+				// neighboring cells also hold centers just beyond the support, which basisFunction zeroes
+				float phi = basisFunction(basis, r);
+
+				sumX += phi * m_vLambdaX[s];
+				sumY += phi * m_vLambdaY[s];
+				sumZ += phi * m_vLambdaZ[s];
+			}
+		});
+
+		out[3u * i + 0u] = sumX;
+		out[3u * i + 1u] = sumY;
+		out[3u * i + 2u] = sumZ;
+	}
+}
+
+const char* CompactRBFEvaluator::getName() const
+{
+	return "compact";
+}
+
+const SpatialGrid& CompactRBFEvaluator::getSpatialGrid() const
+{
+	return m_Grid;
+}
+
+float CompactRBFEvaluator::basisFunction(Basis basis, float r)
+{
+	if (r >= 1.f)
+		return 0.f;
+
+	float t = 1.f - r;
+	float t2 = t * t;
+
+	if (basis == WENDLAND_C4)
+		return t2 * t2 * t2 * (35.f * r * r + 18.f * r + 3.f) * (1.f / 3.f);
+
+	return t2 * t2 * (4.f * r + 1.f);
+}
+
+void CompactRBFEvaluator::assembleKernel(const std::vector<glm::vec3> &positions, Basis basis, float supportRadius, Eigen::SparseMatrix<float> &kernel)
+{
+	float invRadius = 1.f / supportRadius;
+
+	SpatialGrid grid;
+	grid.build(positions, supportRadius);
+
+	const std::vector<unsigned int> &order = grid.getOrder();
+
+	// each center visits the centers in its neighboring cells, which yields both (i, j) and (j, i)
+	std::vector<Eigen::Triplet<float>> entries;
+	for (unsigned int i = 0u; i < positions.size(); ++i)
+	{
+		grid.forEachCellRange(positions[i], [&](unsigned int begin, unsigned int end) {
+			for (unsigned int s = begin; s < end; ++s)
+			{
+				unsigned int j = order[s];
+				float phi = basisFunction(basis, glm::length(positions[i] - positions[j]) * invRadius);
+
+				if (phi > 0.f)
+					entries.push_back(Eigen::Triplet<float>(i, j, phi));
+			}
+		});
+	}
+
+	kernel.resize(positions.size(), positions.size());
+	kernel.setFromTriplets(entries.begin(), entries.end());
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+
+#include "FieldEvaluator.h"
+#include "SpatialGrid.h"
+
+// Evaluates an RBF vector field built from compactly supported Wendland functions. Each center only
+// influences points within the support radius, so a SpatialGrid over the centers limits every
+// evaluation to the centers in neighboring cells and the cost follows local density instead of N.
+class CompactRBFEvaluator : public FieldEvaluator
+{
+public:
+	// Wendland functions positive definite in 3D, scaled to 1 at r = 0 (r normalized by the support radius)
+	enum Basis {
+		WENDLAND_C2, // (1 - r)^4 (4r + 1)
+		WENDLAND_C4  // (1 - r)^6 (35r^2 + 18r + 3) / 3
+	};
+
+public:
+	CompactRBFEvaluator();
+	~CompactRBFEvaluator();
+
+	void setControlPoints(const std::vector<glm::vec3> &positions, const Eigen::VectorXf &lambdaX, const Eigen::VectorXf &lambdaY, const Eigen::VectorXf &lambdaZ, Basis basis, float supportRadius);
+
+	void evaluate(const float *xyz, size_t n, float *out) const override;
+
+	const char* getName() const override;
+
+	const SpatialGrid& getSpatialGrid() const;
+
+	// Basis value at normalized distance r (0 for r >= 1)
+	static float basisFunction(Basis basis, float r);
+
+	// Sparse N x N kernel of the centers: only pairs closer than the support radius have entries
+	static void assembleKernel(const std::vector<glm::vec3> &positions, Basis basis, float supportRadius, Eigen::SparseMatrix<float> &kernel);
+
+private:
+	Basis m_eBasis;
+	float m_fSupportRadius;
+
+	SpatialGrid m_Grid;
+
+	// centers and weights in the grid's sorted order, so the centers of one cell are contiguous
+	std::vector<float> m_vX, m_vY, m_vZ;
+	std::vector<float> m_vLambdaX, m_vLambdaY, m_vLambdaZ;
+};
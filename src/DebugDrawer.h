@@ -67,6 +67,13 @@ public:
 		m_bNeedsRefresh = true;
 	}
 
+	// Draw the segments joining count consecutive points, each colored by its direction like a flow trail
+	void drawTrail(const glm::vec3 *points, size_t count)
+	{
+		for (size_t i = 1u; i < count; ++i)
+			drawLine(points[i - 1u], points[i], glm::normalize(points[i] - points[i - 1u]));
+	}
+
 	void drawTriangle(const glm::vec3 &v0, const glm::vec3 &v1, const glm::vec3 &v2, const glm::vec3 &color)
 	{
 		drawLine(v0, v1, color);
@@ -0,0 +1,904 @@
+#include "Diagnostics.h"
+
+#include <iostream>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <cstdio>
+
+#include "RBFEvaluator.h"
+#include "FGTEvaluator.h"
+#include "FixedRBFEvaluator.h"
+#include "KernelField.h"
+#include "ParticleIntegrator.h"
+#include "RBFSolver.h"
+#include "ThreadPool.h"
+#include "VectorFieldGenerator.h"
+#include "TrajectoryFile.h"
+
+bool Diagnostics::checkSIMDEquivalence(unsigned int nTrials)
+{
+	const float tolerance = 1e-5f;
+	const unsigned int nSamples = 64u;
+
+	std::mt19937 rng(1234u);
+	std::uniform_real_distribution<float> unitDist(-1.f, 1.f);
+	std::uniform_real_distribution<float> lambdaDist(-10.f, 10.f);
+	std::uniform_real_distribution<float> etaDist(0.1f, 20.f);
+	std::uniform_int_distribution<unsigned int> countDist(1u, 300u);
+
+	RBFEvaluator scalar, simd;
+	scalar.setISA(RBFEvaluator::ISA_SCALAR);
+
+	bool passed = true;
+
+	for (int isa = RBFEvaluator::ISA_SSE4; isa <= RBFEvaluator::ISA_AVX512; ++isa)
+	{
+		RBFEvaluator::ISA thisISA = static_cast<RBFEvaluator::ISA>(isa);
+
+		if (!RBFEvaluator::isSupported(thisISA))
+		{
+			std::cout << RBFEvaluator::getISAName(thisISA) << " kernel: not supported on this CPU, skipped" << std::endl;
+			continue;
+		}
+
+		simd.setISA(thisISA);
+
+		float maxError = 0.f;
+
+		for (unsigned int trial = 0u; trial < nTrials; ++trial)
+		{
+			unsigned int n = countDist(rng);
+			float eta = etaDist(rng);
+
+			std::vector<glm::vec3> positions(n);
+			Eigen::VectorXf lx(n), ly(n), lz(n);
+			float lambdaMagnitude = 0.f;
+			for (unsigned int i = 0u; i < n; ++i)
+			{
+				positions[i] = glm::vec3(unitDist(rng), unitDist(rng), unitDist(rng));
+				lx(i) = lambdaDist(rng);
+				ly(i) = lambdaDist(rng);
+				lz(i) = lambdaDist(rng);
+				lambdaMagnitude += std::max(std::abs(lx(i)), std::max(std::abs(ly(i)), std::abs(lz(i))));
+			}
+
+			scalar.setControlPoints(positions, lx, ly, lz, eta);
+			simd.setControlPoints(positions, lx, ly, lz, eta);
+
+			// sample slightly outside the cube too, where the basis values get tiny
+			glm::vec3 pts[nSamples], batched[nSamples];
+			for (unsigned int s = 0u; s < nSamples; ++s)
+				pts[s] = 1.5f * glm::vec3(unitDist(rng), unitDist(rng), unitDist(rng));
+
+			// the batch goes through the packet kernel, single points through the per-point one
+			simd.evaluate(&pts[0].x, nSamples, &batched[0].x);
+
+			for (unsigned int s = 0u; s < nSamples; ++s)
+			{
+				glm::vec3 reference = scalar.interpolate(pts[s]);
+				glm::vec3 diff = glm::max(glm::abs(simd.interpolate(pts[s]) - reference), glm::abs(batched[s] - reference));
+
+				// error relative to the largest possible magnitude of the sum, since terms can cancel
+				float err = std::max(diff.x, std::max(diff.y, diff.z)) / lambdaMagnitude;
+				maxError = std::max(maxError, err);
+			}
+		}
+
+		bool ok = maxError <= tolerance;
+		passed = passed && ok;
+
+		std::cout << RBFEvaluator::getISAName(thisISA) << " kernel: max relative error " << maxError << " over " << nTrials << " layouts -> " << (ok ? "PASS" : "FAIL") << std::endl;
+	}
+
+	std::cout << "Active kernel: " << RBFEvaluator::getISAName(RBFEvaluator::detectISA()) << std::endl;
+
+	return passed;
+}
+
+void Diagnostics::benchmarkSolvers(float regularization)
+{
+	const unsigned int sizes[] = { 6u, 32u, 100u, 316u, 1000u, 2000u, 3162u, 10000u };
+	const float eta = 1.2f;
+
+	// a float Gaussian kernel over a few thousand random points in the cube is numerically singular, so
+	// unregularized solves fall back to full-pivot LU; those are only run up to this size
+	const unsigned int maxUnregularized = 2000u;
+
+	if (regularization <= 0.f)
+		regularization = 1e-3f;
+
+	std::mt19937 rng(1234u);
+	std::uniform_real_distribution<float> unitDist(-1.f, 1.f);
+
+	RBFSolver solver;
+	ThreadPool pool;
+
+	std::cout << "Kernel solve benchmark (eta = " << eta << ")" << std::endl;
+	std::cout << std::setw(8) << "N" << std::setw(10) << "mu" << std::setw(12) << "method" << std::setw(12) << "solved by" << std::setw(14) << "assemble s" << std::setw(14) << "factor s" << std::setw(14) << "solve s" << std::setw(16) << "condition" << std::setw(14) << "max residual" << std::endl;
+
+	for (unsigned int n : sizes)
+	{
+		std::vector<glm::vec3> positions(n);
+		Eigen::MatrixXf rhs(n, 3);
+		for (unsigned int i = 0u; i < n; ++i)
+		{
+			positions[i] = glm::vec3(unitDist(rng), unitDist(rng), unitDist(rng));
+			rhs.row(i) << unitDist(rng), unitDist(rng), unitDist(rng);
+		}
+
+		auto start = std::chrono::high_resolution_clock::now();
+
+		Eigen::MatrixXf kernel(n, n);
+		for (unsigned int i = 0u; i < n; ++i)
+		{
+			kernel(i, i) = 1.f;
+			for (unsigned int j = 0u; j < i; ++j)
+			{
+				glm::vec3 d = positions[i] - positions[j];
+				kernel(i, j) = kernel(j, i) = std::exp(-eta * glm::dot(d, d));
+			}
+		}
+
+		double assembleSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		const float mus[] = { 0.f, regularization };
+		for (float mu : mus)
+		{
+			if (mu == 0.f && n > maxUnregularized)
+				continue;
+
+			solver.setRegularization(mu);
+
+			for (int method = RBFSolver::METHOD_FULL_PIV_LU; method <= RBFSolver::METHOD_LDLT; ++method)
+			{
+				if (method == RBFSolver::METHOD_FULL_PIV_LU && n > maxUnregularized)
+					continue;
+
+				solver.setMethod(static_cast<RBFSolver::Method>(method));
+
+				Eigen::MatrixXf lambdas;
+				bool ok = solver.solve(kernel, rhs, lambdas);
+				const RBFSolver::Report &report = solver.getReport();
+
+				float residual = ok ? (kernel * lambdas + mu * lambdas - rhs).cwiseAbs().maxCoeff() : -1.f;
+
+				std::cout << std::setw(8) << n
+					<< std::setw(10) << mu
+					<< std::setw(12) << RBFSolver::getMethodName(static_cast<RBFSolver::Method>(method))
+					<< std::setw(12) << (ok ? RBFSolver::getMethodName(report.method) : "FAILED")
+					<< std::setw(14) << assembleSeconds
+					<< std::setw(14) << report.factorSeconds
+					<< std::setw(14) << report.solveSeconds
+					<< std::setw(16) << report.conditionEstimate
+					<< std::setw(14) << residual << std::endl;
+			}
+
+			// the matrix-free solver is only preconditioned with mu > 0, and plain CG stalls on the unregularized kernel
+			if (mu > 0.f)
+			{
+				solver.setMethod(RBFSolver::METHOD_CG);
+
+				Eigen::MatrixXf lambdas;
+				bool ok = solver.solveMatrixFree(positions, eta, rhs, lambdas, pool);
+				const RBFSolver::Report &report = solver.getReport();
+
+				float residual = (kernel * lambdas + mu * lambdas - rhs).cwiseAbs().maxCoeff();
+
+				std::cout << std::setw(8) << n
+					<< std::setw(10) << mu
+					<< std::setw(12) << "CG"
+					<< std::setw(12) << (ok ? "CG" : "STALLED")
+					<< std::setw(14) << 0.0
+					<< std::setw(14) << report.factorSeconds
+					<< std::setw(14) << report.solveSeconds
+					<< std::setw(16) << report.iterations
+					<< std::setw(14) << residual << std::endl;
+			}
+		}
+	}
+}
+
+bool Diagnostics::checkFGTAccuracy(float tolerance)
+{
+	const float etas[] = { 1.2f, 5.f, 20.f };
+	const unsigned int sizes[] = { 100u, 1000u, 10000u, 100000u };
+	const size_t nTargets = 4096u;
+
+	std::mt19937 rng(1234u);
+	std::uniform_real_distribution<float> unitDist(-1.f, 1.f);
+
+	RBFEvaluator direct;
+	FGTEvaluator fgt;
+
+	bool passed = true;
+
+	std::cout << "Fast Gauss Transform accuracy (tolerance " << tolerance << ", " << nTargets << " targets in [-1.1, 1.1]^3)" << std::endl;
+	std::cout << std::setw(8) << "eta" << std::setw(9) << "N" << std::setw(7) << "boxes" << std::setw(7) << "order" << std::setw(14) << "bound" << std::setw(14) << "max error" << std::setw(12) << "setup s" << std::setw(12) << "fgt s" << std::setw(12) << "direct s" << std::endl;
+
+	for (float eta : etas)
+	{
+		for (unsigned int n : sizes)
+		{
+			std::vector<glm::vec3> positions(n);
+			Eigen::VectorXf lx(n), ly(n), lz(n);
+			for (unsigned int i = 0u; i < n; ++i)
+			{
+				positions[i] = glm::vec3(unitDist(rng), unitDist(rng), unitDist(rng));
+				lx(i) = unitDist(rng);
+				ly(i) = unitDist(rng);
+				lz(i) = unitDist(rng);
+			}
+
+			std::vector<float> targets(3u * nTargets);
+			for (auto &t : targets)
+				t = 1.1f * unitDist(rng);
+
+			std::vector<float> expected(3u * nTargets), approximated(3u * nTargets);
+
+			auto start = std::chrono::high_resolution_clock::now();
+			fgt.setControlPoints(positions, lx, ly, lz, eta, tolerance);
+			double setupSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+			start = std::chrono::high_resolution_clock::now();
+			fgt.evaluate(targets.data(), nTargets, approximated.data());
+			double fgtSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+			direct.setControlPoints(positions, lx, ly, lz, eta);
+
+			start = std::chrono::high_resolution_clock::now();
+			direct.evaluate(targets.data(), nTargets, expected.data());
+			double directSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+			// the bound is per component, relative to that component's sum |lambda|
+			float lambdaSums[3] = { lx.cwiseAbs().sum(), ly.cwiseAbs().sum(), lz.cwiseAbs().sum() };
+
+			float maxError = 0.f;
+			for (size_t i = 0u; i < 3u * nTargets; ++i)
+				maxError = std::max(maxError, std::abs(approximated[i] - expected[i]) / lambdaSums[i % 3u]);
+
+			bool ok = maxError <= fgt.getErrorBound();
+			passed = passed && ok;
+
+			std::cout << std::setw(8) << eta
+				<< std::setw(9) << n
+				<< std::setw(7) << fgt.getClusterCount()
+				<< std::setw(7) << fgt.getOrder()
+				<< std::setw(14) << fgt.getErrorBound()
+				<< std::setw(14) << maxError
+				<< std::setw(12) << setupSeconds
+				<< std::setw(12) << fgtSeconds
+				<< std::setw(12) << directSeconds
+				<< (ok ? "" : "  FAIL") << std::endl;
+		}
+	}
+
+	std::cout << "Fast Gauss Transform accuracy: " << (passed ? "PASS" : "FAIL") << std::endl;
+
+	return passed;
+}
+
+namespace
+{
+	// Largest Jacobian difference relative to the largest Jacobian entry, and the largest value difference
+	// relative to the largest value, between a fused evaluation and the finite difference fallback
+	bool compareJacobian(const char *name, const FieldEvaluator &field, const std::vector<float> &points)
+	{
+		const float tolerance = 2e-3f;
+		size_t n = points.size() / 3u;
+
+		std::vector<float> value(3u * n), fusedValue(3u * n), fused(9u * n), differenced(9u * n), differencedValue(3u * n);
+
+		field.evaluate(points.data(), n, value.data());
+
+		auto start = std::chrono::high_resolution_clock::now();
+		field.evaluateJacobian(points.data(), n, fusedValue.data(), fused.data());
+		double fusedSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		start = std::chrono::high_resolution_clock::now();
+		field.FieldEvaluator::evaluateJacobian(points.data(), n, differencedValue.data(), differenced.data());
+		double differencedSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		float maxValue = 0.f, maxValueError = 0.f, maxEntry = 0.f, maxError = 0.f;
+		for (size_t i = 0u; i < 3u * n; ++i)
+		{
+			maxValue = std::max(maxValue, std::abs(value[i]));
+			maxValueError = std::max(maxValueError, std::abs(fusedValue[i] - value[i]));
+		}
+		for (size_t i = 0u; i < 9u * n; ++i)
+		{
+			maxEntry = std::max(maxEntry, std::abs(differenced[i]));
+			maxError = std::max(maxError, std::abs(fused[i] - differenced[i]));
+		}
+
+		float valueError = maxValue > 0.f ? maxValueError / maxValue : maxValueError;
+		float jacobianError = maxEntry > 0.f ? maxError / maxEntry : maxError;
+		bool ok = valueError <= 1e-5f && jacobianError <= tolerance;
+
+		std::cout << std::setw(22) << name
+			<< std::setw(14) << valueError
+			<< std::setw(14) << jacobianError
+			<< std::setw(12) << fusedSeconds
+			<< std::setw(12) << differencedSeconds
+			<< (ok ? "" : "  FAIL") << std::endl;
+
+		return ok;
+	}
+}
+
+bool Diagnostics::checkJacobian()
+{
+	const unsigned int sizes[] = { 6u, 100u, 1000u };
+	const size_t nTargets = 4096u;
+	const float eta = 1.2f;
+
+	std::mt19937 rng(1234u);
+	std::uniform_real_distribution<float> unitDist(-1.f, 1.f);
+
+	std::vector<float> targets(3u * nTargets);
+	for (auto &t : targets)
+		t = unitDist(rng);
+
+	bool passed = true;
+
+	std::cout << "Fused Jacobian against central differences (" << nTargets << " targets in [-1, 1]^3)" << std::endl;
+	std::cout << std::setw(22) << "field" << std::setw(14) << "value error" << std::setw(14) << "jacobian err" << std::setw(12) << "fused s" << std::setw(12) << "differ s" << std::endl;
+
+	for (unsigned int n : sizes)
+	{
+		std::vector<glm::vec3> positions(n), directions(n);
+		Eigen::VectorXf lx(n), ly(n), lz(n);
+		Eigen::MatrixXf values(n, 3);
+		for (unsigned int i = 0u; i < n; ++i)
+		{
+			positions[i] = glm::vec3(unitDist(rng), unitDist(rng), unitDist(rng));
+			directions[i] = glm::vec3(unitDist(rng), unitDist(rng), unitDist(rng));
+			lx(i) = unitDist(rng);
+			ly(i) = unitDist(rng);
+			lz(i) = unitDist(rng);
+			values.row(i) << directions[i].x, directions[i].y, directions[i].z;
+		}
+
+		std::cout << "N = " << n << std::endl;
+
+		RBFEvaluator direct;
+		direct.setControlPoints(positions, lx, ly, lz, eta);
+		for (int isa = RBFEvaluator::ISA_SCALAR; isa <= RBFEvaluator::ISA_AVX512; ++isa)
+		{
+			RBFEvaluator::ISA thisISA = static_cast<RBFEvaluator::ISA>(isa);
+			if (!RBFEvaluator::isSupported(thisISA))
+				continue;
+
+			direct.setISA(thisISA);
+			passed = compareJacobian(RBFEvaluator::getISAName(thisISA), direct, targets) && passed;
+		}
+
+		std::unique_ptr<FixedRBFEvaluatorBase> fixed = FixedRBFEvaluatorBase::create(n);
+		if (fixed)
+		{
+			fixed->fit(positions.data(), directions.data(), n, eta, 0.f);
+			passed = compareJacobian("fixed", *fixed, targets) && passed;
+		}
+
+		// regularized so the flat bases stay solvable at the larger sizes
+		const char *bases[] = { "gaussian", "imq", "mq", "tps", "wendland2" };
+		for (const char *basis : bases)
+		{
+			std::unique_ptr<KernelField> field = KernelField::create(basis, "double");
+			field->fit(positions, values, eta, 1e-3f);
+
+			std::string name = std::string(basis) + " (double)";
+			passed = compareJacobian(name.c_str(), *field, targets) && passed;
+		}
+	}
+
+	std::cout << "Fused Jacobian: " << (passed ? "PASS" : "FAIL") << std::endl;
+
+	return passed;
+}
+
+namespace
+{
+	// Passes evaluations through to a field, counting the points (single-threaded use)
+	class CountingEvaluator : public FieldEvaluator
+	{
+	public:
+		explicit CountingEvaluator(const FieldEvaluator &field)
+			: m_Field(field)
+			, m_uiPoints(0u)
+		{
+		}
+
+		void evaluate(const float *xyz, size_t n, float *out) const override
+		{
+			m_uiPoints += n;
+			m_Field.evaluate(xyz, n, out);
+		}
+
+		const char* getName() const override
+		{
+			return m_Field.getName();
+		}
+
+		size_t getPoints() const { return m_uiPoints; }
+		void reset() { m_uiPoints = 0u; }
+
+	private:
+		const FieldEvaluator &m_Field;
+		mutable size_t m_uiPoints;
+	};
+
+	// Advects every seed for totalTime through the field, which is not cut off at the cube here, and stores where
+	// each one ends. A fixed-step integrator takes nSteps steps of totalTime / nSteps; an adaptive one starts
+	// with that step and ends on totalTime exactly.
+	void integrateSeeds(const ParticleIntegrator &integrator, const FieldEvaluator &field, const std::vector<glm::vec3> &seeds, float totalTime, unsigned int nSteps, std::vector<glm::vec3> &ends)
+	{
+		const size_t packet = ParticleIntegrator::MAX_PARTICLES;
+		const float dt = totalTime / static_cast<float>(nSteps);
+		const bool adaptive = integrator.isAdaptive();
+
+		ends.resize(seeds.size());
+
+		for (size_t first = 0u; first < seeds.size(); first += packet)
+		{
+			glm::vec3 position[packet], velocity[packet];
+			float h[packet], stepSize[packet], time[packet];
+			size_t index[packet];
+			unsigned int steps[packet];
+
+			size_t n = std::min(packet, seeds.size() - first);
+			for (size_t l = 0u; l < n; ++l)
+			{
+				position[l] = seeds[first + l];
+				h[l] = dt;
+				time[l] = 0.f;
+				index[l] = first + l;
+				steps[l] = 0u;
+			}
+
+			field.evaluate(&position[0].x, n, &velocity[0].x);
+
+			while (n > 0u)
+			{
+				for (size_t l = 0u; l < n; ++l)
+					stepSize[l] = adaptive ? std::min(h[l], totalTime - time[l]) : dt;
+
+				unsigned long long accepted = integrator.step(field, n, position, velocity, stepSize, h);
+
+				// finished particles leave the packet, the last one taking their place
+				for (size_t l = n; l-- > 0u;)
+				{
+					if (!(accepted & (1ull << l)))
+						continue;
+
+					time[l] = stepSize[l] < totalTime - time[l] ? time[l] + stepSize[l] : totalTime;
+					if (adaptive ? time[l] < totalTime : ++steps[l] < nSteps)
+						continue;
+
+					ends[index[l]] = position[l];
+
+					--n;
+					position[l] = position[n];
+					velocity[l] = velocity[n];
+					h[l] = h[n];
+					time[l] = time[n];
+					index[l] = index[n];
+					steps[l] = steps[n];
+				}
+			}
+		}
+	}
+}
+
+void Diagnostics::benchmarkIntegrators(float dt)
+{
+	const size_t nSeeds = 1024u;
+	const float totalTime = 1.f;
+	const float eta = 1.2f;
+
+	// fixed step counts over totalTime as multiples of the count at dt, and RK45 tolerances (absolute and relative
+	// alike); RK45 starts with dt
+	const float eulerScales[] = { 0.5f, 1.f, 2.f, 4.f, 8.f, 16.f };
+	const float rk4Scales[] = { 1.f / 18.f, 1.f / 9.f, 2.f / 9.f, 0.5f, 1.f };
+	const float tolerances[] = { 1e-2f, 1e-3f, 1e-4f, 1e-5f, 1e-6f };
+	const unsigned int referenceSteps = 1024u;
+
+	const unsigned int baselineSteps = std::max(static_cast<unsigned int>(totalTime / dt + 0.5f), 1u);
+	auto scaledSteps = [&](float scale) { return std::max(static_cast<unsigned int>(scale * baselineSteps + 0.5f), 1u); };
+
+	std::mt19937 rng(1234u);
+	std::uniform_real_distribution<float> unitDist(-1.f, 1.f);
+
+	std::vector<glm::vec3> seeds(nSeeds);
+	for (auto &seed : seeds)
+		seed = 0.5f * glm::vec3(unitDist(rng), unitDist(rng), unitDist(rng));
+
+	// the Engine's field, six centers fitted to random directions, and a larger field with random weights
+	std::vector<glm::vec3> positions(6u), directions(6u);
+	for (unsigned int i = 0u; i < 6u; ++i)
+	{
+		positions[i] = glm::vec3(unitDist(rng), unitDist(rng), unitDist(rng));
+		directions[i] = glm::vec3(unitDist(rng), unitDist(rng), unitDist(rng));
+	}
+	std::unique_ptr<FixedRBFEvaluatorBase> fitted = FixedRBFEvaluatorBase::create(6u);
+	fitted->fit(positions.data(), directions.data(), 6u, eta, 0.f);
+
+	const unsigned int nCenters = 100u;
+	std::vector<glm::vec3> centers(nCenters);
+	Eigen::VectorXf lx(nCenters), ly(nCenters), lz(nCenters);
+	for (unsigned int i = 0u; i < nCenters; ++i)
+	{
+		centers[i] = glm::vec3(unitDist(rng), unitDist(rng), unitDist(rng));
+		lx(i) = unitDist(rng);
+		ly(i) = unitDist(rng);
+		lz(i) = unitDist(rng);
+	}
+	RBFEvaluator random;
+	random.setControlPoints(centers, lx, ly, lz, eta);
+
+	const FieldEvaluator *fields[2] = { fitted.get(), &random };
+	const char *fieldNames[2] = { "6 fitted centers", "100 random centers" };
+
+	std::cout << "Integrator benchmark: " << nSeeds << " particles over " << totalTime << " s, errors against RK4 with " << referenceSteps << " steps" << std::endl;
+
+	for (int f = 0; f < 2; ++f)
+	{
+		CountingEvaluator field(*fields[f]);
+
+		std::vector<glm::vec3> reference, ends;
+		integrateSeeds(ParticleIntegrator(ParticleIntegrator::METHOD_RK4), field, seeds, totalTime, referenceSteps, reference);
+
+		std::cout << fieldNames[f] << std::endl;
+		std::cout << std::setw(24) << "method" << std::setw(12) << "step/tol" << std::setw(14) << "evals/part" << std::setw(14) << "max error" << std::setw(14) << "RMS error" << std::setw(12) << "seconds" << std::endl;
+
+		// RMS error and evaluations per particle of each run
+		auto run = [&](const ParticleIntegrator &integrator, unsigned int nSteps, float setting) {
+			field.reset();
+			auto start = std::chrono::high_resolution_clock::now();
+			integrateSeeds(integrator, field, seeds, totalTime, nSteps, ends);
+			double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+			float maxError = 0.f, sumSquares = 0.f;
+			for (size_t i = 0u; i < nSeeds; ++i)
+			{
+				float error = glm::length(ends[i] - reference[i]);
+				maxError = std::max(maxError, error);
+				sumSquares += error * error;
+			}
+			float rmsError = std::sqrt(sumSquares / static_cast<float>(nSeeds));
+			double evaluations = static_cast<double>(field.getPoints()) / static_cast<double>(nSeeds);
+
+			std::cout << std::setw(24) << ParticleIntegrator::getMethodName(integrator.getMethod())
+				<< std::setw(12) << setting
+				<< std::setw(14) << evaluations
+				<< std::setw(14) << maxError
+				<< std::setw(14) << rmsError
+				<< std::setw(12) << seconds << std::endl;
+
+			return std::make_pair(rmsError, evaluations);
+		};
+
+		std::vector<std::pair<float, double>> results[3];
+
+		std::pair<float, double> baseline;
+
+		for (float scale : eulerScales)
+		{
+			results[0].push_back(run(ParticleIntegrator(ParticleIntegrator::METHOD_EULER), scaledSteps(scale), totalTime / scaledSteps(scale)));
+			if (scale == 1.f)
+				baseline = results[0].back();
+		}
+
+		for (float scale : rk4Scales)
+			results[1].push_back(run(ParticleIntegrator(ParticleIntegrator::METHOD_RK4), scaledSteps(scale), totalTime / scaledSteps(scale)));
+
+		for (float tolerance : tolerances)
+		{
+			ParticleIntegrator adaptive(ParticleIntegrator::METHOD_RK45);
+			adaptive.setTolerance(tolerance, tolerance);
+			results[2].push_back(run(adaptive, baselineSteps, tolerance));
+		}
+
+		// the cheapest run of each higher-order method at least as accurate as Euler at dt
+		for (int m = 1; m < 3; ++m)
+		{
+			double cheapest = 0.;
+			for (auto const &result : results[m])
+				if (result.first <= baseline.first && (cheapest == 0. || result.second < cheapest))
+					cheapest = result.second;
+
+			const char *name = ParticleIntegrator::getMethodName(static_cast<ParticleIntegrator::Method>(m));
+			if (cheapest > 0.)
+				std::cout << '\t' << name << " matches Euler at dt = " << dt << " (RMS error " << baseline.first << ", " << baseline.second << " evaluations) with " << cheapest << " evaluations per particle, " << baseline.second / cheapest << "x fewer" << std::endl;
+			else
+				std::cout << '\t' << name << " does not reach the accuracy of Euler at dt = " << dt << " in these runs" << std::endl;
+		}
+	}
+}
+
+bool Diagnostics::checkTrajectoryFile(unsigned int nParticles)
+{
+	const char *path = "trajectory_check.vfgt";
+	const float dt = 1.f / 90.f;
+	const float totalTime = 10.f;
+	const unsigned int seed = 1234u;
+	const float tolerances[] = { 1e-4f, 1e-3f, 1e-2f };
+	const size_t nLookups = 100000u;
+
+	VectorFieldGenerator vfg;
+	vfg.setThreadCount(0u);
+	vfg.setSeed(seed);
+	vfg.init(6u, 16u);
+
+	// the particle seeds come from the generator, so reseeding it before each run advects the same particles
+	auto advect = [&](TrajectorySink &sink) {
+		vfg.setSeed(seed);
+		auto start = std::chrono::high_resolution_clock::now();
+		vfg.getAdvectedParticles(static_cast<int>(nParticles), dt, totalTime, sink);
+		return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	};
+
+	std::cout << "Trajectory file check: " << nParticles << " particles over " << totalTime << " s at dt = " << dt << std::endl;
+
+	TrajectorySet trajectories;
+	double setSeconds = advect(trajectories);
+
+	TrajectoryWriter writer;
+	if (!writer.open(path))
+	{
+		std::cout << "\tUnable to open " << path << std::endl;
+		return false;
+	}
+	double fileSeconds = advect(writer);
+
+	TrajectoryReader reader;
+	if (!writer.good() || !reader.open(path))
+	{
+		std::cout << "\tWriting or mapping " << path << " failed" << std::endl;
+		std::remove(path);
+		return false;
+	}
+
+	bool identical = reader.size() == trajectories.size() && reader.getPointCount() == trajectories.getPointCount();
+	for (size_t i = 0u; i < trajectories.size() && identical; ++i)
+	{
+		TrajectorySink::Trajectory expected = trajectories.getTrajectory(i);
+		TrajectorySink::Trajectory actual = reader.getTrajectory(i);
+		TrajectorySet::Span expectedPoints = trajectories.getPoints(i);
+		TrajectorySet::Span actualPoints = reader.getPoints(i);
+
+		identical = expected.seed == actual.seed && expected.steps == actual.steps && expected.exited == actual.exited
+			&& expectedPoints.size() == actualPoints.size()
+			&& std::equal(expectedPoints.begin(), expectedPoints.end(), actualPoints.begin());
+	}
+
+	std::cout << '\t' << trajectories.getPointCount() << " points: " << setSeconds << " s into memory (" << trajectories.getPointCount() * sizeof(glm::vec3) << " bytes of points), "
+		<< fileSeconds << " s to the file (" << nParticles * sizeof(TrajectoryFile::IndexEntry) << " bytes of index held); read back " << (identical ? "identical" : "DIFFERENT") << std::endl;
+
+	// random access: the first touch of a trajectory faults its pages in from the page cache
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<size_t> pick(0u, std::max(reader.size(), size_t(1u)) - 1u);
+	glm::vec3 sum(0.f);
+	auto start = std::chrono::high_resolution_clock::now();
+	for (size_t i = 0u; i < nLookups && reader.size() > 0u; ++i)
+		for (auto const &point : reader.getPoints(pick(rng)))
+			sum += point;
+	double lookupSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+	std::cout << '\t' << nLookups << " random trajectories read through the mapping in " << lookupSeconds << " s (checksum " << sum.x + sum.y + sum.z << ")" << std::endl;
+
+	reader.close();
+
+	// every point of the full trajectory must lie within tolerance of the simplified segment spanning it; the kept
+	// points are copies of a subsequence of the originals, so a forward walk pairs them up
+	bool simplified = true;
+	for (float tolerance : tolerances)
+	{
+		writer.open(path);
+		writer.setSimplification(tolerance);
+		advect(writer);
+
+		if (!writer.good() || !reader.open(path) || reader.size() != trajectories.size())
+		{
+			std::cout << "\tWriting or mapping " << path << " failed" << std::endl;
+			simplified = false;
+			break;
+		}
+
+		float maxDeviation = 0.f;
+		bool valid = true;
+		for (size_t t = 0u; t < trajectories.size() && valid; ++t)
+		{
+			TrajectorySet::Span full = trajectories.getPoints(t);
+			TrajectorySet::Span kept = reader.getPoints(t);
+
+			valid = kept.size() >= std::min(full.size(), size_t(2u)) && kept[0] == full[0] && kept[kept.size() - 1u] == full[full.size() - 1u];
+
+			size_t i = 0u;
+			for (size_t k = 1u; k < kept.size() && valid; ++k)
+			{
+				glm::vec3 a = kept[k - 1u], b = kept[k];
+				glm::vec3 ab = b - a;
+				float lengthSq = glm::dot(ab, ab);
+
+				for (++i; i < full.size() && !(full[i] == b); ++i)
+				{
+					float s = lengthSq > 0.f ? glm::clamp(glm::dot(full[i] - a, ab) / lengthSq, 0.f, 1.f) : 0.f;
+					maxDeviation = std::max(maxDeviation, glm::length(full[i] - (a + s * ab)));
+				}
+
+				valid = i < full.size();
+			}
+		}
+
+		bool pass = valid && maxDeviation <= tolerance * (1.f + 1e-4f);
+		simplified = simplified && pass;
+
+		std::cout << '\t' << "simplified to " << tolerance << ": " << reader.getPointCount() << " points (" << static_cast<double>(trajectories.getPointCount()) / std::max(reader.getPointCount(), uint64_t(1u))
+			<< "x fewer), max deviation " << maxDeviation << (pass ? "" : " FAILED") << std::endl;
+
+		reader.close();
+	}
+
+	std::remove(path);
+
+	return identical && simplified;
+}
+
+namespace
+{
+	// A generator's fitted field as a FieldEvaluator, the field checkSphereExits advects through with ADVECT_EXACT
+	class GeneratorField : public FieldEvaluator
+	{
+	public:
+		explicit GeneratorField(const VectorFieldGenerator &vfg)
+			: m_Generator(vfg)
+		{
+		}
+
+		void evaluate(const float *xyz, size_t n, float *out) const override
+		{
+			m_Generator.evaluate(xyz, n, out);
+		}
+
+		const char* getName() const override
+		{
+			return "generator";
+		}
+
+	private:
+		const VectorFieldGenerator &m_Generator;
+	};
+
+	// Exit times from a fine fixed-step RK4 run over all of totalTime, each crossing located by linear interpolation
+	// of the distance to the center between two steps: none of the dense output, root finding or step culling of
+	// checkSphereExits, so it checks them independently. time stays -1 for spheres the particle never left.
+	void referenceSphereExits(const FieldEvaluator &field, glm::vec3 start, float totalTime, unsigned int nSteps, const std::vector<VectorFieldGenerator::SphereExit> &spheres, std::vector<float> &times)
+	{
+		ParticleIntegrator rk4(ParticleIntegrator::METHOD_RK4);
+		const float h = totalTime / static_cast<float>(nSteps);
+
+		times.assign(spheres.size(), -1.f);
+		std::vector<char> inside(spheres.size());
+		for (size_t s = 0u; s < spheres.size(); ++s)
+			inside[s] = glm::length(start - spheres[s].center) < spheres[s].radius;
+
+		glm::vec3 position = start, velocity;
+		field.evaluate(&position.x, 1u, &velocity.x);
+
+		for (unsigned int i = 0u; i < nSteps; ++i)
+		{
+			glm::vec3 previous = position;
+			float nextH;
+			rk4.step(field, 1u, &position, &velocity, &h, &nextH);
+
+			for (size_t s = 0u; s < spheres.size(); ++s)
+			{
+				if (times[s] >= 0.f)
+					continue;
+
+				float d0 = glm::length(previous - spheres[s].center) - spheres[s].radius;
+				float d1 = glm::length(position - spheres[s].center) - spheres[s].radius;
+
+				if (!inside[s] && d1 < 0.f)
+					inside[s] = true;
+				else if (inside[s] && d1 >= 0.f)
+					times[s] = (static_cast<float>(i) + d0 / (d0 - d1)) * h;
+			}
+		}
+	}
+}
+
+bool Diagnostics::checkSphereExits(unsigned int nRadii)
+{
+	const float dt = 1.f / 90.f;
+	const float totalTime = 10.f;
+	const unsigned int nOffset = std::max(nRadii / 4u, 1u);
+
+	// the reference run takes 32 steps for every step of the checked ones; a crossing missed or found on the wrong
+	// side is off by far more than half a step
+	const unsigned int referenceSteps = 32u * static_cast<unsigned int>(totalTime / dt + 0.5f);
+	const float referenceTolerance = 0.5f * dt;
+
+	VectorFieldGenerator vfg;
+	vfg.setSeed(1234u);
+	vfg.init(6u, 16u);
+
+	GeneratorField generatorField(vfg);
+
+	std::cout << "Sphere exit check: " << nRadii << " radii around the start and " << nOffset << " offset spheres, " << totalTime << " s at dt = " << dt << std::endl;
+
+	bool pass = true;
+	const ParticleIntegrator::Method methods[3] = { ParticleIntegrator::METHOD_EULER, ParticleIntegrator::METHOD_RK4, ParticleIntegrator::METHOD_RK45 };
+	for (auto method : methods)
+	{
+		ParticleIntegrator integrator(method);
+
+		// nested radii around the start; the offset spheres are centered on the path, where it leaves every fourth
+		// of them, and reach halfway back to the start, so the particle has to enter them first
+		std::vector<VectorFieldGenerator::SphereExit> spheres(nRadii);
+		for (unsigned int r = 0u; r < nRadii; ++r)
+		{
+			spheres[r].center = glm::vec3(0.f);
+			spheres[r].radius = 0.95f * static_cast<float>(r + 1u) / static_cast<float>(nRadii);
+		}
+
+		float td;
+		vfg.checkSphereExits(dt, totalTime, glm::vec3(0.f), spheres, td, integrator, true);
+
+		for (unsigned int o = 0u; o < nOffset; ++o)
+		{
+			VectorFieldGenerator::SphereExit sphere = spheres[std::min(4u * o + 3u, nRadii - 1u)];
+			if (!sphere.exited)
+				continue;
+
+			sphere.center = sphere.point;
+			sphere.radius = 0.5f * glm::length(sphere.point);
+			spheres.push_back(sphere);
+		}
+
+		auto start = std::chrono::high_resolution_clock::now();
+		size_t nExited = vfg.checkSphereExits(dt, totalTime, glm::vec3(0.f), spheres, td, integrator, true);
+		double sweepSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		// one integration per sphere, as the sweep would cost without the multi-sphere pass
+		size_t nDifferent = 0u;
+		start = std::chrono::high_resolution_clock::now();
+		for (auto const &sphere : spheres)
+		{
+			std::vector<VectorFieldGenerator::SphereExit> single(1u, sphere);
+			vfg.checkSphereExits(dt, totalTime, glm::vec3(0.f), single, td, integrator, true);
+
+			if (single[0].exited != sphere.exited || single[0].time != sphere.time || single[0].distance != sphere.distance || single[0].point != sphere.point)
+				++nDifferent;
+		}
+		double separateSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		// against the reference, which follows the true path closer than forward Euler can, so Euler is only reported
+		std::vector<float> referenceTimes;
+		referenceSphereExits(generatorField, glm::vec3(0.f), totalTime, referenceSteps, spheres, referenceTimes);
+
+		size_t nMissed = 0u;
+		float maxTimeError = 0.f;
+		for (size_t s = 0u; s < spheres.size(); ++s)
+		{
+			if (spheres[s].exited != (referenceTimes[s] >= 0.f))
+				++nMissed;
+			else if (spheres[s].exited)
+				maxTimeError = std::max(maxTimeError, std::abs(spheres[s].time - referenceTimes[s]));
+		}
+
+		bool matchesReference = method == ParticleIntegrator::METHOD_EULER || (nMissed == 0u && maxTimeError < referenceTolerance);
+
+		pass = pass && nDifferent == 0u && matchesReference;
+
+		std::cout << '\t' << std::setw(24) << ParticleIntegrator::getMethodName(method) << ": " << nExited << " of " << spheres.size() << " spheres left, "
+			<< sweepSeconds << " s in one pass vs " << separateSeconds << " s one sphere at a time (" << separateSeconds / std::max(sweepSeconds, 1e-9) << "x); "
+			<< (nDifferent == 0u ? "identical" : "DIFFERENT") << "; against RK4 at dt / " << referenceSteps / static_cast<unsigned int>(totalTime / dt + 0.5f)
+			<< ": " << nMissed << " exits missed, max time error " << maxTimeError << (matchesReference ? "" : " FAILED") << std::endl;
+	}
+
+	return pass;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+// Self-checks and benchmarks that can be requested from the command line (see Engine)
+namespace Diagnostics
+{
+	// Compares every SIMD kernel the CPU supports, for single points and for batches (packet kernels), against
+	// the scalar reference kernel on random control point layouts; returns false if any kernel strays beyond
+	// float rounding
+	bool checkSIMDEquivalence(unsigned int nTrials = 200u);
+
+	// Times kernel assembly, factorization and the N x 3 solve for each solver method from N = 6 up to
+	// N = 10,000 random control points, unregularized (up to 2,000) and with Tikhonov parameter mu
+	// (1e-3 if none is given). The matrix-free CG solver runs on the regularized systems only and reports
+	// its iteration count in the condition column
+	void benchmarkSolvers(float regularization = 0.f);
+
+	// Compares the Fast Gauss Transform evaluator against the direct sum for several Gaussian shapes and
+	// control point counts at the given tolerance; prints the chosen parameters, the error relative to
+	// sum |lambda| next to the guaranteed bound, and the timings of both. Returns false if any error
+	// exceeds its bound.
+	bool checkFGTAccuracy(float tolerance = 1e-4f);
+
+	// Compares the fused value and Jacobian of every SIMD kernel the CPU supports, the fixed-size evaluator and
+	// each kernel field basis against central differences of their plain evaluation, and times the fused pass
+	// against the differences. Returns false if a Jacobian differs by more than the differencing error allows.
+	bool checkJacobian();
+
+	// Field evaluations per particle against endpoint accuracy for forward Euler and RK4 over a range of steps and
+	// for adaptive RK45 over a range of tolerances, on a small fitted field and a larger random one, with a fine
+	// RK4 run as the reference. Reports how few evaluations each method needs to match Euler at the given dt.
+	void benchmarkIntegrators(float dt = 1.f / 90.f);
+
+	// Streams the particles of a small field to a temporary trajectory file and reads it back through the memory
+	// map: every trajectory must match the in-memory TrajectorySet of the same seeds exactly, and each
+	// simplification tolerance must keep every dropped point within tolerance of the written polyline. Prints the
+	// write and random-access timings and the point reduction per tolerance.
+	bool checkTrajectoryFile(unsigned int nParticles = 100000u);
+
+	// Finds the exits of one particle through a sweep of spheres (nested radii around the start, plus spheres
+	// centered on its path that it has to enter first) in a single integration and compares them with one run per
+	// sphere, for each integrator, and with exits located on a fine fixed-step RK4 path. Prints the time of both;
+	// returns false if any exit differs between the two, or for RK4 and RK45 from the reference by over half a step.
+	bool checkSphereExits(unsigned int nRadii = 32u);
+}
\ No newline at end of file
@@ -4,7 +4,14 @@
 
 #include <glm/gtc/type_ptr.hpp>
 
+#include <fstream>
+#include <algorithm>
+#include <sstream>
+#include <chrono>
+
 #include "DebugDrawer.h"
+#include "Diagnostics.h"
+#include "TrajectoryFile.h"
 
 #define GRID_RES 32u
 
@@ -19,10 +26,43 @@ Engine::Engine(int argc, char* argv[])
 	, m_pShaderNormals(NULL)
 	, m_bGL(true)
 	, m_bSphereAdvectorsOnly(false)
+	, m_bCheckSIMD(false)
+	, m_bBenchmarkSolvers(false)
+	, m_bCheckFGT(false)
+	, m_bCheckJacobian(false)
+	, m_bBenchmarkIntegrators(false)
+	, m_bCheckTrajectories(false)
+	, m_bCheckSphereExits(false)
 	, m_fDeltaT(1.f / 90.f)
 	, m_fAdvectionTime(10.f)
 //	, m_fSphereRadius(0.1f * sqrt(3)) // radius from Forsberg paper
 	, m_fSphereRadius(0.66667f)
+	, m_uiThreads(1u)
+	, m_bSeeded(false)
+	, m_uiSeed(0u)
+	, m_eGridEvaluation(VectorFieldGenerator::GRID_SEPARABLE)
+	, m_eEvaluationEngine(VectorFieldGenerator::EVAL_DIRECT)
+	, m_fFGTTolerance(1e-4f)
+	, m_eBasisFunction(VectorFieldGenerator::BASIS_GAUSSIAN)
+	, m_fSupportRadius(1.f)
+	, m_fGaussianShape(1.2f)
+	, m_bShapeSelection(false)
+	, m_strKernelScalar("float")
+	, m_bPartitionOfUnity(false)
+	, m_uiPatchesPerAxis(0u)
+	, m_fPatchOverlap(1.5f)
+	, m_bMultilevel(false)
+	, m_uiLevels(0u)
+	, m_eSolverMethod(RBFSolver::METHOD_LLT)
+	, m_fRegularization(0.f)
+	, m_fSolverTolerance(1e-4f)
+	, m_uiSolverMaxIterations(1000u)
+	, m_eAdvectionField(VectorFieldGenerator::ADVECT_EXACT)
+	, m_eIntegrator(ParticleIntegrator::METHOD_EULER)
+	, m_fIntegratorTolerance(1e-5f)
+	, m_bSamplingReport(false)
+	, m_uiParticles(1000u)
+	, m_fTrajectorySimplification(0.f)
 	, m_strSavePath("flowgrid.fg")
 {
 	for (int i = 1; i < argc; ++i)
@@ -35,6 +75,188 @@ Engine::Engine(int argc, char* argv[])
 		if (arg.compare("--onlyadvects") == 0)
 			m_bSphereAdvectorsOnly = true;
 
+		if (arg.compare("--checksimd") == 0)
+			m_bCheckSIMD = true;
+
+		if (arg.compare("--benchsolve") == 0)
+			m_bBenchmarkSolvers = true;
+
+		if (arg.compare("--checkfgt") == 0)
+			m_bCheckFGT = true;
+
+		if (arg.compare("--checkjacobian") == 0)
+			m_bCheckJacobian = true;
+
+		if (arg.compare("--benchintegrators") == 0)
+			m_bBenchmarkIntegrators = true;
+
+		if (arg.compare("--checktrajectories") == 0)
+			m_bCheckTrajectories = true;
+
+		if (arg.compare("--checksphereexits") == 0)
+			m_bCheckSphereExits = true;
+
+		// 0 uses every hardware core
+		if (arg.compare("--threads") == 0 && i + 1 < argc)
+			m_uiThreads = static_cast<unsigned int>(std::stoi(argv[i + 1]));
+
+		// reproducible fields: the first one uses this seed and every regeneration the next
+		if (arg.compare("--seed") == 0 && i + 1 < argc)
+		{
+			m_bSeeded = true;
+			m_uiSeed = static_cast<unsigned int>(std::stoul(argv[i + 1]));
+		}
+
+		if (arg.compare("--gridmode") == 0 && i + 1 < argc)
+		{
+			std::string mode(argv[i + 1]);
+			if (mode.compare("direct") == 0)
+				m_eGridEvaluation = VectorFieldGenerator::GRID_DIRECT;
+			if (mode.compare("separable") == 0)
+				m_eGridEvaluation = VectorFieldGenerator::GRID_SEPARABLE;
+		}
+
+		if (arg.compare("--evaluator") == 0 && i + 1 < argc)
+		{
+			std::string engine(argv[i + 1]);
+			if (engine.compare("direct") == 0)
+				m_eEvaluationEngine = VectorFieldGenerator::EVAL_DIRECT;
+			if (engine.compare("gemm") == 0)
+				m_eEvaluationEngine = VectorFieldGenerator::EVAL_GEMM;
+			if (engine.compare("fgt") == 0)
+				m_eEvaluationEngine = VectorFieldGenerator::EVAL_FGT;
+		}
+
+		// error tolerance of --evaluator fgt (also used by --checkfgt)
+		if (arg.compare("--fgttolerance") == 0 && i + 1 < argc)
+			m_fFGTTolerance = std::stof(argv[i + 1]);
+
+		if (arg.compare("--basis") == 0 && i + 1 < argc)
+		{
+			std::string basis(argv[i + 1]);
+			if (basis.compare("gaussian") == 0)
+				m_eBasisFunction = VectorFieldGenerator::BASIS_GAUSSIAN;
+			if (basis.compare("wendland2") == 0)
+				m_eBasisFunction = VectorFieldGenerator::BASIS_WENDLAND_C2;
+			if (basis.compare("wendland4") == 0)
+				m_eBasisFunction = VectorFieldGenerator::BASIS_WENDLAND_C4;
+		}
+
+		// support radius of the Wendland bases
+		if (arg.compare("--support") == 0 && i + 1 < argc)
+			m_fSupportRadius = std::stof(argv[i + 1]);
+
+		// Gaussian shape eta, fixed or picked by leave-one-out cross-validation at every fit
+		if (arg.compare("--shape") == 0 && i + 1 < argc)
+			m_fGaussianShape = std::stof(argv[i + 1]);
+
+		if (arg.compare("--autoshape") == 0)
+			m_bShapeSelection = true;
+
+		// compile-time specialized kernel: gaussian, imq, mq, tps or wendland2, in float or double
+		if (arg.compare("--kernel") == 0 && i + 1 < argc)
+			m_strKernelBasis = argv[i + 1];
+
+		if (arg.compare("--precision") == 0 && i + 1 < argc)
+			m_strKernelScalar = argv[i + 1];
+
+		// partition of unity fit; --patches 0 sizes the patch lattice from the control point count
+		if (arg.compare("--pu") == 0)
+			m_bPartitionOfUnity = true;
+
+		if (arg.compare("--patches") == 0 && i + 1 < argc)
+			m_uiPatchesPerAxis = static_cast<unsigned int>(std::stoi(argv[i + 1]));
+
+		if (arg.compare("--overlap") == 0 && i + 1 < argc)
+			m_fPatchOverlap = std::stof(argv[i + 1]);
+
+		// multilevel fit; --levels 0 adds levels until the coarsest is small
+		if (arg.compare("--multilevel") == 0)
+			m_bMultilevel = true;
+
+		if (arg.compare("--levels") == 0 && i + 1 < argc)
+			m_uiLevels = static_cast<unsigned int>(std::stoi(argv[i + 1]));
+
+		if (arg.compare("--solver") == 0 && i + 1 < argc)
+		{
+			std::string method(argv[i + 1]);
+			if (method.compare("lu") == 0)
+				m_eSolverMethod = RBFSolver::METHOD_FULL_PIV_LU;
+			if (method.compare("llt") == 0)
+				m_eSolverMethod = RBFSolver::METHOD_LLT;
+			if (method.compare("ldlt") == 0)
+				m_eSolverMethod = RBFSolver::METHOD_LDLT;
+			if (method.compare("cg") == 0)
+				m_eSolverMethod = RBFSolver::METHOD_CG;
+		}
+
+		if (arg.compare("--regularization") == 0 && i + 1 < argc)
+			m_fRegularization = std::stof(argv[i + 1]);
+
+		// stopping criteria for --solver cg
+		if (arg.compare("--tolerance") == 0 && i + 1 < argc)
+			m_fSolverTolerance = std::stof(argv[i + 1]);
+
+		if (arg.compare("--maxiter") == 0 && i + 1 < argc)
+			m_uiSolverMaxIterations = static_cast<unsigned int>(std::stoi(argv[i + 1]));
+
+		// field the particles are advected through: the exact fit or the grid, trilinear or tricubic (the sphere
+		// acceptance test always runs on the exact fit)
+		if (arg.compare("--advect") == 0 && i + 1 < argc)
+		{
+			std::string field(argv[i + 1]);
+			if (field.compare("exact") == 0)
+				m_eAdvectionField = VectorFieldGenerator::ADVECT_EXACT;
+			if (field.compare("trilinear") == 0)
+				m_eAdvectionField = VectorFieldGenerator::ADVECT_TRILINEAR;
+			if (field.compare("tricubic") == 0)
+				m_eAdvectionField = VectorFieldGenerator::ADVECT_TRICUBIC;
+		}
+
+		// time stepping of the advected particles: euler, rk4 or rk45 (adaptive, to --integratortolerance)
+		if (arg.compare("--integrator") == 0 && i + 1 < argc)
+		{
+			std::string method(argv[i + 1]);
+			if (method.compare("euler") == 0)
+				m_eIntegrator = ParticleIntegrator::METHOD_EULER;
+			if (method.compare("rk4") == 0)
+				m_eIntegrator = ParticleIntegrator::METHOD_RK4;
+			if (method.compare("rk45") == 0)
+				m_eIntegrator = ParticleIntegrator::METHOD_RK45;
+		}
+
+		if (arg.compare("--integratortolerance") == 0 && i + 1 < argc)
+			m_fIntegratorTolerance = std::stof(argv[i + 1]);
+
+		// comma-separated radii whose exits are all found in one integration of the test particle
+		if (arg.compare("--sphereradii") == 0 && i + 1 < argc)
+		{
+			std::stringstream radii(argv[i + 1]);
+			std::string radius;
+			while (std::getline(radii, radius, ','))
+				if (!radius.empty())
+					m_vSphereRadii.push_back(std::stof(radius));
+		}
+
+		// advected particles, drawn as trails and written by --trajectories
+		if (arg.compare("--particles") == 0 && i + 1 < argc)
+			m_uiParticles = static_cast<unsigned int>(std::stoul(argv[i + 1]));
+
+		// stream the particles to a binary trajectory file, simplified to --simplify units if given
+		if (arg.compare("--trajectories") == 0 && i + 1 < argc)
+			m_strTrajectoryPath = std::string(argv[i + 1]);
+
+		if (arg.compare("--simplify") == 0 && i + 1 < argc)
+			m_fTrajectorySimplification = std::stof(argv[i + 1]);
+
+		// error of both grid samplers against the exact field, pointwise and at the sphere exit
+		if (arg.compare("--samplingreport") == 0)
+			m_bSamplingReport = true;
+
+		// fit the field to measured vectors instead of random control points
+		if (arg.compare("--measurements") == 0 && i + 1 < argc)
+			m_strMeasurementPath = std::string(argv[i + 1]);
+
 		if (arg.compare("-path") == 0)
 			m_strSavePath = std::string(argv[i + 1]);
 
@@ -84,6 +306,27 @@ bool Engine::init()
 	if (m_bGL)
 		initGL();
 
+	if (m_bCheckSIMD)
+		Diagnostics::checkSIMDEquivalence();
+
+	if (m_bBenchmarkSolvers)
+		Diagnostics::benchmarkSolvers(m_fRegularization);
+
+	if (m_bCheckFGT)
+		Diagnostics::checkFGTAccuracy(m_fFGTTolerance);
+
+	if (m_bCheckJacobian)
+		Diagnostics::checkJacobian();
+
+	if (m_bBenchmarkIntegrators)
+		Diagnostics::benchmarkIntegrators(m_fDeltaT);
+
+	if (m_bCheckTrajectories)
+		Diagnostics::checkTrajectoryFile();
+
+	if (m_bCheckSphereExits)
+		Diagnostics::checkSphereExits();
+
 	generateField();
 
 	return true;
@@ -361,25 +604,104 @@ void Engine::init_shaders()
 
 void Engine::generateField()
 {
+	if (m_pVFG)
+		delete m_pVFG;
+
 	m_pVFG = new VectorFieldGenerator();
-	;
+	m_pVFG->setThreadCount(m_uiThreads);
+	if (m_bSeeded)
+		m_pVFG->setSeed(m_uiSeed++);
+	m_pVFG->setGridEvaluation(m_eGridEvaluation);
+	m_pVFG->setEvaluationEngine(m_eEvaluationEngine);
+	m_pVFG->setFGTTolerance(m_fFGTTolerance);
+	m_pVFG->setBasisFunction(m_eBasisFunction, m_fSupportRadius);
+	m_pVFG->setGaussianShape(m_fGaussianShape);
+	m_pVFG->setShapeSelection(m_bShapeSelection);
+	if (!m_pVFG->setKernelField(m_strKernelBasis, m_strKernelScalar))
+		std::cout << "Unknown kernel " << m_strKernelBasis << " in " << m_strKernelScalar << " precision; using the " << (m_eBasisFunction == VectorFieldGenerator::BASIS_GAUSSIAN ? "Gaussian" : "Wendland") << " basis" << std::endl;
+	m_pVFG->setPartitionOfUnity(m_bPartitionOfUnity, m_uiPatchesPerAxis, m_fPatchOverlap);
+	m_pVFG->setMultilevel(m_bMultilevel, m_uiLevels);
+	m_pVFG->setSolverMethod(m_eSolverMethod);
+	m_pVFG->setRegularization(m_fRegularization);
+	m_pVFG->setSolverTolerance(m_fSolverTolerance, m_uiSolverMaxIterations);
+
+	ParticleIntegrator integrator(m_eIntegrator);
+	integrator.setTolerance(m_fIntegratorTolerance, m_fIntegratorTolerance);
+
+	// the acceptance test runs on the fitted field itself and only needs the exit, so the particle stops there;
+	// it runs the full time only if it never gets out. The grid is built once a field is kept, not for every
+	// field the test throws away.
+	m_pVFG->setAdvectionField(VectorFieldGenerator::ADVECT_EXACT);
 	float t, d, td;
 	glm::vec3 exitPt;
 	bool advected;
-	
-	m_pVFG->init(6u, GRID_RES);
-	advected = m_pVFG->checkSphereAdvection(m_fDeltaT, m_fAdvectionTime, glm::vec3(0.f), m_fSphereRadius, t, d, td, exitPt);
 
-	while (m_bSphereAdvectorsOnly && !advected)
+	std::vector<glm::vec3> measuredPositions, measuredDirections;
+	bool measured = !m_strMeasurementPath.empty() && loadMeasurements(m_strMeasurementPath, measuredPositions, measuredDirections);
+
+	if (measured)
+	{
+		std::cout << "Fitting vector field to " << measuredPositions.size() << " measurements from " << m_strMeasurementPath << std::endl;
+		m_pVFG->fit(measuredPositions, measuredDirections, GRID_RES);
+	}
+	else
+		m_pVFG->fit(6u, GRID_RES);
+
+	advected = m_pVFG->checkSphereAdvection(m_fDeltaT, m_fAdvectionTime, glm::vec3(0.f), m_fSphereRadius, t, d, td, exitPt, integrator, true);
+
+	while (m_bSphereAdvectorsOnly && !advected && !measured)
 	{
 		std::cout << "Regenerating vector field because particle failed to advect through sphere (r=" << m_fSphereRadius << ") in " << m_fAdvectionTime << "s" << std::endl;
-		m_pVFG->init(6u, GRID_RES);
-		advected = m_pVFG->checkSphereAdvection(m_fDeltaT, m_fAdvectionTime, glm::vec3(0.f), m_fSphereRadius, t, d, td, exitPt);
+		m_pVFG->fit(6u, GRID_RES);
+		advected = m_pVFG->checkSphereAdvection(m_fDeltaT, m_fAdvectionTime, glm::vec3(0.f), m_fSphereRadius, t, d, td, exitPt, integrator, true);
+	}
+
+	// the field that is kept runs once more over the full time for the total distance it reports
+	if (advected)
+		m_pVFG->checkSphereAdvection(m_fDeltaT, m_fAdvectionTime, glm::vec3(0.f), m_fSphereRadius, t, d, td, exitPt, integrator);
+
+	m_pVFG->setAdvectionField(m_eAdvectionField);
+	m_pVFG->buildGrid();
+
+	if (m_bShapeSelection && m_eBasisFunction == VectorFieldGenerator::BASIS_GAUSSIAN && !m_pVFG->getKernelField())
+	{
+		const std::vector<VectorFieldGenerator::ShapeCandidate> &candidates = m_pVFG->getShapeCandidates();
+		std::cout << "Gaussian shape selected by leave-one-out cross-validation: eta = " << m_pVFG->getGaussianShape() << std::endl;
+		for (auto const &candidate : candidates)
+			std::cout << '\t' << "eta " << candidate.eta << ": RMS error " << candidate.error << " (" << RBFSolver::getMethodName(candidate.method) << ", " << candidate.seconds << " s)" << std::endl;
+	}
+
+	const RBFSolver::Report &solveReport = m_pVFG->getSolverReport();
+	if (m_pVFG->getKernelField())
+	{
+		const KernelField *field = m_pVFG->getKernelField();
+		std::cout << "Kernel field " << field->getBasisName() << " (" << field->getScalarName() << ") solved with " << field->getFactorization() << " in " << field->getFitSeconds() << " s" << std::endl;
+	}
+	else if (m_bMultilevel)
+	{
+		const std::vector<MultilevelEvaluator::Level> &levels = m_pVFG->getMultilevelLevels();
+		std::cout << "Multilevel fit: " << levels.size() << " levels in " << m_pVFG->getMultilevelSeconds() << " s" << std::endl;
+		for (size_t l = 0u; l < levels.size(); ++l)
+			std::cout << '\t' << "Level " << l << ": " << levels[l].points << " points, support " << levels[l].supportRadius << ", " << levels[l].iterations << " CG iterations, RMS residual " << levels[l].residual << std::endl;
+	}
+	else if (m_bPartitionOfUnity && m_eBasisFunction == VectorFieldGenerator::BASIS_GAUSSIAN)
+	{
+		const PartitionOfUnityEvaluator::Report &puReport = m_pVFG->getPartitionOfUnityReport();
+		std::cout << "Partition of unity fit: " << puReport.patches << " patches (mean " << puReport.meanPatchPoints << ", max " << puReport.maxPatchPoints << " points, " << puReport.borrowingPatches << " borrowing) in " << puReport.seconds << " s" << std::endl;
 	}
+	else if (solveReport.method == RBFSolver::METHOD_SPARSE_LDLT || solveReport.method == RBFSolver::METHOD_SPARSE_LU)
+		std::cout << "Kernel solved with " << RBFSolver::getMethodName(solveReport.method) << " (" << solveReport.nonZeros << " nonzeros)" << std::endl;
+	else if (solveReport.method == RBFSolver::METHOD_CG)
+		std::cout << "Kernel solved with CG in " << solveReport.iterations << " iterations (relative residual " << solveReport.residual << ")" << std::endl;
+	else
+		std::cout << "Kernel solved with " << RBFSolver::getMethodName(solveReport.method) << " (condition estimate " << solveReport.conditionEstimate << ")" << std::endl;
 
 	if (advected)
 	{
-		std::cout << "Particle successfully advected in " << t << " seconds (" << t / m_fDeltaT << " time steps)" << std::endl;
+		if (integrator.isAdaptive())
+			std::cout << "Particle successfully advected in " << t << " seconds (" << ParticleIntegrator::getMethodName(m_eIntegrator) << ", tolerance " << m_fIntegratorTolerance << ")" << std::endl;
+		else
+			std::cout << "Particle successfully advected in " << t << " seconds (" << t / m_fDeltaT << " " << ParticleIntegrator::getMethodName(m_eIntegrator) << " time steps)" << std::endl;
 		std::cout << '\t' << "Particle traveled " << d << " units until advecting through sphere (r = " << m_fSphereRadius << ")" << std::endl;
 		std::cout << '\t' << "Particle traveled " << td << " total units in " << m_fAdvectionTime << " seconds" << std::endl << std::endl;
 	}
@@ -389,6 +711,15 @@ void Engine::generateField()
 		std::cout << '\t' << "Particle traveled " << td << " total units in " << m_fAdvectionTime << " seconds without advecting through sphere (r = " << m_fSphereRadius << ")" << std::endl << std::endl;
 	}
 
+	if (!m_vSphereRadii.empty())
+		reportSphereExits(integrator);
+
+	if (m_bSamplingReport)
+		reportSampling();
+
+	if (!m_strTrajectoryPath.empty())
+		writeTrajectories(integrator);
+
 	if (m_bGL)
 	{
 		DebugDrawer::getInstance().flushLines();
@@ -407,10 +738,122 @@ void Engine::generateField()
 		DebugDrawer::getInstance().drawLine(exitPt - crossSize * x, exitPt + crossSize * x, glm::vec3(1.f, 0.f, 0.f));
 		DebugDrawer::getInstance().drawLine(exitPt - crossSize * y, exitPt + crossSize * y, glm::vec3(1.f, 0.f, 0.f));
 
-		std::vector<std::vector<glm::vec3>> particles = m_pVFG->getAdvectedParticles(1000, 1.f / 90.f, 10.f);
+		m_pVFG->getAdvectedParticles(static_cast<int>(m_uiParticles), 1.f / 90.f, 10.f, m_Trajectories, integrator);
+
+		for (size_t p = 0u; p < m_Trajectories.size(); ++p)
+		{
+			TrajectorySet::Span trail = m_Trajectories.getPoints(p);
+			DebugDrawer::getInstance().drawTrail(trail.data, trail.count);
+		}
+	}
+}
+
+void Engine::reportSphereExits(const ParticleIntegrator &integrator)
+{
+	std::vector<VectorFieldGenerator::SphereExit> spheres(m_vSphereRadii.size());
+	for (size_t s = 0u; s < spheres.size(); ++s)
+	{
+		spheres[s].center = glm::vec3(0.f);
+		spheres[s].radius = m_vSphereRadii[s];
+	}
+
+	float td;
+	auto start = std::chrono::high_resolution_clock::now();
+	size_t nExited = m_pVFG->checkSphereExits(m_fDeltaT, m_fAdvectionTime, glm::vec3(0.f), spheres, td, integrator, true);
+	std::chrono::duration<float> elapsed = std::chrono::high_resolution_clock::now() - start;
 
-		for (auto &trail : particles)
-			for (int i = 1; i < trail.size(); ++i)
-				DebugDrawer::getInstance().drawLine(trail[i - 1], trail[i], glm::normalize(trail[i] - trail[i - 1]));
+	std::cout << "Sphere exits: " << nExited << " of " << spheres.size() << " radii left in one integration (" << elapsed.count() << " s)" << std::endl;
+	for (auto const &sphere : spheres)
+	{
+		if (sphere.exited)
+			std::cout << '\t' << "r = " << sphere.radius << ": left after " << sphere.time << " seconds and " << sphere.distance << " units at (" << sphere.point.x << ", " << sphere.point.y << ", " << sphere.point.z << ")" << std::endl;
+		else
+			std::cout << '\t' << "r = " << sphere.radius << ": not left in " << m_fAdvectionTime << " seconds" << std::endl;
 	}
+	std::cout << std::endl;
+}
+
+void Engine::writeTrajectories(const ParticleIntegrator &integrator)
+{
+	TrajectoryWriter writer;
+	if (!writer.open(m_strTrajectoryPath))
+	{
+		std::cout << "Unable to open trajectory file " << m_strTrajectoryPath << std::endl;
+		return;
+	}
+
+	writer.setSimplification(m_fTrajectorySimplification);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	m_pVFG->getAdvectedParticles(static_cast<int>(m_uiParticles), m_fDeltaT, m_fAdvectionTime, writer, integrator);
+	std::chrono::duration<float> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+	if (!writer.good())
+		std::cout << "Writing trajectory file " << m_strTrajectoryPath << " failed" << std::endl;
+	else
+		std::cout << "Wrote " << m_uiParticles << " trajectories (" << writer.getPointCount() << " points, simplification " << m_fTrajectorySimplification << ") to " << m_strTrajectoryPath << " in " << elapsed.count() << " s" << std::endl;
+}
+
+void Engine::reportSampling()
+{
+	// the exit through the sphere with the exact field is the reference for the sampled runs
+	float tExact, dExact, tdExact;
+	glm::vec3 exitExact;
+	VectorFieldGenerator::AdvectionField field = m_pVFG->getAdvectionField();
+	ParticleIntegrator integrator(m_eIntegrator);
+	integrator.setTolerance(m_fIntegratorTolerance, m_fIntegratorTolerance);
+	m_pVFG->setAdvectionField(VectorFieldGenerator::ADVECT_EXACT);
+	bool advectedExact = m_pVFG->checkSphereAdvection(m_fDeltaT, m_fAdvectionTime, glm::vec3(0.f), m_fSphereRadius, tExact, dExact, tdExact, exitExact, integrator, true);
+
+	std::cout << "Grid sampling (" << GRID_RES << "^3 nodes) against the exact field" << std::endl;
+
+	const VectorFieldGenerator::AdvectionField sampled[2] = { VectorFieldGenerator::ADVECT_TRILINEAR, VectorFieldGenerator::ADVECT_TRICUBIC };
+	for (auto mode : sampled)
+	{
+		GridSampler::Interpolation interpolation = mode == VectorFieldGenerator::ADVECT_TRICUBIC ? GridSampler::INTERPOLATION_TRICUBIC : GridSampler::INTERPOLATION_TRILINEAR;
+		GridSampler::ErrorReport report = m_pVFG->measureSamplingError(interpolation);
+
+		float t, d, td;
+		glm::vec3 exitPt;
+		m_pVFG->setAdvectionField(mode);
+		bool advected = m_pVFG->checkSphereAdvection(m_fDeltaT, m_fAdvectionTime, glm::vec3(0.f), m_fSphereRadius, t, d, td, exitPt, integrator, true);
+
+		std::cout << '\t' << GridSampler::getInterpolationName(interpolation) << ": max error " << report.maxError << ", RMS error " << report.rmsError << " (RMS magnitude " << report.rmsMagnitude << ") over " << report.samples << " points; " << report.sampledSeconds << " s vs " << report.exactSeconds << " s exact" << std::endl;
+		if (advected && advectedExact)
+			std::cout << '\t' << '\t' << "sphere exit " << glm::length(exitPt - exitExact) << " units and " << t - tExact << " s from the exact one" << std::endl;
+		else
+			std::cout << '\t' << '\t' << "sphere exit " << (advected ? "found" : "not found") << ", exact " << (advectedExact ? "found" : "not found") << std::endl;
+	}
+
+	m_pVFG->setAdvectionField(field);
+}
+
+bool Engine::loadMeasurements(std::string path, std::vector<glm::vec3> &positions, std::vector<glm::vec3> &directions)
+{
+	std::ifstream file(path);
+
+	if (!file.is_open())
+	{
+		std::cout << "Could not open measurement file " << path << std::endl;
+		return false;
+	}
+
+	positions.clear();
+	directions.clear();
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::replace(line.begin(), line.end(), ',', ' ');
+		std::istringstream iss(line);
+
+		glm::vec3 pos, dir;
+		if (iss >> pos.x >> pos.y >> pos.z >> dir.x >> dir.y >> dir.z)
+		{
+			positions.push_back(pos);
+			directions.push_back(dir);
+		}
+	}
+
+	return !positions.empty();
 }
\ No newline at end of file
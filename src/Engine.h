@@ -12,6 +12,7 @@
 #include "GLFWInputBroadcaster.h"
 
 #include "VectorFieldGenerator.h"
+#include "TrajectorySet.h"
 
 #define MS_PER_UPDATE 0.0333333333f
 #define CAST_RAY_LEN 1000.f
@@ -42,10 +43,50 @@ private:
 	glm::mat4 m_mat4WorldRotation;
 	bool m_bGL;
 	bool m_bSphereAdvectorsOnly;
+	bool m_bCheckSIMD;
+	bool m_bBenchmarkSolvers;
+	bool m_bCheckFGT;
+	bool m_bCheckJacobian;
+	bool m_bBenchmarkIntegrators;
+	bool m_bCheckTrajectories;
+	bool m_bCheckSphereExits;
 
 	float m_fDeltaT;
 	float m_fAdvectionTime;
 	float m_fSphereRadius;
+	std::vector<float> m_vSphereRadii; // --sphereradii sweep, all around the start of the test particle
+
+	unsigned int m_uiThreads;
+	bool m_bSeeded;
+	unsigned int m_uiSeed; // of the next generated field
+	VectorFieldGenerator::GridEvaluation m_eGridEvaluation;
+	VectorFieldGenerator::EvaluationEngine m_eEvaluationEngine;
+	float m_fFGTTolerance;
+	VectorFieldGenerator::BasisFunction m_eBasisFunction;
+	float m_fSupportRadius;
+	float m_fGaussianShape;
+	bool m_bShapeSelection;
+	std::string m_strKernelBasis;
+	std::string m_strKernelScalar;
+	bool m_bPartitionOfUnity;
+	unsigned int m_uiPatchesPerAxis;
+	float m_fPatchOverlap;
+	bool m_bMultilevel;
+	unsigned int m_uiLevels;
+	RBFSolver::Method m_eSolverMethod;
+	float m_fRegularization;
+	float m_fSolverTolerance;
+	unsigned int m_uiSolverMaxIterations;
+	VectorFieldGenerator::AdvectionField m_eAdvectionField;
+	ParticleIntegrator::Method m_eIntegrator;
+	float m_fIntegratorTolerance; // absolute and relative, for the adaptive integrator
+	bool m_bSamplingReport;
+	TrajectorySet m_Trajectories; // particle trails of the current field, refilled in place on regeneration
+	unsigned int m_uiParticles;
+	std::string m_strTrajectoryPath; // stream the particles of every generated field here, if set
+	float m_fTrajectorySimplification;
+
+	std::string m_strMeasurementPath;
 
 	std::string m_strSavePath;
 
@@ -76,4 +117,16 @@ private:
 	void init_shaders();
 
 	void generateField();
+
+	// Prints how far the trilinear and tricubic grid samplers stray from the exact field (--samplingreport)
+	void reportSampling();
+
+	// Exit time, distance and point of the test particle for every radius of the sweep, from one integration
+	void reportSphereExits(const ParticleIntegrator &integrator);
+
+	// Advects m_uiParticles particles straight into a trajectory file (--trajectories)
+	void writeTrajectories(const ParticleIntegrator &integrator);
+
+	// Reads "x,y,z,u,v,w" lines of scattered vector measurements
+	bool loadMeasurements(std::string path, std::vector<glm::vec3> &positions, std::vector<glm::vec3> &directions);
 };
\ No newline at end of file
@@ -0,0 +1,405 @@
+#include "FGTEvaluator.h"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+namespace
+{
+	unsigned int termCount(unsigned int order)
+	{
+		// monomials in 3 variables of total degree < order
+		return order * (order + 1u) * (order + 2u) / 6u;
+	}
+
+	// Fills mono with all monomials of d of total degree < order in graded order: each degree is built by
+	// multiplying the previous degree's terms that start at or after variable i by d[i]
+	void computeMonomials(const double d[3], unsigned int order, double *mono)
+	{
+		unsigned int heads[3] = { 0u, 0u, 0u };
+
+		mono[0] = 1.0;
+
+		unsigned int t = 1u;
+		for (unsigned int k = 1u, tail = 1u; k < order; ++k, tail = t)
+		{
+			for (int i = 0; i < 3; ++i)
+			{
+				unsigned int head = heads[i];
+				heads[i] = t;
+
+				for (unsigned int j = head; j < tail; ++j, ++t)
+					mono[t] = d[i] * mono[j];
+			}
+		}
+	}
+
+	// This thread's buffer for the monomials of one expansion, grown to nTerms; kept across calls so evaluate(),
+	// which runs on many threads at once and on a few points at a time during advection, allocates nothing
+	double* monomialScratch(unsigned int nTerms)
+	{
+		thread_local std::vector<double> mono;
+		if (mono.size() < nTerms)
+			mono.resize(nTerms);
+
+		return mono.data();
+	}
+
+	// Smallest order p whose Taylor remainder is below eps for a target at distance d from the center of a
+	// box of radius rx (both in units of h). A center at distance a contributes at most
+	// (2ad)^p / p! * exp(-(a - d)^2), which over a in [0, rx] peaks at a = (d + sqrt(d^2 + 2p)) / 2.
+	// Capped at maxOrder.
+	unsigned int truncationOrder(double rx, double d, double eps, unsigned int maxOrder)
+	{
+		if (rx <= 0.0 || d <= 0.0)
+			return 1u;
+
+		const double logEps = std::log(eps);
+
+		double logFactorial = 0.0;
+		for (unsigned int order = 1u; order < maxOrder; ++order)
+		{
+			logFactorial += std::log(static_cast<double>(order));
+
+			double a = std::min(rx, 0.5 * (d + std::sqrt(d * d + 2.0 * order)));
+			double logRemainder = order * std::log(2.0 * a * d) - logFactorial - (a - d) * (a - d);
+
+			if (logRemainder <= logEps)
+				return order;
+		}
+
+		return maxOrder;
+	}
+
+	// Highest order any target within the cutoff rx + tail of a box of radius rx needs
+	unsigned int worstTruncationOrder(double rx, double tail, double eps, unsigned int maxOrder)
+	{
+		const unsigned int steps = 256u;
+
+		unsigned int order = 1u;
+		for (unsigned int s = 1u; s <= steps; ++s)
+			order = std::max(order, truncationOrder(rx, (rx + tail) * s / steps, eps, maxOrder));
+
+		return order;
+	}
+
+	// 2^|a| / a! for every multi-index a, in the order computeMonomials produces them
+	void computeTermConstants(unsigned int order, std::vector<double> &constants)
+	{
+		unsigned int nTerms = termCount(order);
+
+		std::vector<int> exponents(3u * nTerms, 0);
+		unsigned int heads[3] = { 0u, 0u, 0u };
+
+		unsigned int t = 1u;
+		for (unsigned int k = 1u, tail = 1u; k < order; ++k, tail = t)
+		{
+			for (int i = 0; i < 3; ++i)
+			{
+				unsigned int head = heads[i];
+				heads[i] = t;
+
+				for (unsigned int j = head; j < tail; ++j, ++t)
+				{
+					for (int a = 0; a < 3; ++a)
+						exponents[3u * t + a] = exponents[3u * j + a];
+					++exponents[3u * t + i];
+				}
+			}
+		}
+
+		constants.resize(nTerms);
+		for (unsigned int n = 0u; n < nTerms; ++n)
+		{
+			double c = 1.0;
+			for (int a = 0; a < 3; ++a)
+				for (int e = 1; e <= exponents[3u * n + a]; ++e)
+					c *= 2.0 / static_cast<double>(e);
+
+			constants[n] = c;
+		}
+	}
+}
+
+FGTEvaluator::FGTEvaluator()
+	: m_dBandwidth(1.0)
+	, m_dCutoff(0.0)
+	, m_dErrorBound(0.0)
+	, m_dTail(0.0)
+	, m_uiOrder(1u)
+	, m_uiTerms(1u)
+	, m_uiBoxesPerAxis(1u)
+{
+}
+
+FGTEvaluator::~FGTEvaluator()
+{
+}
+
+void FGTEvaluator::setControlPoints(const std::vector<glm::vec3> &positions, const Eigen::VectorXf &lambdaX, const Eigen::VectorXf &lambdaY, const Eigen::VectorXf &lambdaZ, float eta, float tolerance)
+{
+	m_vClusterCenters.clear();
+	m_vClusterRadii.clear();
+	m_vOrderTable.clear();
+	m_vBoxClusters.clear();
+	m_vCoefficients.clear();
+
+	if (positions.empty())
+		return;
+
+	const double h = 1.0 / std::sqrt(static_cast<double>(eta));
+	const double eps = std::max(static_cast<double>(tolerance), 1e-12);
+
+	m_dBandwidth = h;
+
+	glm::vec3 lo(positions[0]), hi(positions[0]);
+	for (auto const &p : positions)
+	{
+		lo = glm::min(lo, p);
+		hi = glm::max(hi, p);
+	}
+
+	glm::vec3 extent = glm::max(hi - lo, glm::vec3(1e-6f));
+
+	std::vector<unsigned int> boxOf(positions.size());
+
+	const double tail = std::sqrt(std::log(1.0 / eps)); // sources beyond h * tail from a target add less than eps each
+
+	// a few centers stand in for the targets when estimating the cost of a layout
+	const size_t sampleStride = std::max<size_t>(positions.size() / 64u, 1u);
+
+	// pick the box count per axis with the lowest estimated per-target cost that meets the tolerance:
+	//     -a box is skipped for targets farther than its radius plus h * tail, which sets the cutoff
+	//     -the Taylor remainder sets the order (see truncationOrder); evaluate() applies it per target and
+	//      box, so only the worst case has to stay within MAX_ORDER
+	double bestCost = std::numeric_limits<double>::max();
+	unsigned int bestBoxes = 0u;
+
+	for (unsigned int b = 1u; b <= MAX_BOXES_PER_AXIS; ++b)
+	{
+		glm::vec3 side = extent / static_cast<float>(b);
+
+		std::vector<double> radius(b * b * b, -1.0);
+		for (size_t i = 0u; i < positions.size(); ++i)
+		{
+			glm::uvec3 c = glm::min(glm::uvec3((positions[i] - lo) / side), glm::uvec3(b - 1u));
+			glm::vec3 center = lo + (glm::vec3(c) + 0.5f) * side;
+
+			double &r = radius[(c.z * b + c.y) * b + c.x];
+			r = std::max(r, static_cast<double>(glm::length(positions[i] - center)) / h);
+		}
+
+		double rx = *std::max_element(radius.begin(), radius.end());
+		if (worstTruncationOrder(rx, tail, eps, MAX_ORDER + 1u) > MAX_ORDER)
+			continue;
+
+		double cost = 0.0;
+		for (size_t i = 0u; i < positions.size(); i += sampleStride)
+		{
+			for (unsigned int box = 0u; box < radius.size(); ++box)
+			{
+				if (radius[box] < 0.0)
+					continue;
+
+				glm::uvec3 c(box % b, (box / b) % b, box / (b * b));
+				glm::vec3 center = lo + (glm::vec3(c) + 0.5f) * side;
+				double d = glm::length(positions[i] - center) / h;
+
+				// the distance test itself is paid for every box
+				cost += 1.0;
+				if (d <= radius[box] + tail)
+					cost += termCount(truncationOrder(radius[box], d, eps, MAX_ORDER));
+			}
+		}
+
+		if (cost < bestCost)
+		{
+			bestCost = cost;
+			bestBoxes = b;
+		}
+	}
+
+	// no layout meets the tolerance within MAX_ORDER (very narrow Gaussians); use the finest one, whose
+	// error is then not bounded by the tolerance
+	if (bestBoxes == 0u)
+		bestBoxes = MAX_BOXES_PER_AXIS;
+
+	m_dTail = tail;
+
+	m_uiBoxesPerAxis = bestBoxes;
+
+	// compact the non-empty boxes into clusters
+	unsigned int b = bestBoxes;
+	glm::vec3 side = extent / static_cast<float>(b);
+	std::vector<int> &clusterOfBox = m_vBoxClusters;
+	clusterOfBox.assign(b * b * b, -1);
+
+	m_vec3Origin = lo;
+	m_vec3BoxSize = side;
+
+	for (size_t i = 0u; i < positions.size(); ++i)
+	{
+		glm::uvec3 c = glm::min(glm::uvec3((positions[i] - lo) / side), glm::uvec3(b - 1u));
+		unsigned int box = (c.z * b + c.y) * b + c.x;
+
+		if (clusterOfBox[box] < 0)
+		{
+			clusterOfBox[box] = static_cast<int>(m_vClusterCenters.size() / 3u);
+
+			glm::vec3 center = lo + (glm::vec3(c) + 0.5f) * side;
+			m_vClusterCenters.push_back(center.x);
+			m_vClusterCenters.push_back(center.y);
+			m_vClusterCenters.push_back(center.z);
+			m_vClusterRadii.push_back(0.0);
+		}
+
+		boxOf[i] = static_cast<unsigned int>(clusterOfBox[box]);
+
+		const double *center = &m_vClusterCenters[3u * boxOf[i]];
+		double r = glm::length(glm::dvec3(positions[i]) - glm::dvec3(center[0], center[1], center[2])) / h;
+		m_vClusterRadii[boxOf[i]] = std::max(m_vClusterRadii[boxOf[i]], r);
+	}
+
+	// the expansions are stored up to the order the worst-case cluster and target distance needs
+	double rx = *std::max_element(m_vClusterRadii.begin(), m_vClusterRadii.end());
+	m_uiOrder = worstTruncationOrder(rx, tail, eps, MAX_ORDER);
+	m_uiTerms = termCount(m_uiOrder);
+	m_dCutoff = (rx + tail) * h;
+
+	// per-box orders by distance, so evaluate() only needs a lookup; each bin holds the larger of its edges' orders
+	m_vOrderTable.resize(m_vClusterRadii.size() * ORDER_BINS);
+	for (size_t k = 0u; k < m_vClusterRadii.size(); ++k)
+	{
+		double binWidth = (m_vClusterRadii[k] + tail) / ORDER_BINS;
+		unsigned int left = truncationOrder(m_vClusterRadii[k], 0.0, eps, m_uiOrder);
+
+		for (unsigned int bin = 0u; bin < ORDER_BINS; ++bin)
+		{
+			unsigned int right = truncationOrder(m_vClusterRadii[k], binWidth * (bin + 1u), eps, m_uiOrder);
+			m_vOrderTable[k * ORDER_BINS + bin] = static_cast<unsigned char>(std::max(left, right));
+			left = right;
+		}
+	}
+
+	// Taylor remainder plus the skipped boxes, each at most eps; without a layout within MAX_ORDER nothing is bounded
+	m_dErrorBound = bestCost < std::numeric_limits<double>::max() ? 2.0 * eps : 1.0;
+
+	std::vector<double> constants;
+	computeTermConstants(m_uiOrder, constants);
+
+	m_vCoefficients.assign(m_vClusterCenters.size() * m_uiTerms, 0.0);
+
+	double *mono = monomialScratch(m_uiTerms);
+
+	// C_a = 2^|a| / a! * sum_i lambda_i exp(-|dx_i|^2) dx_i^a, with dx_i = (x_i - center) / h
+	for (size_t i = 0u; i < positions.size(); ++i)
+	{
+		unsigned int k = boxOf[i];
+		const double *center = &m_vClusterCenters[3u * k];
+
+		double d[3] = {
+			(positions[i].x - center[0]) / h,
+			(positions[i].y - center[1]) / h,
+			(positions[i].z - center[2]) / h
+		};
+
+		double w = std::exp(-(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]));
+
+		computeMonomials(d, m_uiOrder, mono);
+
+		double *coeffX = &m_vCoefficients[3u * k * m_uiTerms];
+		double *coeffY = coeffX + m_uiTerms;
+		double *coeffZ = coeffY + m_uiTerms;
+		for (unsigned int t = 0u; t < m_uiTerms; ++t)
+		{
+			double m = w * constants[t] * mono[t];
+			coeffX[t] += m * lambdaX[i];
+			coeffY[t] += m * lambdaY[i];
+			coeffZ[t] += m * lambdaZ[i];
+		}
+	}
+}
+
+void FGTEvaluator::evaluate(const float *xyz, size_t n, float *out) const
+{
+	if (m_vClusterCenters.empty())
+	{
+		std::fill(out, out + 3u * n, 0.f);
+		return;
+	}
+
+	const double invH = 1.0 / m_dBandwidth;
+	const int b = static_cast<int>(m_uiBoxesPerAxis);
+
+	double *mono = monomialScratch(m_uiTerms);
+
+	for (size_t i = 0u; i < n; ++i)
+	{
+		glm::vec3 pt(xyz[3u * i + 0u], xyz[3u * i + 1u], xyz[3u * i + 2u]);
+
+		// only boxes whose center can lie within the largest cutoff are visited
+		glm::ivec3 lo = glm::ivec3(glm::floor((pt - m_vec3Origin - static_cast<float>(m_dCutoff)) / m_vec3BoxSize));
+		glm::ivec3 hi = glm::ivec3(glm::floor((pt - m_vec3Origin + static_cast<float>(m_dCutoff)) / m_vec3BoxSize));
+		lo = glm::max(lo, glm::ivec3(0));
+		hi = glm::min(hi, glm::ivec3(b - 1));
+
+		double sum[3] = { 0.0, 0.0, 0.0 };
+
+		for (int z = lo.z; z <= hi.z; ++z)
+		{
+			for (int y = lo.y; y <= hi.y; ++y)
+			{
+				for (int x = lo.x; x <= hi.x; ++x)
+				{
+					int k = m_vBoxClusters[(z * b + y) * b + x];
+					if (k < 0)
+						continue;
+
+					const double *center = &m_vClusterCenters[3u * k];
+
+					double d[3] = {
+						(pt.x - center[0]) * invH,
+						(pt.y - center[1]) * invH,
+						(pt.z - center[2]) * invH
+					};
+
+					double dist2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+					double reach = m_vClusterRadii[k] + m_dTail;
+					if (dist2 > reach * reach)
+						continue;
+
+					// terms are graded by degree, so a lower order is a prefix of the stored expansion
+					unsigned int bin = std::min(static_cast<unsigned int>(std::sqrt(dist2) / reach * ORDER_BINS), ORDER_BINS - 1u);
+					unsigned int nTerms = termCount(m_vOrderTable[k * ORDER_BINS + bin]);
+
+					computeMonomials(d, m_vOrderTable[k * ORDER_BINS + bin], mono);
+
+					const double *coeffX = &m_vCoefficients[3u * k * m_uiTerms];
+					const double *coeffY = coeffX + m_uiTerms;
+					const double *coeffZ = coeffY + m_uiTerms;
+					double cx = 0.0, cy = 0.0, cz = 0.0;
+					for (unsigned int t = 0u; t < nTerms; ++t)
+					{
+						cx += coeffX[t] * mono[t];
+						cy += coeffY[t] * mono[t];
+						cz += coeffZ[t] * mono[t];
+					}
+
+					double w = std::exp(-dist2);
+					sum[0] += w * cx;
+					sum[1] += w * cy;
+					sum[2] += w * cz;
+				}
+			}
+		}
+
+		out[3u * i + 0u] = static_cast<float>(sum[0]);
+		out[3u * i + 1u] = static_cast<float>(sum[1]);
+		out[3u * i + 2u] = static_cast<float>(sum[2]);
+	}
+}
+
+const char* FGTEvaluator::getName() const
+{
+	return "fgt";
+}
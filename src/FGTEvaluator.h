@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <Eigen/Dense>
+
+#include "FieldEvaluator.h"
+
+// Evaluates a Gaussian RBF vector field with the improved Fast Gauss Transform. The centers' bounding
+// box is split into B^3 boxes; each box's centers are collapsed into a truncated multivariate Taylor
+// expansion about the box center, and a target only sums the expansions of boxes within a cutoff
+// radius, each truncated to the order its distance needs. B and the orders follow from the error
+// tolerance, so for a fixed eta the cost is O(N + M) instead of the O(N * M) of the direct sum.
+// The constant is large, though: against the SIMD direct sum it only pays off for wide Gaussians (eta around
+// 1 on the unit cube) with N beyond about 10,000. --checkfgt at eta 1.2 and 4096 targets measured 0.021 s against
+// 0.019 s direct at N = 10,000 and 0.028 s against 0.23 s at N = 100,000. Narrower Gaussians (eta 5 and 20) need
+// hundreds of boxes or more and were slower than the direct sum at every N measured, up to 100,000.
+class FGTEvaluator : public FieldEvaluator
+{
+public:
+	// Truncation orders above this are not used; a box layout that would need more is skipped
+	static const unsigned int MAX_ORDER = 40u;
+	static const unsigned int MAX_BOXES_PER_AXIS = 16u;
+
+	// Distance bins of the per-box truncation order lookup
+	static const unsigned int ORDER_BINS = 64u;
+
+public:
+	FGTEvaluator();
+	~FGTEvaluator();
+
+	// The tolerance bounds the absolute error of each component relative to the sum of |lambda| of that component
+	void setControlPoints(const std::vector<glm::vec3> &positions, const Eigen::VectorXf &lambdaX, const Eigen::VectorXf &lambdaY, const Eigen::VectorXf &lambdaZ, float eta, float tolerance = 1e-4f);
+
+	void evaluate(const float *xyz, size_t n, float *out) const override;
+
+	const char* getName() const override;
+
+	unsigned int getOrder() const { return m_uiOrder; }
+	unsigned int getTermCount() const { return m_uiTerms; }
+	unsigned int getClusterCount() const { return static_cast<unsigned int>(m_vClusterCenters.size() / 3u); }
+	unsigned int getBoxesPerAxis() const { return m_uiBoxesPerAxis; }
+	float getCutoffRadius() const { return static_cast<float>(m_dCutoff); } // largest over the boxes
+
+	// Error bound the parameters were chosen for, relative to sum |lambda|
+	float getErrorBound() const { return static_cast<float>(m_dErrorBound); }
+
+private:
+	double m_dBandwidth; // h = 1 / sqrt(eta), so the Gaussian is exp(-|x - y|^2 / h^2)
+	double m_dCutoff;
+	double m_dErrorBound;
+	double m_dTail;      // a box is skipped beyond its radius plus this (in units of h)
+
+	unsigned int m_uiOrder; // highest order any box needs; coefficients are stored up to it
+	unsigned int m_uiTerms;
+	unsigned int m_uiBoxesPerAxis;
+
+	glm::vec3 m_vec3Origin;
+	glm::vec3 m_vec3BoxSize;
+	std::vector<int> m_vBoxClusters; // cluster index per box, -1 if empty
+
+	std::vector<double> m_vClusterCenters; // xyz per non-empty box
+	std::vector<double> m_vClusterRadii;   // largest center distance from its box center, in units of h
+	std::vector<unsigned char> m_vOrderTable; // per box, ORDER_BINS truncation orders over [0, radius + tail]
+	std::vector<double> m_vCoefficients;   // per box: x, y and z coefficient runs of m_uiTerms each
+};
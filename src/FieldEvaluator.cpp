@@ -0,0 +1,53 @@
+#include "FieldEvaluator.h"
+
+namespace
+{
+	// Points per batch of the finite difference fallback, sized so its buffers fit on the stack
+	const size_t DIFFERENCE_BLOCK = 64u;
+
+	// Central difference step; fields here vary on the scale of the [-1, 1] domain
+	const float DIFFERENCE_STEP = 1e-3f;
+}
+
+void FieldEvaluator::evaluateJacobian(const float *xyz, size_t n, float *out, float *jacobian) const
+{
+	evaluate(xyz, n, out);
+
+	// the six offset copies of a block of points go through one evaluate() call
+	float offsetPoints[6u * 3u * DIFFERENCE_BLOCK];
+	float offsetValues[6u * 3u * DIFFERENCE_BLOCK];
+
+	for (size_t p0 = 0u; p0 < n; p0 += DIFFERENCE_BLOCK)
+	{
+		size_t count = n - p0 < DIFFERENCE_BLOCK ? n - p0 : DIFFERENCE_BLOCK;
+
+		for (size_t p = 0u; p < count; ++p)
+		{
+			for (unsigned int d = 0u; d < 3u; ++d)
+			{
+				float *plus = offsetPoints + 3u * ((2u * d) * count + p);
+				float *minus = offsetPoints + 3u * ((2u * d + 1u) * count + p);
+
+				for (unsigned int k = 0u; k < 3u; ++k)
+					plus[k] = minus[k] = xyz[3u * (p0 + p) + k];
+
+				plus[d] += DIFFERENCE_STEP;
+				minus[d] -= DIFFERENCE_STEP;
+			}
+		}
+
+		evaluate(offsetPoints, 6u * count, offsetValues);
+
+		for (size_t p = 0u; p < count; ++p)
+		{
+			for (unsigned int d = 0u; d < 3u; ++d)
+			{
+				const float *plus = offsetValues + 3u * ((2u * d) * count + p);
+				const float *minus = offsetValues + 3u * ((2u * d + 1u) * count + p);
+
+				for (unsigned int c = 0u; c < 3u; ++c)
+					jacobian[9u * (p0 + p) + 3u * c + d] = (plus[c] - minus[c]) / (2.f * DIFFERENCE_STEP);
+			}
+		}
+	}
+}
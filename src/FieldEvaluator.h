@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+
+// Common interface for the different ways of evaluating a fitted vector field, so grid
+// construction, advection and export can switch evaluation engines freely
+class FieldEvaluator
+{
+public:
+	virtual ~FieldEvaluator() {}
+
+	// Evaluate the field at n points given as packed xyz triples, writing packed xyz vectors to out.
+	// Must be safe to call concurrently from several threads.
+	virtual void evaluate(const float *xyz, size_t n, float *out) const = 0;
+
+	// Evaluate the field and its Jacobian at n points: out as for evaluate(), and jacobian receives n row-major
+	// 3x3 matrices, jacobian[9i + 3c + d] = d out_c / d x_d at point i. Engines with an analytic gradient fuse
+	// it into their pass over the centers; this default uses central differences over 6 extra evaluations.
+	virtual void evaluateJacobian(const float *xyz, size_t n, float *out, float *jacobian) const;
+
+	virtual const char* getName() const = 0;
+};
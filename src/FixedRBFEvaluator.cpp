@@ -0,0 +1,70 @@
+#include "FixedRBFEvaluator.h"
+
+#include "RBFEvaluator.h"
+
+namespace
+{
+	// The widest build of the loops the CPU can run, by the same checks RBFEvaluator dispatches on
+	FixedRBFBuild detectKernelBuild()
+	{
+#ifdef VFG_FIXED_AVX512
+		if (RBFEvaluator::isSupported(RBFEvaluator::ISA_AVX512))
+			return FIXED_RBF_AVX512;
+#endif
+#ifdef VFG_FIXED_AVX2
+		if (RBFEvaluator::isSupported(RBFEvaluator::ISA_AVX2))
+			return FIXED_RBF_AVX2;
+#endif
+		return FIXED_RBF_BASELINE;
+	}
+}
+
+std::unique_ptr<FixedRBFEvaluatorBase> FixedRBFEvaluatorBase::create(unsigned int n)
+{
+	switch (getCapacityFor(n))
+	{
+	case 8u:
+		return std::unique_ptr<FixedRBFEvaluatorBase>(new FixedRBFEvaluator<8u>());
+	case 16u:
+		return std::unique_ptr<FixedRBFEvaluatorBase>(new FixedRBFEvaluator<16u>());
+	case 32u:
+		return std::unique_ptr<FixedRBFEvaluatorBase>(new FixedRBFEvaluator<32u>());
+	default:
+		return std::unique_ptr<FixedRBFEvaluatorBase>();
+	}
+}
+
+unsigned int FixedRBFEvaluatorBase::getCapacityFor(unsigned int n)
+{
+	// three sizes keep the padding below 2x without instantiating every count
+	if (n <= 8u)
+		return 8u;
+
+	if (n <= 16u)
+		return 16u;
+
+	if (n <= MAX_CONTROL_POINTS)
+		return 32u;
+
+	return 0u;
+}
+
+bool FixedRBFEvaluatorBase::isFasterFor(unsigned int n)
+{
+	switch (getKernelBuild())
+	{
+	case FIXED_RBF_AVX512:
+		return n > 0u && n <= 16u;
+	case FIXED_RBF_AVX2:
+		return n > 0u && n <= 8u;
+	default:
+		return false;
+	}
+}
+
+FixedRBFBuild FixedRBFEvaluatorBase::getKernelBuild()
+{
+	// queried once; the evaluators read it on construction
+	static const FixedRBFBuild build = detectKernelBuild();
+	return build;
+}
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <cmath>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include <Eigen/Dense>
+
+#include "FieldEvaluator.h"
+#include "FixedRBFKernels.h"
+#include "RBFSolver.h"
+
+// Gaussian RBF fit and evaluation for a handful of control points, with the center count fixed at compile
+// time. The kernel system is a fixed-size Eigen matrix on the stack and the weights live in plain member
+// arrays, so a fit allocates nothing, and the evaluation loops have constant trip counts the compiler unrolls
+// and vectorizes. FixedRBFEvaluator<Capacity> handles up to Capacity centers; the unused slots get an
+// identity block in the kernel and zero weights, so they add nothing to the field.
+class FixedRBFEvaluatorBase : public FieldEvaluator
+{
+public:
+	// Largest control point count with a fixed-size instantiation
+	static const unsigned int MAX_CONTROL_POINTS = 32u;
+
+public:
+	virtual ~FixedRBFEvaluatorBase() {}
+
+	// Solve for n <= getCapacity() centers with LLT, falling back to LDLT and full-pivot LU like RBFSolver
+	virtual bool fit(const glm::vec3 *positions, const glm::vec3 *values, unsigned int n, float eta, float mu) = 0;
+
+	virtual unsigned int getCapacity() const = 0;
+	virtual glm::vec3 getWeight(unsigned int i) const = 0;
+
+	// Report in RBFSolver's terms (method, condition estimate, timings) of the last fit
+	const RBFSolver::Report& getReport() const { return m_Report; }
+
+	// Smallest instantiation that holds n centers (8, 16 or 32), or NULL if n > MAX_CONTROL_POINTS
+	static std::unique_ptr<FixedRBFEvaluatorBase> create(unsigned int n);
+	static unsigned int getCapacityFor(unsigned int n); // 0 if n > MAX_CONTROL_POINTS
+
+	// Whether fitting n centers here beats the SIMD RBFEvaluator. The loops vectorize only as wide as they are
+	// compiled for, so evaluate() runs an AVX2 or AVX-512 build of them where the CPU has it; the baseline SSE2
+	// build is about 3x slower than RBFEvaluator and is never preferred. Each build wins against RBFEvaluator on
+	// the same instruction set up to a point (100k points): AVX-512 up to 16 centers (n = 6 0.33 vs 0.52 ms,
+	// n = 16 0.76 vs 1.1 ms; 32 is not reliably ahead), AVX2 only up to 8 (n = 6 0.75 vs 0.82 ms, n = 16 1.8 vs
+	// 1.6 ms).
+	static bool isFasterFor(unsigned int n);
+
+	// Build of the loops evaluate() and evaluateJacobian() run on this CPU
+	static FixedRBFBuild getKernelBuild();
+
+protected:
+	RBFSolver::Report m_Report;
+};
+
+template <unsigned int Capacity>
+class FixedRBFEvaluator : public FixedRBFEvaluatorBase
+{
+public:
+	typedef Eigen::Matrix<float, Capacity, Capacity> KernelMatrix;
+	typedef Eigen::Matrix<float, Capacity, 3> WeightMatrix;
+
+public:
+	FixedRBFEvaluator()
+		: m_eBuild(getKernelBuild())
+	{
+		for (unsigned int j = 0u; j < Capacity; ++j)
+			m_Centers.x[j] = m_Centers.y[j] = m_Centers.z[j] = m_Centers.lambdaX[j] = m_Centers.lambdaY[j] = m_Centers.lambdaZ[j] = 0.f;
+
+		m_Centers.count = 0u;
+		m_Centers.eta = 1.f;
+
+		m_Report.method = RBFSolver::METHOD_LLT;
+		m_Report.success = false;
+		m_Report.regularization = 0.f;
+		m_Report.conditionEstimate = 0.f;
+		m_Report.factorSeconds = 0.0;
+		m_Report.solveSeconds = 0.0;
+		m_Report.iterations = 0u;
+		m_Report.residual = 0.f;
+		m_Report.nonZeros = static_cast<size_t>(Capacity) * Capacity;
+	}
+
+	bool fit(const glm::vec3 *positions, const glm::vec3 *values, unsigned int n, float eta, float mu) override
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+
+		m_Centers.eta = eta;
+		m_Centers.count = std::min(n, Capacity);
+		m_Report.regularization = mu;
+
+		for (unsigned int j = 0u; j < Capacity; ++j)
+		{
+			// unused slots sit at the origin; their weights come out zero below
+			glm::vec3 p = j < n ? positions[j] : glm::vec3(0.f);
+			m_Centers.x[j] = p.x;
+			m_Centers.y[j] = p.y;
+			m_Centers.z[j] = p.z;
+		}
+
+		KernelMatrix kernel = KernelMatrix::Identity();
+		WeightMatrix rhs = WeightMatrix::Zero();
+		for (unsigned int i = 0u; i < n; ++i)
+		{
+			kernel(i, i) = 1.f + mu;
+			for (unsigned int j = 0u; j < i; ++j)
+			{
+				glm::vec3 d = positions[i] - positions[j];
+				kernel(i, j) = kernel(j, i) = std::exp(-eta * glm::dot(d, d));
+			}
+
+			rhs.row(i) << values[i].x, values[i].y, values[i].z;
+		}
+
+		// the fixed-size decompositions keep their storage inline as well
+		WeightMatrix lambdas;
+
+		// each method in turn until one produces finite weights: a near singular kernel can factor and still
+		// overflow in the solve
+		m_Report.success = false;
+
+		Eigen::LLT<KernelMatrix> llt(kernel);
+		if (llt.info() == Eigen::Success)
+		{
+			lambdas = llt.solve(rhs);
+			m_Report.method = RBFSolver::METHOD_LLT;
+			m_Report.conditionEstimate = 1.f / llt.rcond();
+			m_Report.success = lambdas.allFinite();
+		}
+
+		if (!m_Report.success)
+		{
+			Eigen::LDLT<KernelMatrix> ldlt(kernel);
+			if (ldlt.info() == Eigen::Success)
+			{
+				lambdas = ldlt.solve(rhs);
+				m_Report.method = RBFSolver::METHOD_LDLT;
+				m_Report.conditionEstimate = 1.f / ldlt.rcond();
+				m_Report.success = lambdas.allFinite();
+			}
+		}
+
+		if (!m_Report.success)
+		{
+			Eigen::FullPivLU<KernelMatrix> lu(kernel);
+			lambdas = lu.solve(rhs);
+			m_Report.method = RBFSolver::METHOD_FULL_PIV_LU;
+			m_Report.conditionEstimate = 1.f / lu.rcond();
+		}
+
+		m_Report.success = lambdas.allFinite();
+		if (!m_Report.success)
+			lambdas.setZero();
+
+		for (unsigned int j = 0u; j < Capacity; ++j)
+		{
+			m_Centers.lambdaX[j] = lambdas(j, 0);
+			m_Centers.lambdaY[j] = lambdas(j, 1);
+			m_Centers.lambdaZ[j] = lambdas(j, 2);
+		}
+
+		m_Report.factorSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		m_Report.solveSeconds = 0.0;
+
+		return m_Report.success;
+	}
+
+	void evaluate(const float *xyz, size_t n, float *out) const override
+	{
+		switch (m_eBuild)
+		{
+#ifdef VFG_FIXED_AVX512
+		case FIXED_RBF_AVX512:
+			evaluateFixedAVX512(m_Centers, xyz, n, out);
+			break;
+#endif
+#ifdef VFG_FIXED_AVX2
+		case FIXED_RBF_AVX2:
+			evaluateFixedAVX2(m_Centers, xyz, n, out);
+			break;
+#endif
+		default:
+			FixedRBFKernels<Capacity, FIXED_RBF_BASELINE>::evaluate(m_Centers, xyz, n, out);
+			break;
+		}
+	}
+
+	void evaluateJacobian(const float *xyz, size_t n, float *out, float *jacobian) const override
+	{
+		switch (m_eBuild)
+		{
+#ifdef VFG_FIXED_AVX512
+		case FIXED_RBF_AVX512:
+			evaluateFixedJacobianAVX512(m_Centers, xyz, n, out, jacobian);
+			break;
+#endif
+#ifdef VFG_FIXED_AVX2
+		case FIXED_RBF_AVX2:
+			evaluateFixedJacobianAVX2(m_Centers, xyz, n, out, jacobian);
+			break;
+#endif
+		default:
+			FixedRBFKernels<Capacity, FIXED_RBF_BASELINE>::evaluateJacobian(m_Centers, xyz, n, out, jacobian);
+			break;
+		}
+	}
+
+	const char* getName() const override
+	{
+		return "fixed";
+	}
+
+	unsigned int getCapacity() const override
+	{
+		return Capacity;
+	}
+
+	glm::vec3 getWeight(unsigned int i) const override
+	{
+		return glm::vec3(m_Centers.lambdaX[i], m_Centers.lambdaY[i], m_Centers.lambdaZ[i]);
+	}
+
+private:
+	FixedRBFCenters<Capacity> m_Centers;
+	FixedRBFBuild m_eBuild;
+};
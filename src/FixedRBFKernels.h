@@ -0,0 +1,282 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// The evaluation loops of FixedRBFEvaluator, kept free of Eigen and glm so that FixedRBFKernelsAVX2.cpp and
+// FixedRBFKernelsAVX512.cpp can compile them for wider instruction sets while the rest of the program targets
+// the baseline. They are plain loops with constant trip counts that the compiler unrolls and vectorizes as wide
+// as the translation unit allows; FixedRBFEvaluatorBase::getKernelBuild() picks the build at run time.
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define VFG_FIXED_AVX2
+
+// /arch:AVX512 first shipped with VS2017 15.3, as did the AVX-512 intrinsics RBFEvaluator uses
+#if !defined(_MSC_VER) || _MSC_VER >= 1911
+#define VFG_FIXED_AVX512
+#endif
+#endif
+
+// Instruction set a build of the loops was compiled for
+enum FixedRBFBuild {
+	FIXED_RBF_BASELINE = 0,
+	FIXED_RBF_AVX2,
+	FIXED_RBF_AVX512
+};
+
+template <unsigned int Capacity>
+struct FixedRBFCenters {
+	float x[Capacity], y[Capacity], z[Capacity];
+	float lambdaX[Capacity], lambdaY[Capacity], lambdaZ[Capacity];
+	unsigned int count; // centers fitted; the slots past it hold zero weights
+	float eta;
+};
+
+// Build names the translation unit the loops are compiled in. It does not change the code, but gives each build
+// its own symbols, so the linker cannot merge the AVX2 or AVX-512 copies with the baseline ones.
+template <unsigned int Capacity, FixedRBFBuild Build>
+struct FixedRBFKernels
+{
+	// Points per pass of evaluate(), one per SIMD lane once its inner loop is vectorized
+	static const unsigned int POINT_LANES = 16u;
+
+	// exp(x) for x <= 0 with the Cephes expf reduction and polynomial the SIMD RBFEvaluator kernels use, written
+	// as plain arithmetic without float to int conversions so the loop over the centers vectorizes
+	static float negativeExp(float x)
+	{
+		// exp(x) underflows below here anyway, and the biased exponent below stays positive. The clamp is a select
+		// written as arithmetic: under strict floating point a compare and branch keeps the loop from vectorizing.
+		const float lowest = -87.3365f;
+		bool below = x < lowest;
+		x = below * lowest + !below * x;
+
+		// adding 1.5 * 2^23 rounds x / ln 2 to an integer n and leaves n + 127 in the low mantissa bits
+		const float shifter = 12582912.f + 127.f;
+		float t = x * 1.44269504088896341f + shifter;
+		float fx = t - shifter;
+		x -= fx * 0.693359375f;
+		x -= fx * -2.12194440e-4f;
+
+		float y = 1.9875691500e-4f;
+		y = y * x + 1.3981999507e-3f;
+		y = y * x + 8.3334519073e-3f;
+		y = y * x + 4.1665795894e-2f;
+		y = y * x + 1.6666665459e-1f;
+		y = y * x + 5.0000001201e-1f;
+		y = y * x * x + x + 1.f;
+
+		// 2^n: shift n + 127 from the mantissa into the exponent field
+		uint32_t bits;
+		std::memcpy(&bits, &t, sizeof(float));
+		bits <<= 23;
+
+		float scale;
+		std::memcpy(&scale, &bits, sizeof(float));
+
+		return y * scale;
+	}
+
+	static void evaluate(const FixedRBFCenters<Capacity> &cp, const float *xyz, size_t n, float *out)
+	{
+		// full packets hold one point per lane and broadcast the centers: the few centers of a small fit fill a
+		// fraction of a vector, a packet of points always fills it, and the loop stops at the centers fitted
+		size_t packed = n / POINT_LANES * POINT_LANES;
+		for (size_t i0 = 0u; i0 < packed; i0 += POINT_LANES)
+		{
+			float px[POINT_LANES], py[POINT_LANES], pz[POINT_LANES];
+			for (unsigned int l = 0u; l < POINT_LANES; ++l)
+			{
+				px[l] = xyz[3u * (i0 + l) + 0u];
+				py[l] = xyz[3u * (i0 + l) + 1u];
+				pz[l] = xyz[3u * (i0 + l) + 2u];
+			}
+
+			float sumX[POINT_LANES], sumY[POINT_LANES], sumZ[POINT_LANES];
+			for (unsigned int l = 0u; l < POINT_LANES; ++l)
+				sumX[l] = sumY[l] = sumZ[l] = 0.f;
+
+			for (unsigned int j = 0u; j < cp.count; ++j)
+			{
+				for (unsigned int l = 0u; l < POINT_LANES; ++l)
+				{
+					float dx = px[l] - cp.x[j];
+					float dy = py[l] - cp.y[j];
+					float dz = pz[l] - cp.z[j];
+					float phi = negativeExp(-cp.eta * (dx * dx + dy * dy + dz * dz));
+
+					sumX[l] += phi * cp.lambdaX[j];
+					sumY[l] += phi * cp.lambdaY[j];
+					sumZ[l] += phi * cp.lambdaZ[j];
+				}
+			}
+
+			for (unsigned int l = 0u; l < POINT_LANES; ++l)
+			{
+				out[3u * (i0 + l) + 0u] = sumX[l];
+				out[3u * (i0 + l) + 1u] = sumY[l];
+				out[3u * (i0 + l) + 2u] = sumZ[l];
+			}
+		}
+
+		// the rest, single points included, one at a time with the centers across the lanes
+		for (size_t i = packed; i < n; ++i)
+		{
+			const float px = xyz[3u * i + 0u];
+			const float py = xyz[3u * i + 1u];
+			const float pz = xyz[3u * i + 2u];
+
+			float phi[Capacity];
+			for (unsigned int j = 0u; j < Capacity; ++j)
+			{
+				float dx = px - cp.x[j];
+				float dy = py - cp.y[j];
+				float dz = pz - cp.z[j];
+				phi[j] = negativeExp(-cp.eta * (dx * dx + dy * dy + dz * dz));
+			}
+
+			float sumX = 0.f, sumY = 0.f, sumZ = 0.f;
+			for (unsigned int j = 0u; j < Capacity; ++j)
+			{
+				sumX += phi[j] * cp.lambdaX[j];
+				sumY += phi[j] * cp.lambdaY[j];
+				sumZ += phi[j] * cp.lambdaZ[j];
+			}
+
+			out[3u * i + 0u] = sumX;
+			out[3u * i + 1u] = sumY;
+			out[3u * i + 2u] = sumZ;
+		}
+	}
+
+	static void evaluateJacobian(const FixedRBFCenters<Capacity> &cp, const float *xyz, size_t n, float *out, float *jacobian)
+	{
+		const float *centers[3] = { cp.x, cp.y, cp.z };
+		const float *lambdas[3] = { cp.lambdaX, cp.lambdaY, cp.lambdaZ };
+
+		// full packets as in evaluate(), with the value and the nine moments summed per lane. The sums are spelled
+		// out per component: indexed through small arrays they kept the lane loop from vectorizing
+		size_t packed = n / POINT_LANES * POINT_LANES;
+		for (size_t i0 = 0u; i0 < packed; i0 += POINT_LANES)
+		{
+			float px[POINT_LANES], py[POINT_LANES], pz[POINT_LANES];
+			for (unsigned int l = 0u; l < POINT_LANES; ++l)
+			{
+				px[l] = xyz[3u * (i0 + l) + 0u];
+				py[l] = xyz[3u * (i0 + l) + 1u];
+				pz[l] = xyz[3u * (i0 + l) + 2u];
+			}
+
+			float sumX[POINT_LANES], sumY[POINT_LANES], sumZ[POINT_LANES];
+			float xx[POINT_LANES], xy[POINT_LANES], xz[POINT_LANES];
+			float yx[POINT_LANES], yy[POINT_LANES], yz[POINT_LANES];
+			float zx[POINT_LANES], zy[POINT_LANES], zz[POINT_LANES];
+			for (unsigned int l = 0u; l < POINT_LANES; ++l)
+			{
+				sumX[l] = sumY[l] = sumZ[l] = 0.f;
+				xx[l] = xy[l] = xz[l] = yx[l] = yy[l] = yz[l] = zx[l] = zy[l] = zz[l] = 0.f;
+			}
+
+			for (unsigned int j = 0u; j < cp.count; ++j)
+			{
+				for (unsigned int l = 0u; l < POINT_LANES; ++l)
+				{
+					float dx = px[l] - cp.x[j];
+					float dy = py[l] - cp.y[j];
+					float dz = pz[l] - cp.z[j];
+					float phi = negativeExp(-cp.eta * (dx * dx + dy * dy + dz * dz));
+
+					float wx = phi * cp.lambdaX[j];
+					float wy = phi * cp.lambdaY[j];
+					float wz = phi * cp.lambdaZ[j];
+
+					sumX[l] += wx;
+					sumY[l] += wy;
+					sumZ[l] += wz;
+
+					xx[l] += wx * dx;
+					xy[l] += wx * dy;
+					xz[l] += wx * dz;
+					yx[l] += wy * dx;
+					yy[l] += wy * dy;
+					yz[l] += wy * dz;
+					zx[l] += wz * dx;
+					zy[l] += wz * dy;
+					zz[l] += wz * dz;
+				}
+			}
+
+			const float scale = -2.f * cp.eta;
+			for (unsigned int l = 0u; l < POINT_LANES; ++l)
+			{
+				float *value = out + 3u * (i0 + l);
+				value[0] = sumX[l];
+				value[1] = sumY[l];
+				value[2] = sumZ[l];
+
+				float *gradient = jacobian + 9u * (i0 + l);
+				gradient[0] = scale * xx[l];
+				gradient[1] = scale * xy[l];
+				gradient[2] = scale * xz[l];
+				gradient[3] = scale * yx[l];
+				gradient[4] = scale * yy[l];
+				gradient[5] = scale * yz[l];
+				gradient[6] = scale * zx[l];
+				gradient[7] = scale * zy[l];
+				gradient[8] = scale * zz[l];
+			}
+		}
+
+		// the rest one at a time, the centers across the lanes
+		for (size_t i = packed; i < n; ++i)
+		{
+			// phi(j) * (p - c_j) per axis; the gradient of each term is -2 eta times that
+			float phi[Capacity], d[3][Capacity];
+			for (unsigned int j = 0u; j < Capacity; ++j)
+			{
+				for (unsigned int k = 0u; k < 3u; ++k)
+					d[k][j] = xyz[3u * i + k] - centers[k][j];
+
+				phi[j] = negativeExp(-cp.eta * (d[0][j] * d[0][j] + d[1][j] * d[1][j] + d[2][j] * d[2][j]));
+			}
+
+			for (unsigned int c = 0u; c < 3u; ++c)
+			{
+				float sum = 0.f, moment[3] = { 0.f, 0.f, 0.f };
+				for (unsigned int j = 0u; j < Capacity; ++j)
+				{
+					float weighted = phi[j] * lambdas[c][j];
+					sum += weighted;
+					moment[0] += weighted * d[0][j];
+					moment[1] += weighted * d[1][j];
+					moment[2] += weighted * d[2][j];
+				}
+
+				out[3u * i + c] = sum;
+				for (unsigned int k = 0u; k < 3u; ++k)
+					jacobian[9u * i + 3u * c + k] = -2.f * cp.eta * moment[k];
+			}
+		}
+	}
+};
+
+// The wider builds of FixedRBFKernels for the capacities FixedRBFEvaluatorBase::create() instantiates. Only call
+// them where RBFEvaluator::isSupported() holds for their instruction set.
+#ifdef VFG_FIXED_AVX2
+void evaluateFixedAVX2(const FixedRBFCenters<8u> &cp, const float *xyz, size_t n, float *out);
+void evaluateFixedAVX2(const FixedRBFCenters<16u> &cp, const float *xyz, size_t n, float *out);
+void evaluateFixedAVX2(const FixedRBFCenters<32u> &cp, const float *xyz, size_t n, float *out);
+
+void evaluateFixedJacobianAVX2(const FixedRBFCenters<8u> &cp, const float *xyz, size_t n, float *out, float *jacobian);
+void evaluateFixedJacobianAVX2(const FixedRBFCenters<16u> &cp, const float *xyz, size_t n, float *out, float *jacobian);
+void evaluateFixedJacobianAVX2(const FixedRBFCenters<32u> &cp, const float *xyz, size_t n, float *out, float *jacobian);
+#endif
+
+#ifdef VFG_FIXED_AVX512
+void evaluateFixedAVX512(const FixedRBFCenters<8u> &cp, const float *xyz, size_t n, float *out);
+void evaluateFixedAVX512(const FixedRBFCenters<16u> &cp, const float *xyz, size_t n, float *out);
+void evaluateFixedAVX512(const FixedRBFCenters<32u> &cp, const float *xyz, size_t n, float *out);
+
+void evaluateFixedJacobianAVX512(const FixedRBFCenters<8u> &cp, const float *xyz, size_t n, float *out, float *jacobian);
+void evaluateFixedJacobianAVX512(const FixedRBFCenters<16u> &cp, const float *xyz, size_t n, float *out, float *jacobian);
+void evaluateFixedJacobianAVX512(const FixedRBFCenters<32u> &cp, const float *xyz, size_t n, float *out, float *jacobian);
+#endif
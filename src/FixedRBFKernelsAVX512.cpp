@@ -0,0 +1,49 @@
+// This translation unit is compiled for AVX-512: /arch:AVX512 on this file in the MSVC project, the pragmas
+// below under GCC and Clang. It holds nothing but the FixedRBFKernels loops, which only run after a run-time
+// check, and includes no header with inline code that the rest of the program shares.
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#if defined(__clang__) && !defined(__AVX512F__)
+#pragma clang attribute push (__attribute__((target("avx512f,avx2,fma"))), apply_to = function)
+#define VFG_CLANG_TARGET_PUSHED
+#elif defined(__GNUC__) && !defined(__AVX512F__)
+#pragma GCC target("avx512f,avx2,fma")
+#endif
+#endif
+
+#include "FixedRBFKernels.h"
+
+#ifdef VFG_FIXED_AVX512
+void evaluateFixedAVX512(const FixedRBFCenters<8u> &cp, const float *xyz, size_t n, float *out)
+{
+	FixedRBFKernels<8u, FIXED_RBF_AVX512>::evaluate(cp, xyz, n, out);
+}
+
+void evaluateFixedAVX512(const FixedRBFCenters<16u> &cp, const float *xyz, size_t n, float *out)
+{
+	FixedRBFKernels<16u, FIXED_RBF_AVX512>::evaluate(cp, xyz, n, out);
+}
+
+void evaluateFixedAVX512(const FixedRBFCenters<32u> &cp, const float *xyz, size_t n, float *out)
+{
+	FixedRBFKernels<32u, FIXED_RBF_AVX512>::evaluate(cp, xyz, n, out);
+}
+
+void evaluateFixedJacobianAVX512(const FixedRBFCenters<8u> &cp, const float *xyz, size_t n, float *out, float *jacobian)
+{
+	FixedRBFKernels<8u, FIXED_RBF_AVX512>::evaluateJacobian(cp, xyz, n, out, jacobian);
+}
+
+void evaluateFixedJacobianAVX512(const FixedRBFCenters<16u> &cp, const float *xyz, size_t n, float *out, float *jacobian)
+{
+	FixedRBFKernels<16u, FIXED_RBF_AVX512>::evaluateJacobian(cp, xyz, n, out, jacobian);
+}
+
+void evaluateFixedJacobianAVX512(const FixedRBFCenters<32u> &cp, const float *xyz, size_t n, float *out, float *jacobian)
+{
+	FixedRBFKernels<32u, FIXED_RBF_AVX512>::evaluateJacobian(cp, xyz, n, out, jacobian);
+}
+#endif
+
+#ifdef VFG_CLANG_TARGET_PUSHED
+#pragma clang attribute pop
+#endif
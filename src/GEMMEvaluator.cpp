@@ -0,0 +1,86 @@
+#include "GEMMEvaluator.h"
+
+#include <algorithm>
+
+GEMMEvaluator::GEMMEvaluator()
+	: m_fEta(1.f)
+{
+}
+
+GEMMEvaluator::~GEMMEvaluator()
+{
+}
+
+void GEMMEvaluator::setControlPoints(const std::vector<glm::vec3> &positions, const Eigen::VectorXf &lambdaX, const Eigen::VectorXf &lambdaY, const Eigen::VectorXf &lambdaZ, float eta)
+{
+	Eigen::Index nCPs = static_cast<Eigen::Index>(positions.size());
+
+	m_matCenters.resize(nCPs, 5);
+	m_matLambda.resize(nCPs, 3);
+
+	for (Eigen::Index i = 0; i < nCPs; ++i)
+	{
+		const glm::vec3 &b = positions[i];
+		m_matCenters.row(i) << -2.f * b.x, -2.f * b.y, -2.f * b.z, 1.f, glm::dot(b, b);
+	}
+
+	m_matLambda.col(0) = lambdaX;
+	m_matLambda.col(1) = lambdaY;
+	m_matLambda.col(2) = lambdaZ;
+
+	m_fEta = eta;
+}
+
+void GEMMEvaluator::evaluate(const float *xyz, size_t n, float *out) const
+{
+	typedef Eigen::Matrix<float, Eigen::Dynamic, 3, Eigen::RowMajor> PackedMatrix;
+
+	Eigen::Index nCPs = m_matCenters.rows();
+
+	// tile buffers are per thread so concurrent evaluations do not share scratch space, and are kept across calls
+	// since advection evaluates a handful of points at a time; they only grow, up to one full tile
+	thread_local Eigen::MatrixXf phi;
+	thread_local Eigen::Matrix<float, Eigen::Dynamic, 5> augmented;
+
+	Eigen::Index tileRows = static_cast<Eigen::Index>(std::min(n, TILE_POINTS));
+	Eigen::Index tileCols = std::min(nCPs, TILE_CENTERS);
+
+	if (phi.rows() < tileRows || phi.cols() < tileCols)
+		phi.resize(std::max(phi.rows(), tileRows), std::max(phi.cols(), tileCols));
+
+	if (augmented.rows() < tileRows)
+		augmented.resize(tileRows, 5);
+
+	for (size_t p0 = 0u; p0 < n; p0 += TILE_POINTS)
+	{
+		Eigen::Index nPts = static_cast<Eigen::Index>(std::min(TILE_POINTS, n - p0));
+
+		Eigen::Map<const PackedMatrix> points(xyz + 3u * p0, nPts, 3);
+		Eigen::Map<PackedMatrix> result(out + 3u * p0, nPts, 3);
+
+		auto pointsAug = augmented.topRows(nPts);
+		pointsAug.leftCols(3) = points;
+		pointsAug.col(3) = points.rowwise().squaredNorm();
+		pointsAug.col(4).setOnes();
+
+		result.setZero();
+
+		for (Eigen::Index c0 = 0; c0 < nCPs; c0 += TILE_CENTERS)
+		{
+			Eigen::Index nCenters = std::min(TILE_CENTERS, nCPs - c0);
+
+			auto tile = phi.topLeftCorner(nPts, nCenters);
+
+			// squared distances ||a||^2 + ||b||^2 - 2 a.b in one product, clamped since cancellation can dip below zero
+			tile.noalias() = pointsAug * m_matCenters.middleRows(c0, nCenters).transpose();
+			tile = (-m_fEta * tile.array().max(0.f)).exp().matrix();
+
+			result.noalias() += tile * m_matLambda.middleRows(c0, nCenters);
+		}
+	}
+}
+
+const char* GEMMEvaluator::getName() const
+{
+	return "gemm";
+}
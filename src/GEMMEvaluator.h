@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <Eigen/Dense>
+
+#include "FieldEvaluator.h"
+
+// Evaluates a Gaussian RBF vector field as the matrix product Phi * Lambda, where Phi(M x N) holds
+// the basis values between M query points and N centers. Tiles of pairwise squared distances are
+// formed with ||a||^2 + ||b||^2 - 2 a.b as one product of augmented coordinate matrices, and both
+// that and the Phi * Lambda product go through Eigen's blocked GEMM (GeneralBlockPanelKernel).
+class GEMMEvaluator : public FieldEvaluator
+{
+public:
+	// Tile sizes: a Phi tile is TILE_POINTS x TILE_CENTERS floats (512 KB)
+	static const size_t TILE_POINTS = 256u;
+	static const Eigen::Index TILE_CENTERS = 512;
+
+public:
+	GEMMEvaluator();
+	~GEMMEvaluator();
+
+	void setControlPoints(const std::vector<glm::vec3> &positions, const Eigen::VectorXf &lambdaX, const Eigen::VectorXf &lambdaY, const Eigen::VectorXf &lambdaZ, float eta);
+
+	void evaluate(const float *xyz, size_t n, float *out) const override;
+
+	const char* getName() const override;
+
+private:
+	// rows [-2bx, -2by, -2bz, 1, ||b||^2] so that [ax, ay, az, ||a||^2, 1] . row = ||a - b||^2
+	Eigen::Matrix<float, Eigen::Dynamic, 5> m_matCenters; // N x 5
+	Eigen::Matrix<float, Eigen::Dynamic, 3> m_matLambda;  // N x 3
+	float m_fEta;
+};
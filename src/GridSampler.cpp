@@ -0,0 +1,429 @@
+#include "GridSampler.h"
+
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include "RBFEvaluator.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define VFG_X86
+#include <immintrin.h>
+#endif
+
+// GCC/Clang only emit wider instructions inside functions tagged for them; MSVC always allows the intrinsics
+#if defined(__GNUC__)
+#define VFG_TARGET(isa) __attribute__((target(isa)))
+#else
+#define VFG_TARGET(isa)
+#endif
+
+namespace
+{
+	// Catmull-Rom weights of the nodes at -1, 0, 1 and 2 for a position t in [0, 1] between nodes 0 and 1
+	inline void catmullRom(float t, float w[4])
+	{
+		float t2 = t * t;
+		float t3 = t2 * t;
+
+		w[0] = 0.5f * (-t + 2.f * t2 - t3);
+		w[1] = 0.5f * (2.f - 5.f * t2 + 3.f * t3);
+		w[2] = 0.5f * (t + 4.f * t2 - 3.f * t3);
+		w[3] = 0.5f * (-t2 + t3);
+	}
+
+	inline int clampIndex(int i, int last)
+	{
+		return std::min(std::max(i, 0), last);
+	}
+
+#ifdef VFG_X86
+	struct GatherGrid {
+		const float *u, *v, *w;
+		float originX, originY, originZ;
+		float invSpacing;
+		int resolution;
+	};
+
+	VFG_TARGET("avx2,fma")
+	inline void locate256(const GatherGrid &grid, __m256 p, float origin, __m256i &cell, __m256 &t)
+	{
+		// clamp to the grid box, then keep the lower corner one node short of the last so the cell exists
+		__m256 f = _mm256_mul_ps(_mm256_sub_ps(p, _mm256_set1_ps(origin)), _mm256_set1_ps(grid.invSpacing));
+		f = _mm256_min_ps(_mm256_max_ps(f, _mm256_setzero_ps()), _mm256_set1_ps(static_cast<float>(grid.resolution - 1)));
+
+		cell = _mm256_min_epi32(_mm256_cvttps_epi32(f), _mm256_set1_epi32(grid.resolution - 2));
+		t = _mm256_sub_ps(f, _mm256_cvtepi32_ps(cell));
+	}
+
+	VFG_TARGET("avx2,fma")
+	inline __m256 lerp256(__m256 a, __m256 b, __m256 t)
+	{
+		return _mm256_fmadd_ps(t, _mm256_sub_ps(b, a), a);
+	}
+
+	// Eight points per iteration; returns how many points were done (the rest are left to the scalar path)
+	VFG_TARGET("avx2,fma")
+	size_t trilinearGather(const GatherGrid &grid, const float *xyz, size_t n, float *out)
+	{
+		const int r = grid.resolution;
+		const int offsets[8] = { 0, 1, r, r + 1, r * r, r * r + 1, r * r + r, r * r + r + 1 };
+
+		size_t p = 0u;
+		for (; p + 8u <= n; p += 8u)
+		{
+			float in[3][8];
+			for (unsigned int l = 0u; l < 8u; ++l)
+			{
+				in[0][l] = xyz[3u * (p + l) + 0u];
+				in[1][l] = xyz[3u * (p + l) + 1u];
+				in[2][l] = xyz[3u * (p + l) + 2u];
+			}
+
+			__m256i cx, cy, cz;
+			__m256 tx, ty, tz;
+			locate256(grid, _mm256_loadu_ps(in[0]), grid.originX, cx, tx);
+			locate256(grid, _mm256_loadu_ps(in[1]), grid.originY, cy, ty);
+			locate256(grid, _mm256_loadu_ps(in[2]), grid.originZ, cz, tz);
+
+			__m256i base = _mm256_add_epi32(cx, _mm256_mullo_epi32(_mm256_add_epi32(cy, _mm256_mullo_epi32(cz, _mm256_set1_epi32(r))), _mm256_set1_epi32(r)));
+
+			const float *components[3] = { grid.u, grid.v, grid.w };
+			float result[3][8];
+			for (unsigned int c = 0u; c < 3u; ++c)
+			{
+				__m256 corner[8];
+				for (unsigned int k = 0u; k < 8u; ++k)
+					corner[k] = _mm256_i32gather_ps(components[c], _mm256_add_epi32(base, _mm256_set1_epi32(offsets[k])), 4);
+
+				__m256 y0 = lerp256(lerp256(corner[0], corner[1], tx), lerp256(corner[2], corner[3], tx), ty);
+				__m256 y1 = lerp256(lerp256(corner[4], corner[5], tx), lerp256(corner[6], corner[7], tx), ty);
+				_mm256_storeu_ps(result[c], lerp256(y0, y1, tz));
+			}
+
+			for (unsigned int l = 0u; l < 8u; ++l)
+			{
+				out[3u * (p + l) + 0u] = result[0][l];
+				out[3u * (p + l) + 1u] = result[1][l];
+				out[3u * (p + l) + 2u] = result[2][l];
+			}
+		}
+
+		return p;
+	}
+
+	// Per-axis stencil of four clamped node offsets and their Catmull-Rom weights
+	VFG_TARGET("avx2,fma")
+	inline void stencil256(__m256i cell, __m256 t, int stride, int last, __m256i offset[4], __m256 weight[4])
+	{
+		for (int k = 0; k < 4; ++k)
+		{
+			__m256i node = _mm256_add_epi32(cell, _mm256_set1_epi32(k - 1));
+			node = _mm256_min_epi32(_mm256_max_epi32(node, _mm256_setzero_si256()), _mm256_set1_epi32(last));
+			offset[k] = _mm256_mullo_epi32(node, _mm256_set1_epi32(stride));
+		}
+
+		__m256 t2 = _mm256_mul_ps(t, t);
+		__m256 t3 = _mm256_mul_ps(t2, t);
+		__m256 half = _mm256_set1_ps(0.5f);
+
+		weight[0] = _mm256_mul_ps(half, _mm256_sub_ps(_mm256_fmadd_ps(_mm256_set1_ps(2.f), t2, _mm256_sub_ps(_mm256_setzero_ps(), t)), t3));
+		weight[1] = _mm256_mul_ps(half, _mm256_fmadd_ps(_mm256_set1_ps(3.f), t3, _mm256_fnmadd_ps(_mm256_set1_ps(5.f), t2, _mm256_set1_ps(2.f))));
+		weight[2] = _mm256_mul_ps(half, _mm256_fnmadd_ps(_mm256_set1_ps(3.f), t3, _mm256_fmadd_ps(_mm256_set1_ps(4.f), t2, t)));
+		weight[3] = _mm256_mul_ps(half, _mm256_sub_ps(t3, t2));
+	}
+
+	VFG_TARGET("avx2,fma")
+	size_t tricubicGather(const GatherGrid &grid, const float *xyz, size_t n, float *out)
+	{
+		const int r = grid.resolution;
+
+		size_t p = 0u;
+		for (; p + 8u <= n; p += 8u)
+		{
+			float in[3][8];
+			for (unsigned int l = 0u; l < 8u; ++l)
+			{
+				in[0][l] = xyz[3u * (p + l) + 0u];
+				in[1][l] = xyz[3u * (p + l) + 1u];
+				in[2][l] = xyz[3u * (p + l) + 2u];
+			}
+
+			__m256i cx, cy, cz;
+			__m256 tx, ty, tz;
+			locate256(grid, _mm256_loadu_ps(in[0]), grid.originX, cx, tx);
+			locate256(grid, _mm256_loadu_ps(in[1]), grid.originY, cy, ty);
+			locate256(grid, _mm256_loadu_ps(in[2]), grid.originZ, cz, tz);
+
+			__m256i ox[4], oy[4], oz[4];
+			__m256 wx[4], wy[4], wz[4];
+			stencil256(cx, tx, 1, r - 1, ox, wx);
+			stencil256(cy, ty, r, r - 1, oy, wy);
+			stencil256(cz, tz, r * r, r - 1, oz, wz);
+
+			__m256 sumU = _mm256_setzero_ps();
+			__m256 sumV = _mm256_setzero_ps();
+			__m256 sumW = _mm256_setzero_ps();
+			for (int k = 0; k < 4; ++k)
+			{
+				for (int j = 0; j < 4; ++j)
+				{
+					__m256i row = _mm256_add_epi32(oz[k], oy[j]);
+					__m256 wyz = _mm256_mul_ps(wz[k], wy[j]);
+
+					for (int i = 0; i < 4; ++i)
+					{
+						__m256i index = _mm256_add_epi32(row, ox[i]);
+						__m256 weight = _mm256_mul_ps(wyz, wx[i]);
+
+						sumU = _mm256_fmadd_ps(weight, _mm256_i32gather_ps(grid.u, index, 4), sumU);
+						sumV = _mm256_fmadd_ps(weight, _mm256_i32gather_ps(grid.v, index, 4), sumV);
+						sumW = _mm256_fmadd_ps(weight, _mm256_i32gather_ps(grid.w, index, 4), sumW);
+					}
+				}
+			}
+
+			float result[3][8];
+			_mm256_storeu_ps(result[0], sumU);
+			_mm256_storeu_ps(result[1], sumV);
+			_mm256_storeu_ps(result[2], sumW);
+
+			for (unsigned int l = 0u; l < 8u; ++l)
+			{
+				out[3u * (p + l) + 0u] = result[0][l];
+				out[3u * (p + l) + 1u] = result[1][l];
+				out[3u * (p + l) + 2u] = result[2][l];
+			}
+		}
+
+		return p;
+	}
+#endif // VFG_X86
+}
+
+GridSampler::GridSampler()
+	: m_pGrid(NULL)
+	, m_eInterpolation(INTERPOLATION_TRILINEAR)
+	, m_bGather(RBFEvaluator::isSupported(RBFEvaluator::ISA_AVX2))
+{
+}
+
+GridSampler::~GridSampler()
+{
+}
+
+void GridSampler::setGrid(const VectorFieldGrid *grid)
+{
+	m_pGrid = grid;
+}
+
+void GridSampler::setInterpolation(Interpolation interpolation)
+{
+	m_eInterpolation = interpolation;
+}
+
+GridSampler::Interpolation GridSampler::getInterpolation() const
+{
+	return m_eInterpolation;
+}
+
+void GridSampler::setGather(bool enable)
+{
+	m_bGather = enable && RBFEvaluator::isSupported(RBFEvaluator::ISA_AVX2);
+}
+
+bool GridSampler::getGather() const
+{
+	return m_bGather;
+}
+
+const char* GridSampler::getName() const
+{
+	return getInterpolationName(m_eInterpolation);
+}
+
+const char* GridSampler::getInterpolationName(Interpolation interpolation)
+{
+	return interpolation == INTERPOLATION_TRICUBIC ? "tricubic" : "trilinear";
+}
+
+void GridSampler::locate(glm::vec3 pt, int cell[3], glm::vec3 &t) const
+{
+	int last = static_cast<int>(m_pGrid->getResolution()) - 1;
+	glm::vec3 f = glm::clamp((pt - m_pGrid->getOrigin()) / m_pGrid->getSpacing(), glm::vec3(0.f), glm::vec3(static_cast<float>(last)));
+
+	for (int a = 0; a < 3; ++a)
+	{
+		cell[a] = std::min(static_cast<int>(f[a]), last - 1);
+		t[a] = f[a] - static_cast<float>(cell[a]);
+	}
+}
+
+void GridSampler::fillCursor(const int cell[3], Cursor &cursor) const
+{
+	const VectorFieldGrid &grid = *m_pGrid;
+	int last = static_cast<int>(grid.getResolution()) - 1;
+
+	// trilinear reads the nodes 0 and 1 per axis, tricubic -1 to 2 (clamped at the boundary)
+	int first = m_eInterpolation == INTERPOLATION_TRICUBIC ? -1 : 0;
+	int width = m_eInterpolation == INTERPOLATION_TRICUBIC ? 4 : 2;
+
+	unsigned int node = 0u;
+	for (int k = 0; k < width; ++k)
+	{
+		unsigned int z = static_cast<unsigned int>(clampIndex(cell[2] + first + k, last));
+		for (int j = 0; j < width; ++j)
+		{
+			unsigned int y = static_cast<unsigned int>(clampIndex(cell[1] + first + j, last));
+			for (int i = 0; i < width; ++i, ++node)
+			{
+				size_t ind = grid.index(static_cast<unsigned int>(clampIndex(cell[0] + first + i, last)), y, z);
+
+				cursor.values[0][node] = grid.getU()[ind];
+				cursor.values[1][node] = grid.getV()[ind];
+				cursor.values[2][node] = grid.getW()[ind];
+			}
+		}
+	}
+
+	cursor.cell[0] = cell[0];
+	cursor.cell[1] = cell[1];
+	cursor.cell[2] = cell[2];
+}
+
+glm::vec3 GridSampler::sample(glm::vec3 pt, Cursor &cursor) const
+{
+	int cell[3];
+	glm::vec3 t;
+	locate(pt, cell, t);
+
+	if (cell[0] != cursor.cell[0] || cell[1] != cursor.cell[1] || cell[2] != cursor.cell[2])
+		fillCursor(cell, cursor);
+
+	glm::vec3 out;
+	if (m_eInterpolation == INTERPOLATION_TRICUBIC)
+	{
+		float wx[4], wy[4], wz[4];
+		catmullRom(t.x, wx);
+		catmullRom(t.y, wy);
+		catmullRom(t.z, wz);
+
+		for (int c = 0; c < 3; ++c)
+		{
+			const float *values = cursor.values[c];
+
+			float sum = 0.f;
+			for (int k = 0; k < 4; ++k)
+			{
+				for (int j = 0; j < 4; ++j)
+				{
+					const float *row = values + (k * 4 + j) * 4;
+					sum += wz[k] * wy[j] * (wx[0] * row[0] + wx[1] * row[1] + wx[2] * row[2] + wx[3] * row[3]);
+				}
+			}
+
+			out[c] = sum;
+		}
+	}
+	else
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			const float *values = cursor.values[c];
+
+			float y0 = glm::mix(glm::mix(values[0], values[1], t.x), glm::mix(values[2], values[3], t.x), t.y);
+			float y1 = glm::mix(glm::mix(values[4], values[5], t.x), glm::mix(values[6], values[7], t.x), t.y);
+			out[c] = glm::mix(y0, y1, t.z);
+		}
+	}
+
+	return out;
+}
+
+glm::vec3 GridSampler::sampleScalar(glm::vec3 pt) const
+{
+	// a fresh cursor never hits, so this is the plain stencil read and interpolation
+	Cursor cursor;
+	return sample(pt, cursor);
+}
+
+void GridSampler::evaluate(const float *xyz, size_t n, float *out) const
+{
+	size_t done = 0u;
+
+#ifdef VFG_X86
+	if (m_bGather)
+	{
+		GatherGrid grid;
+		grid.u = m_pGrid->getU();
+		grid.v = m_pGrid->getV();
+		grid.w = m_pGrid->getW();
+		grid.originX = m_pGrid->getOrigin().x;
+		grid.originY = m_pGrid->getOrigin().y;
+		grid.originZ = m_pGrid->getOrigin().z;
+		grid.invSpacing = 1.f / m_pGrid->getSpacing();
+		grid.resolution = static_cast<int>(m_pGrid->getResolution());
+
+		done = m_eInterpolation == INTERPOLATION_TRICUBIC ? tricubicGather(grid, xyz, n, out) : trilinearGather(grid, xyz, n, out);
+	}
+#endif
+
+	for (size_t p = done; p < n; ++p)
+	{
+		glm::vec3 v = sampleScalar(glm::vec3(xyz[3u * p + 0u], xyz[3u * p + 1u], xyz[3u * p + 2u]));
+
+		out[3u * p + 0u] = v.x;
+		out[3u * p + 1u] = v.y;
+		out[3u * p + 2u] = v.z;
+	}
+}
+
+GridSampler::ErrorReport GridSampler::measureError(const FieldEvaluator &exact, size_t nSamples, unsigned int seed) const
+{
+	glm::vec3 lo = m_pGrid->getOrigin();
+	float extent = m_pGrid->getSpacing() * static_cast<float>(m_pGrid->getResolution() - 1u);
+
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+	std::vector<float> points(3u * nSamples), exactOut(3u * nSamples), sampledOut(3u * nSamples);
+	for (size_t p = 0u; p < nSamples; ++p)
+	{
+		points[3u * p + 0u] = lo.x + extent * unit(rng);
+		points[3u * p + 1u] = lo.y + extent * unit(rng);
+		points[3u * p + 2u] = lo.z + extent * unit(rng);
+	}
+
+	ErrorReport report;
+	report.interpolation = m_eInterpolation;
+	report.samples = nSamples;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	exact.evaluate(points.data(), nSamples, exactOut.data());
+	auto mid = std::chrono::high_resolution_clock::now();
+	evaluate(points.data(), nSamples, sampledOut.data());
+	auto end = std::chrono::high_resolution_clock::now();
+
+	report.exactSeconds = std::chrono::duration<double>(mid - start).count();
+	report.sampledSeconds = std::chrono::duration<double>(end - mid).count();
+
+	double sumError = 0.0, sumMagnitude = 0.0;
+	report.maxError = 0.f;
+	for (size_t p = 0u; p < nSamples; ++p)
+	{
+		glm::vec3 e(exactOut[3u * p + 0u], exactOut[3u * p + 1u], exactOut[3u * p + 2u]);
+		glm::vec3 s(sampledOut[3u * p + 0u], sampledOut[3u * p + 1u], sampledOut[3u * p + 2u]);
+
+		float error = glm::length(s - e);
+		report.maxError = std::max(report.maxError, error);
+		sumError += static_cast<double>(error) * error;
+		sumMagnitude += static_cast<double>(glm::dot(e, e));
+	}
+
+	report.rmsError = nSamples ? static_cast<float>(std::sqrt(sumError / nSamples)) : 0.f;
+	report.rmsMagnitude = nSamples ? static_cast<float>(std::sqrt(sumMagnitude / nSamples)) : 0.f;
+
+	return report;
+}
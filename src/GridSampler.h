@@ -0,0 +1,78 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "FieldEvaluator.h"
+#include "VectorFieldGrid.h"
+
+// Reconstructs the field between the nodes of a VectorFieldGrid, as a cheap stand-in for the exact RBF sum
+// during advection. Points outside the grid are clamped onto its boundary. Batches of points go through an
+// AVX2 kernel that fetches the stencil of eight points at a time with gathers when the CPU has one, and
+// single particles can keep a Cursor that holds the stencil of their current cell between steps.
+class GridSampler : public FieldEvaluator
+{
+public:
+	enum Interpolation {
+		INTERPOLATION_TRILINEAR, // 2x2x2 nodes, continuous but with kinks at the cell faces
+		INTERPOLATION_TRICUBIC   // 4x4x4 nodes, Catmull-Rom per axis: C1, exact for quadratics
+	};
+
+	// Per-particle cache of the node values around the cell the particle was last sampled in; a particle
+	// advected with a small step stays in one cell for several steps, which then cost no grid reads at all
+	struct Cursor {
+		int cell[3];          // lower corner node of the cached cell, -1 when nothing is cached
+		float values[3][64];  // u, v and w at the stencil nodes, x fastest (the first 8 for trilinear)
+
+		Cursor() { reset(); }
+		void reset() { cell[0] = cell[1] = cell[2] = -1; }
+	};
+
+	// Deviation of the sampled field from the exact one at random points inside the grid
+	struct ErrorReport {
+		Interpolation interpolation;
+		size_t samples;
+		float maxError;      // largest |sampled - exact| (vector norm)
+		float rmsError;
+		float rmsMagnitude;  // RMS of |exact|, the scale the errors compare to
+		double exactSeconds; // time for all samples, batched, with the exact evaluator
+		double sampledSeconds;
+	};
+
+public:
+	GridSampler();
+	~GridSampler();
+
+	// The grid is referenced, not copied; it needs at least 2 nodes per axis whenever the sampler is used
+	void setGrid(const VectorFieldGrid *grid);
+
+	void setInterpolation(Interpolation interpolation);
+	Interpolation getInterpolation() const;
+
+	// Batched kernel with AVX2 gathers; off falls back to the scalar path (also used without AVX2)
+	void setGather(bool enable);
+	bool getGather() const;
+
+	void evaluate(const float *xyz, size_t n, float *out) const override;
+
+	const char* getName() const override;
+
+	// Sample one point, refilling the cursor only when pt has left its cell
+	glm::vec3 sample(glm::vec3 pt, Cursor &cursor) const;
+
+	// Compare against exact at nSamples points drawn uniformly from the grid's box (seeded, so repeatable)
+	ErrorReport measureError(const FieldEvaluator &exact, size_t nSamples = 100000u, unsigned int seed = 1u) const;
+
+	static const char* getInterpolationName(Interpolation interpolation);
+
+private:
+	// Cell of pt (lower corner node, clamped so the cell lies inside the grid) and the position within it in [0, 1]
+	void locate(glm::vec3 pt, int cell[3], glm::vec3 &t) const;
+
+	void fillCursor(const int cell[3], Cursor &cursor) const;
+	glm::vec3 sampleScalar(glm::vec3 pt) const;
+
+private:
+	const VectorFieldGrid *m_pGrid;
+	Interpolation m_eInterpolation;
+	bool m_bGather;
+};
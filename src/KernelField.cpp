@@ -0,0 +1,40 @@
+#include "KernelField.h"
+
+#include "BasisFunctions.h"
+#include "BasisKernelField.h"
+
+namespace
+{
+	template <typename Basis>
+	std::unique_ptr<KernelField> createForScalar(const std::string &scalar)
+	{
+		if (scalar.compare("float") == 0)
+			return std::unique_ptr<KernelField>(new BasisKernelField<Basis, float>());
+
+		if (scalar.compare("double") == 0)
+			return std::unique_ptr<KernelField>(new BasisKernelField<Basis, double>());
+
+		return std::unique_ptr<KernelField>();
+	}
+}
+
+std::unique_ptr<KernelField> KernelField::create(const std::string &basis, const std::string &scalar)
+{
+	// every basis and scalar pair is instantiated here, and only here
+	if (basis.compare(GaussianBasis::getName()) == 0)
+		return createForScalar<GaussianBasis>(scalar);
+
+	if (basis.compare(InverseMultiquadricBasis::getName()) == 0)
+		return createForScalar<InverseMultiquadricBasis>(scalar);
+
+	if (basis.compare(MultiquadricBasis::getName()) == 0)
+		return createForScalar<MultiquadricBasis>(scalar);
+
+	if (basis.compare(ThinPlateBasis::getName()) == 0)
+		return createForScalar<ThinPlateBasis>(scalar);
+
+	if (basis.compare(WendlandC2Basis::getName()) == 0)
+		return createForScalar<WendlandC2Basis>(scalar);
+
+	return std::unique_ptr<KernelField>();
+}
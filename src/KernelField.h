@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+
+#include <glm/glm.hpp>
+
+#include <Eigen/Dense>
+
+#include "FieldEvaluator.h"
+
+// A vector field fitted and evaluated with one radial basis in one scalar type, chosen at runtime through
+// create(). The implementations are BasisKernelField instantiations: the basis and the scalar are template
+// parameters, so each combination has its own fully inlined kernel loops and the only virtual call is the
+// one per fit() or evaluate() batch. Double precision keeps ill-conditioned kernels (flat Gaussians,
+// multiquadrics) solvable at the cost of half the SIMD width.
+class KernelField : public FieldEvaluator
+{
+public:
+	virtual ~KernelField() {}
+
+	// values holds one row per position; eta is the shape parameter of the basis and mu a Tikhonov term
+	// added to the kernel diagonal. Returns false if the kernel system could not be solved.
+	virtual bool fit(const std::vector<glm::vec3> &positions, const Eigen::MatrixXf &values, float eta, float mu) = 0;
+
+	virtual const char* getBasisName() const = 0;
+	virtual const char* getScalarName() const = 0;
+
+	// Factorization used by the last fit ("LLT" or "PartialPivLU") and its duration
+	virtual const char* getFactorization() const = 0;
+	virtual double getFitSeconds() const = 0;
+
+	// basis: gaussian, imq, mq, tps or wendland2; scalar: float or double. Returns NULL for unknown names.
+	static std::unique_ptr<KernelField> create(const std::string &basis, const std::string &scalar);
+};
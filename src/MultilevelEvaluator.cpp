@@ -0,0 +1,241 @@
+#include "MultilevelEvaluator.h"
+
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <numeric>
+#include <algorithm>
+
+#include <glm/gtc/constants.hpp>
+
+#include "RBFSolver.h"
+#include "SpatialGrid.h"
+#include "ThreadPool.h"
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	// data points per parallelFor index when updating the residual
+	const size_t RESIDUAL_CHUNK = 1024u;
+
+	double secondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+}
+
+MultilevelEvaluator::MultilevelEvaluator()
+	: m_dSeconds(0.0)
+{
+}
+
+MultilevelEvaluator::~MultilevelEvaluator()
+{
+}
+
+void MultilevelEvaluator::fit(const std::vector<glm::vec3> &positions, const Eigen::MatrixXf &values, float eta, float mu, CompactRBFEvaluator::Basis basis, unsigned int levels, float tolerance, ThreadPool &pool)
+{
+	Clock::time_point start = Clock::now();
+
+	size_t nPoints = positions.size();
+
+	m_vLevels.clear();
+	m_vFineEvaluators.clear();
+	m_dSeconds = 0.0;
+
+	if (nPoints == 0u)
+		return;
+
+	m_vPositions.resize(3u * nPoints);
+	std::copy(&positions[0].x, &positions[0].x + 3u * nPoints, m_vPositions.begin());
+	m_matResidual = values;
+
+	// point counts from the finest level (all points) down to the coarsest
+	std::vector<size_t> counts(1u, nPoints);
+	while ((levels == 0u ? counts.back() > COARSE_POINTS : counts.size() < levels) && counts.back() >= LEVEL_RATIO)
+		counts.push_back(counts.back() / LEVEL_RATIO);
+	std::reverse(counts.begin(), counts.end());
+
+	// a fixed seed keeps the nested subsets, and so the fit, reproducible; level l takes the first counts[l]
+	std::vector<unsigned int> shuffled(nPoints);
+	std::iota(shuffled.begin(), shuffled.end(), 0u);
+	std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(0u));
+
+	glm::vec3 lo(positions[0]), hi(positions[0]);
+	for (auto const &p : positions)
+	{
+		lo = glm::min(lo, p);
+		hi = glm::max(hi, p);
+	}
+
+	glm::vec3 extent = glm::max(hi - lo, glm::vec3(1e-3f * glm::length(hi - lo) + 1e-6f));
+	float volume = extent.x * extent.y * extent.z;
+
+	for (size_t l = 0u; l < counts.size(); ++l)
+	{
+		Clock::time_point levelStart = Clock::now();
+
+		Eigen::Index n = static_cast<Eigen::Index>(counts[l]);
+
+		std::vector<glm::vec3> levelPositions(n);
+		for (Eigen::Index i = 0; i < n; ++i)
+			levelPositions[i] = positions[shuffled[i]];
+
+		// the shuffled order scatters neighbors across memory; renumbering by grid cell keeps the kernel's
+		// nonzeros near the diagonal, so the CG products stream through memory
+		SpatialGrid grid;
+		grid.build(levelPositions, std::cbrt(volume / static_cast<float>(n)) * 2.f);
+		const std::vector<unsigned int> &order = grid.getOrder();
+
+		std::vector<unsigned int> levelIndices(n);
+		Eigen::MatrixXf rhs(n, 3);
+		for (Eigen::Index i = 0; i < n; ++i)
+		{
+			levelIndices[i] = shuffled[order[i]];
+			levelPositions[i] = positions[levelIndices[i]];
+			rhs.row(i) = m_matResidual.row(levelIndices[i]);
+		}
+
+		Level level;
+		level.points = static_cast<unsigned int>(n);
+
+		RBFSolver solver;
+		solver.setRegularization(mu);
+
+		Eigen::MatrixXf lambdas;
+		bool solved;
+
+		if (l == 0u)
+		{
+			// few points far apart, so the dense Gaussian kernel is small and still reasonably conditioned
+			Eigen::MatrixXf kernel(n, n);
+			for (Eigen::Index i = 0; i < n; ++i)
+			{
+				kernel(i, i) = 1.f;
+				for (Eigen::Index j = 0; j < i; ++j)
+				{
+					glm::vec3 d = levelPositions[i] - levelPositions[j];
+					kernel(i, j) = kernel(j, i) = std::exp(-eta * glm::dot(d, d));
+				}
+			}
+
+			solved = solver.solve(kernel, rhs, lambdas);
+
+			level.supportRadius = 0.f;
+		}
+		else
+		{
+			// about SUPPORT_NEIGHBORS points of this level fall within one support radius
+			level.supportRadius = std::cbrt(3.f * SUPPORT_NEIGHBORS * volume / (4.f * glm::pi<float>() * static_cast<float>(n)));
+
+			Eigen::SparseMatrix<float> kernel;
+			CompactRBFEvaluator::assembleKernel(levelPositions, basis, level.supportRadius, kernel);
+
+			solver.setMethod(RBFSolver::METHOD_CG);
+			solver.setTolerance(tolerance);
+
+			solved = solver.solveSparse(kernel, rhs, lambdas);
+		}
+
+		// an unconverged level still reduces the residual, which the next level picks up; only garbage is dropped
+		if (!solved && (lambdas.rows() != n || !lambdas.allFinite()))
+			lambdas = Eigen::MatrixXf::Zero(n, 3);
+
+		if (l == 0u)
+			m_CoarseEvaluator.setControlPoints(levelPositions, lambdas.col(0), lambdas.col(1), lambdas.col(2), eta);
+		else
+		{
+			m_vFineEvaluators.push_back(CompactRBFEvaluator());
+			m_vFineEvaluators.back().setControlPoints(levelPositions, lambdas.col(0), lambdas.col(1), lambdas.col(2), basis, level.supportRadius);
+		}
+
+		const RBFSolver::Report &report = solver.getReport();
+		level.nonZeros = report.nonZeros;
+		level.iterations = report.iterations;
+
+		level.residual = updateResidual(l, pool);
+		level.seconds = secondsSince(levelStart);
+
+		m_vLevels.push_back(level);
+	}
+
+	m_dSeconds = secondsSince(start);
+}
+
+float MultilevelEvaluator::updateResidual(size_t level, ThreadPool &pool)
+{
+	const FieldEvaluator *evaluator = level == 0u ? static_cast<const FieldEvaluator*>(&m_CoarseEvaluator) : &m_vFineEvaluators[level - 1u];
+
+	size_t nPoints = m_vPositions.size() / 3u;
+	size_t nChunks = (nPoints + RESIDUAL_CHUNK - 1u) / RESIDUAL_CHUNK;
+
+	std::vector<double> chunkSquares(nChunks, 0.0);
+
+	pool.parallelFor(0u, nChunks, [&](size_t c) {
+		size_t first = c * RESIDUAL_CHUNK;
+		size_t count = std::min(RESIDUAL_CHUNK, nPoints - first);
+
+		std::vector<float> flow(3u * count);
+		evaluator->evaluate(&m_vPositions[3u * first], count, flow.data());
+
+		double squares = 0.0;
+		for (size_t k = 0u; k < count; ++k)
+		{
+			for (int a = 0; a < 3; ++a)
+			{
+				float &r = m_matResidual(first + k, a);
+				r -= flow[3u * k + a];
+				squares += static_cast<double>(r) * r;
+			}
+		}
+
+		chunkSquares[c] = squares;
+	});
+
+	double total = 0.0;
+	for (double squares : chunkSquares)
+		total += squares;
+
+	return nPoints > 0u ? static_cast<float>(std::sqrt(total / (3u * nPoints))) : 0.f;
+}
+
+void MultilevelEvaluator::evaluate(const float *xyz, size_t n, float *out) const
+{
+	// nothing fitted yet
+	if (m_vLevels.empty())
+	{
+		std::fill(out, out + 3u * n, 0.f);
+		return;
+	}
+
+	m_CoarseEvaluator.evaluate(xyz, n, out);
+
+	if (m_vFineEvaluators.empty())
+		return;
+
+	// the levels add up; each fine one only looks at its centers within one support radius
+	std::vector<float> levelOut(3u * n);
+	for (auto const &evaluator : m_vFineEvaluators)
+	{
+		evaluator.evaluate(xyz, n, levelOut.data());
+
+		for (size_t k = 0u; k < 3u * n; ++k)
+			out[k] += levelOut[k];
+	}
+}
+
+const char* MultilevelEvaluator::getName() const
+{
+	return "multilevel";
+}
+
+const std::vector<MultilevelEvaluator::Level>& MultilevelEvaluator::getLevels() const
+{
+	return m_vLevels;
+}
+
+double MultilevelEvaluator::getSeconds() const
+{
+	return m_dSeconds;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <Eigen/Dense>
+
+#include "FieldEvaluator.h"
+#include "RBFEvaluator.h"
+#include "CompactRBFEvaluator.h"
+
+class ThreadPool;
+
+// Fits and evaluates a vector field as a sum of levels from coarse to fine (multilevel residual
+// interpolation). Level 0 interpolates a small random subsample with the wide global Gaussian. Each
+// finer level takes about LEVEL_RATIO times more points and interpolates whatever the levels above
+// left over at them. It uses a Wendland function whose support shrinks with the point spacing. The
+// subsets are nested and the finest level holds every point. Every fine kernel has a bounded number
+// of entries per row and a bounded condition number. So each level costs O(n) to solve with sparse
+// conjugate gradients and to evaluate, where no single shape parameter has to serve all scales.
+class MultilevelEvaluator : public FieldEvaluator
+{
+public:
+	static const unsigned int COARSE_POINTS = 64u;     // most points level 0 interpolates
+	static const unsigned int LEVEL_RATIO = 8u;        // point count growth per level, so the support halves
+	static const unsigned int SUPPORT_NEIGHBORS = 48u; // points expected within a support radius on a fine level
+
+	struct Level {
+		unsigned int points;
+		float supportRadius;     // 0 on the Gaussian level 0
+		size_t nonZeros;
+		unsigned int iterations; // CG iterations of a fine level
+		float residual;          // RMS of value - sum of the levels so far over all points and components
+		double seconds;          // solve plus residual update
+	};
+
+public:
+	MultilevelEvaluator();
+	~MultilevelEvaluator();
+
+	// values holds one row per position. Level 0 uses the Gaussian of shape eta, and the finer levels the given
+	// Wendland basis; all solves add Tikhonov parameter mu, and the fine ones stop at relative residual tolerance.
+	// levels = 0 adds levels until the coarsest holds at most COARSE_POINTS points.
+	void fit(const std::vector<glm::vec3> &positions, const Eigen::MatrixXf &values, float eta, float mu, CompactRBFEvaluator::Basis basis, unsigned int levels, float tolerance, ThreadPool &pool);
+
+	void evaluate(const float *xyz, size_t n, float *out) const override;
+
+	const char* getName() const override;
+
+	const std::vector<Level>& getLevels() const;
+	double getSeconds() const; // duration of the last fit()
+
+private:
+	// Subtract level l's contribution at every data point from m_matResidual and return the RMS of what is left
+	float updateResidual(size_t level, ThreadPool &pool);
+
+private:
+	std::vector<float> m_vPositions; // packed xyz of the data points
+	Eigen::MatrixXf m_matResidual;   // N x 3
+
+	RBFEvaluator m_CoarseEvaluator;
+	std::vector<CompactRBFEvaluator> m_vFineEvaluators; // levels 1 and up
+
+	std::vector<Level> m_vLevels;
+	double m_dSeconds;
+};
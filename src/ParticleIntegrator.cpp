@@ -0,0 +1,347 @@
+#include "ParticleIntegrator.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+	// Dormand-Prince 5(4) tableau: row s holds the weights of stages 1..s+1 for stage s+2. The last row is the
+	// fifth-order solution itself, so the seventh stage is the field at the new position (first same as last).
+	const float DP_A[6][6] = {
+		{ 1.f / 5.f },
+		{ 3.f / 40.f, 9.f / 40.f },
+		{ 44.f / 45.f, -56.f / 15.f, 32.f / 9.f },
+		{ 19372.f / 6561.f, -25360.f / 2187.f, 64448.f / 6561.f, -212.f / 729.f },
+		{ 9017.f / 3168.f, -355.f / 33.f, 46732.f / 5247.f, 49.f / 176.f, -5103.f / 18656.f },
+		{ 35.f / 384.f, 0.f, 500.f / 1113.f, 125.f / 192.f, -2187.f / 6784.f, 11.f / 84.f }
+	};
+
+	// Fifth minus fourth order weights of the seven stages, the local error estimate
+	const float DP_E[7] = { 71.f / 57600.f, 0.f, -71.f / 16695.f, 71.f / 1920.f, -17253.f / 339200.f, 22.f / 525.f, -1.f / 40.f };
+
+	// Step size control: a safety factor on the optimal step, and limits on how fast it may change
+	const float STEP_SAFETY = 0.9f;
+	const float STEP_MIN_SCALE = 0.2f;
+	const float STEP_MAX_SCALE = 5.f;
+
+	// Samples per step when looking for the sphere exit, and the accuracy of the refined root
+	const unsigned int EXIT_SAMPLES = 8u;
+	const float EXIT_THETA_TOLERANCE = 1e-6f;
+	const unsigned int EXIT_MAX_ITERATIONS = 50u;
+
+	// Three-point Gauss-Legendre nodes and weights on [0, 1], exact for polynomials up to degree five
+	const float GAUSS_NODES[3] = { 0.5f - 0.3872983346f, 0.5f, 0.5f + 0.3872983346f };
+	const float GAUSS_WEIGHTS[3] = { 5.f / 18.f, 8.f / 18.f, 5.f / 18.f };
+
+	inline unsigned long long allParticles(size_t n)
+	{
+		return n >= 64u ? ~0ull : (1ull << n) - 1ull;
+	}
+}
+
+ParticleIntegrator::ParticleIntegrator(Method method)
+	: m_eMethod(method)
+	, m_fAbsoluteTolerance(1e-5f)
+	, m_fRelativeTolerance(1e-5f)
+	, m_fMinimumStep(1e-6f)
+{
+}
+
+ParticleIntegrator::~ParticleIntegrator()
+{
+}
+
+void ParticleIntegrator::setMethod(Method method)
+{
+	m_eMethod = method;
+}
+
+ParticleIntegrator::Method ParticleIntegrator::getMethod() const
+{
+	return m_eMethod;
+}
+
+bool ParticleIntegrator::isAdaptive() const
+{
+	return m_eMethod == METHOD_RK45;
+}
+
+void ParticleIntegrator::setTolerance(float absolute, float relative)
+{
+	m_fAbsoluteTolerance = absolute;
+	m_fRelativeTolerance = relative;
+}
+
+float ParticleIntegrator::getAbsoluteTolerance() const
+{
+	return m_fAbsoluteTolerance;
+}
+
+float ParticleIntegrator::getRelativeTolerance() const
+{
+	return m_fRelativeTolerance;
+}
+
+void ParticleIntegrator::setMinimumStep(float minStep)
+{
+	m_fMinimumStep = minStep;
+}
+
+float ParticleIntegrator::getMinimumStep() const
+{
+	return m_fMinimumStep;
+}
+
+const char* ParticleIntegrator::getMethodName(Method method)
+{
+	switch (method)
+	{
+	case METHOD_EULER: return "Euler";
+	case METHOD_RK4: return "RK4";
+	case METHOD_RK45: return "RK45 (Dormand-Prince)";
+	}
+
+	return "unknown";
+}
+
+glm::vec3 ParticleIntegrator::denseOutput(const Step &step, float theta) const
+{
+	if (m_eMethod == METHOD_EULER)
+		return step.x0 + theta * (step.x1 - step.x0);
+
+	float t2 = theta * theta;
+	float t3 = t2 * theta;
+
+	return (2.f * t3 - 3.f * t2 + 1.f) * step.x0
+		+ ((t3 - 2.f * t2 + theta) * step.h) * step.v0
+		+ (3.f * t2 - 2.f * t3) * step.x1
+		+ ((t3 - t2) * step.h) * step.v1;
+}
+
+float ParticleIntegrator::arcLength(const Step &step, float theta) const
+{
+	if (m_eMethod == METHOD_EULER)
+		return theta * glm::length(step.x1 - step.x0);
+
+	// integrate the speed of the Hermite cubic over [0, theta]
+	float length = 0.f;
+	for (unsigned int g = 0u; g < 3u; ++g)
+	{
+		float t = theta * GAUSS_NODES[g];
+		float t2 = t * t;
+
+		glm::vec3 derivative = (6.f * t2 - 6.f * t) * step.x0
+			+ ((3.f * t2 - 4.f * t + 1.f) * step.h) * step.v0
+			+ (6.f * t - 6.f * t2) * step.x1
+			+ ((3.f * t2 - 2.f * t) * step.h) * step.v1;
+
+		length += GAUSS_WEIGHTS[g] * glm::length(derivative);
+	}
+
+	return theta * length;
+}
+
+bool ParticleIntegrator::findSphereExit(const Step &step, glm::vec3 center, float radius, float &theta) const
+{
+	return findSphereCrossing(step, center, radius, true, 0.f, theta);
+}
+
+bool ParticleIntegrator::findSphereCrossing(const Step &step, glm::vec3 center, float radius, bool leaving, float from, float &theta) const
+{
+	// positive on the far side of the sphere
+	float sign = leaving ? 1.f : -1.f;
+	auto distance = [&](float t) { return sign * (glm::length(denseOutput(step, t) - center) - radius); };
+
+	// the chord, or the Bezier control points of the Hermite cubic, whose convex hull holds the whole path
+	glm::vec3 hull[4] = { step.x0, step.x1, step.x0, step.x1 };
+	if (m_eMethod != METHOD_EULER)
+	{
+		hull[2] = step.x0 + (step.h / 3.f) * step.v0;
+		hull[3] = step.x1 - (step.h / 3.f) * step.v1;
+	}
+
+	if (leaving)
+	{
+		// the ball is convex, so a hull inside it keeps the path inside
+		float farthest = 0.f;
+		for (auto const &point : hull)
+			farthest = std::max(farthest, glm::length(point - center));
+
+		if (farthest < radius)
+			return false;
+	}
+	else
+	{
+		// a ball around the hull that misses the sphere keeps the path outside
+		glm::vec3 middle = 0.25f * (hull[0] + hull[1] + hull[2] + hull[3]);
+		float spread = 0.f;
+		for (auto const &point : hull)
+			spread = std::max(spread, glm::length(point - middle));
+
+		if (glm::length(middle - center) - spread > radius)
+			return false;
+	}
+
+	// bracket the first sign change
+	float a = from;
+	float fa = distance(from);
+	float b = from, fb = fa;
+
+	// only strictly across counts at from: the entry found by an inward search lies on the sphere itself, and the
+	// exit after it is still to come
+	if (fa > 0.f)
+	{
+		theta = from;
+		return true;
+	}
+
+	for (unsigned int s = 1u; s <= EXIT_SAMPLES; ++s)
+	{
+		b = from + (1.f - from) * static_cast<float>(s) / static_cast<float>(EXIT_SAMPLES);
+		fb = distance(b);
+
+		if (fb >= 0.f)
+			break;
+
+		a = b;
+		fa = fb;
+	}
+
+	if (fb < 0.f)
+		return false;
+
+	// Illinois: regula falsi that halves the weight of an end point kept twice in a row
+	int side = 0;
+	for (unsigned int i = 0u; i < EXIT_MAX_ITERATIONS && b - a > EXIT_THETA_TOLERANCE; ++i)
+	{
+		float c = (a * fb - b * fa) / (fb - fa);
+		float fc = distance(c);
+
+		if (fc >= 0.f)
+		{
+			b = c;
+			fb = fc;
+			if (side == -1)
+				fa *= 0.5f;
+			side = -1;
+		}
+		else
+		{
+			a = c;
+			fa = fc;
+			if (side == 1)
+				fb *= 0.5f;
+			side = 1;
+		}
+
+		if (fc == 0.f)
+			break;
+	}
+
+	// the end known to be across, so the crossing is never reported early
+	theta = b;
+
+	return true;
+}
+
+unsigned long long ParticleIntegrator::step(const FieldEvaluator &field, size_t n, glm::vec3 *position, glm::vec3 *velocity, const float *h, float *nextH) const
+{
+	if (m_eMethod == METHOD_RK45)
+		return stepRK45(field, n, position, velocity, h, nextH);
+
+	std::copy(h, h + n, nextH);
+
+	if (m_eMethod == METHOD_RK4)
+		return stepRK4(field, n, position, velocity, h);
+
+	return stepEuler(field, n, position, velocity, h);
+}
+
+unsigned long long ParticleIntegrator::stepEuler(const FieldEvaluator &field, size_t n, glm::vec3 *position, glm::vec3 *velocity, const float *h) const
+{
+	for (size_t i = 0u; i < n; ++i)
+		position[i] += h[i] * velocity[i];
+
+	field.evaluate(&position[0].x, n, &velocity[0].x);
+
+	return allParticles(n);
+}
+
+unsigned long long ParticleIntegrator::stepRK4(const FieldEvaluator &field, size_t n, glm::vec3 *position, glm::vec3 *velocity, const float *h) const
+{
+	glm::vec3 stage[MAX_PARTICLES], k2[MAX_PARTICLES], k3[MAX_PARTICLES], k4[MAX_PARTICLES];
+
+	for (size_t i = 0u; i < n; ++i)
+		stage[i] = position[i] + (0.5f * h[i]) * velocity[i];
+	field.evaluate(&stage[0].x, n, &k2[0].x);
+
+	for (size_t i = 0u; i < n; ++i)
+		stage[i] = position[i] + (0.5f * h[i]) * k2[i];
+	field.evaluate(&stage[0].x, n, &k3[0].x);
+
+	for (size_t i = 0u; i < n; ++i)
+		stage[i] = position[i] + h[i] * k3[i];
+	field.evaluate(&stage[0].x, n, &k4[0].x);
+
+	for (size_t i = 0u; i < n; ++i)
+		position[i] += (h[i] / 6.f) * (velocity[i] + 2.f * (k2[i] + k3[i]) + k4[i]);
+
+	field.evaluate(&position[0].x, n, &velocity[0].x);
+
+	return allParticles(n);
+}
+
+unsigned long long ParticleIntegrator::stepRK45(const FieldEvaluator &field, size_t n, glm::vec3 *position, glm::vec3 *velocity, const float *h, float *nextH) const
+{
+	// stage 1 is the velocity carried in; stages 2 to 7 are evaluated here, the last at the new positions
+	glm::vec3 stages[6][MAX_PARTICLES];
+	glm::vec3 point[MAX_PARTICLES];
+	const glm::vec3 *k[7] = { velocity, stages[0], stages[1], stages[2], stages[3], stages[4], stages[5] };
+
+	for (unsigned int s = 0u; s < 6u; ++s)
+	{
+		for (size_t i = 0u; i < n; ++i)
+		{
+			glm::vec3 slope = DP_A[s][0] * k[0][i];
+			for (unsigned int j = 1u; j <= s; ++j)
+				slope += DP_A[s][j] * k[j][i];
+
+			point[i] = position[i] + h[i] * slope;
+		}
+
+		field.evaluate(&point[0].x, n, &stages[s][0].x);
+	}
+
+	unsigned long long accepted = 0u;
+
+	for (size_t i = 0u; i < n; ++i)
+	{
+		glm::vec3 error = DP_E[0] * k[0][i];
+		for (unsigned int j = 2u; j < 7u; ++j)
+			error += DP_E[j] * k[j][i];
+		error *= h[i];
+
+		glm::vec3 scale = m_fAbsoluteTolerance + m_fRelativeTolerance * glm::max(glm::abs(position[i]), glm::abs(point[i]));
+		glm::vec3 ratio = error / scale;
+		float norm = std::sqrt(glm::dot(ratio, ratio) / 3.f);
+
+		// optimal step for an error of exactly 1, the error scaling with h^5
+		float growth = norm > 0.f ? STEP_SAFETY * std::pow(norm, -0.2f) : STEP_MAX_SCALE;
+		growth = std::min(std::max(growth, STEP_MIN_SCALE), STEP_MAX_SCALE);
+
+		bool accept = norm <= 1.f || h[i] <= m_fMinimumStep;
+		if (!accept)
+			growth = std::min(growth, 1.f);
+
+		nextH[i] = std::max(h[i] * growth, m_fMinimumStep);
+
+		if (accept)
+		{
+			position[i] = point[i];
+			velocity[i] = stages[5][i];
+			accepted |= 1ull << i;
+		}
+	}
+
+	return accepted;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include "FieldEvaluator.h"
+
+// Time steppers for advecting particles through a steady field. A call advances a packet of particles by one
+// step each, and every stage of the step evaluates the whole packet in a single batch. The last evaluation of
+// a step is always at the new positions, so a particle carries the field at its position into the next step
+// and the fixed-step methods cost exactly their stage count per step. Between the ends of a step the
+// integrator provides a dense output (continuous interpolant), so events such as leaving a sphere are located
+// inside a step instead of at its ends.
+class ParticleIntegrator
+{
+public:
+	enum Method {
+		METHOD_EULER, // forward Euler, one evaluation per step: the original advection loop
+		METHOD_RK4,   // classic fourth-order Runge-Kutta, four evaluations per step
+		METHOD_RK45   // Dormand-Prince 5(4) with step size control, six evaluations per attempted step
+	};
+
+	// Largest packet step() takes (one bit of the returned mask per particle)
+	static const size_t MAX_PARTICLES = 64u;
+
+	// One accepted step of one particle, all the dense output needs
+	struct Step {
+		glm::vec3 x0, v0; // start and the field there
+		glm::vec3 x1, v1; // end and the field there
+		float h;
+	};
+
+public:
+	ParticleIntegrator(Method method = METHOD_EULER);
+	~ParticleIntegrator();
+
+	void setMethod(Method method);
+	Method getMethod() const;
+
+	// Fixed step methods keep the step they are given; METHOD_RK45 adapts it
+	bool isAdaptive() const;
+
+	// METHOD_RK45: a step is accepted when the RMS over the components of its error estimate, each scaled by
+	// absolute + relative * |x|, is at most 1
+	void setTolerance(float absolute, float relative);
+	float getAbsoluteTolerance() const;
+	float getRelativeTolerance() const;
+
+	// METHOD_RK45: steps never shrink below this, and a step this short is accepted whatever its error
+	void setMinimumStep(float minStep);
+	float getMinimumStep() const;
+
+	// Advance n <= MAX_PARTICLES particles by one step of h[i] each. On entry velocity[i] holds the field at
+	// position[i]; accepted steps update both. nextH[i] receives the step to try next: h[i] for the fixed step
+	// methods, grown or shrunk by the error estimate for METHOD_RK45, which also rejects steps over the tolerance
+	// and leaves those particles where they are. Returns the mask of accepted particles, bit i for particle i.
+	unsigned long long step(const FieldEvaluator &field, size_t n, glm::vec3 *position, glm::vec3 *velocity, const float *h, float *nextH) const;
+
+	// Position a fraction theta in [0, 1] into a step. METHOD_EULER moves along the chord, its own path; the
+	// higher-order methods use the cubic Hermite through both ends and their velocities, fourth-order accurate,
+	// which needs no field evaluations beyond the step's own.
+	glm::vec3 denseOutput(const Step &step, float theta) const;
+
+	// Length of the dense output path from the start of the step to theta
+	float arcLength(const Step &step, float theta) const;
+
+	// First theta in [0, 1] at which the dense output of a step reaches distance radius from center, found by
+	// sampling the step for a sign change of |x - center| - radius and refining it by regula falsi (Illinois).
+	// Also catches a path that leaves and comes back within one long step. False if it never gets that far.
+	bool findSphereExit(const Step &step, glm::vec3 center, float radius, float &theta) const;
+
+	// As findSphereExit, from theta = from on, for a crossing outwards when leaving and inwards otherwise; theta
+	// is from if the path is already on the far side there. A step whose path provably stays on the near side
+	// (its Bezier control points, which bound it, all are) is rejected without sampling.
+	bool findSphereCrossing(const Step &step, glm::vec3 center, float radius, bool leaving, float from, float &theta) const;
+
+	static const char* getMethodName(Method method);
+
+private:
+	unsigned long long stepEuler(const FieldEvaluator &field, size_t n, glm::vec3 *position, glm::vec3 *velocity, const float *h) const;
+	unsigned long long stepRK4(const FieldEvaluator &field, size_t n, glm::vec3 *position, glm::vec3 *velocity, const float *h) const;
+	unsigned long long stepRK45(const FieldEvaluator &field, size_t n, glm::vec3 *position, glm::vec3 *velocity, const float *h, float *nextH) const;
+
+private:
+	Method m_eMethod;
+	float m_fAbsoluteTolerance;
+	float m_fRelativeTolerance;
+	float m_fMinimumStep;
+};
@@ -0,0 +1,392 @@
+#include "PartitionOfUnityEvaluator.h"
+
+#include <cmath>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <utility>
+
+#include "CompactRBFEvaluator.h"
+#include "RBFSolver.h"
+#include "SpatialGrid.h"
+#include "ThreadPool.h"
+
+PartitionOfUnityEvaluator::PartitionOfUnityEvaluator()
+	: m_fEta(1.f)
+	, m_fRegularization(0.f)
+	, m_fPatchRadius(1.f)
+	, m_vec3Origin(0.f)
+	, m_vec3CellSize(1.f)
+	, m_iPatchesPerAxis(0)
+{
+	m_Report.patches = 0u;
+	m_Report.borrowingPatches = 0u;
+	m_Report.failedSolves = 0u;
+	m_Report.maxPatchPoints = 0u;
+	m_Report.meanPatchPoints = 0.f;
+	m_Report.seconds = 0.0;
+
+	m_RefitReport.resolvedPatches = 0u;
+	m_RefitReport.failedSolves = 0u;
+	m_RefitReport.seconds = 0.0;
+}
+
+PartitionOfUnityEvaluator::~PartitionOfUnityEvaluator()
+{
+}
+
+void PartitionOfUnityEvaluator::fit(const std::vector<glm::vec3> &positions, const Eigen::MatrixXf &values, float eta, float mu, const glm::vec3 &domainMin, const glm::vec3 &domainMax, unsigned int patchesPerAxis, float overlap, ThreadPool &pool)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	m_vPositions = positions;
+	m_matValues = values;
+	m_fEta = eta;
+	m_fRegularization = mu;
+	m_vPatches.clear();
+	m_iPatchesPerAxis = 0;
+
+	if (positions.empty())
+		return;
+
+	glm::vec3 dataLo(positions[0]), dataHi(positions[0]);
+	for (auto const &p : positions)
+	{
+		dataLo = glm::min(dataLo, p);
+		dataHi = glm::max(dataHi, p);
+	}
+
+	// the domain is covered even where there is no data, so no point of it falls outside every patch
+	glm::vec3 lo = glm::min(dataLo, domainMin);
+	glm::vec3 hi = glm::max(dataHi, domainMax);
+	glm::vec3 extent = glm::max(hi - lo, glm::vec3(1e-6f));
+
+	if (patchesPerAxis == 0u)
+	{
+		// cells are sized for the point density inside the data's box, which may fill only part of the lattice
+		glm::vec3 dataExtent = glm::max(dataHi - dataLo, extent / static_cast<float>(MAX_PATCHES_PER_AXIS));
+		float volumeRatio = (extent.x * extent.y * extent.z) / (dataExtent.x * dataExtent.y * dataExtent.z);
+
+		float cells = static_cast<float>(positions.size()) / POINTS_PER_CELL * volumeRatio;
+		patchesPerAxis = std::min(std::max(static_cast<unsigned int>(std::round(std::cbrt(cells))), 1u), MAX_PATCHES_PER_AXIS);
+	}
+
+	m_iPatchesPerAxis = static_cast<int>(patchesPerAxis);
+	m_vec3Origin = lo;
+	m_vec3CellSize = extent / static_cast<float>(patchesPerAxis);
+
+	// every point of a cell is within half its diagonal of the cell's center, so any overlap > 1 covers the box
+	m_fPatchRadius = std::max(overlap, 1.01f) * 0.5f * glm::length(m_vec3CellSize);
+
+	SpatialGrid grid;
+	grid.build(positions, m_fPatchRadius);
+	const std::vector<unsigned int> &order = grid.getOrder();
+
+	m_vPatches.resize(static_cast<size_t>(patchesPerAxis) * patchesPerAxis * patchesPerAxis);
+
+	std::vector<unsigned int> allPatches(m_vPatches.size());
+	std::vector<unsigned int> emptyPatches;
+
+	for (int z = 0; z < m_iPatchesPerAxis; ++z)
+	{
+		for (int y = 0; y < m_iPatchesPerAxis; ++y)
+		{
+			for (int x = 0; x < m_iPatchesPerAxis; ++x)
+			{
+				unsigned int ind = (z * m_iPatchesPerAxis + y) * m_iPatchesPerAxis + x;
+				Patch &patch = m_vPatches[ind];
+
+				patch.center = m_vec3Origin + (glm::vec3(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z)) + 0.5f) * m_vec3CellSize;
+				patch.solved = false;
+				patch.borrowed = false;
+
+				grid.forEachCellRange(patch.center, [&](unsigned int begin, unsigned int end) {
+					for (unsigned int s = begin; s < end; ++s)
+						if (glm::length(positions[order[s]] - patch.center) < m_fPatchRadius)
+							patch.points.push_back(order[s]);
+				});
+
+				if (patch.points.empty())
+					emptyPatches.push_back(ind);
+
+				allPatches[ind] = ind;
+			}
+		}
+	}
+
+	// a patch left out of the blend would open a hole in the partition, so an empty one fits the points nearest
+	// to it instead; its interpolant is only an extrapolation, but the weights stay continuous across the lattice.
+	// The nearest points are looked for in an even sample of the data, which bounds the cost of many empty patches.
+	const size_t stride = (positions.size() + BORROW_CANDIDATES - 1u) / BORROW_CANDIDATES;
+	const size_t nCandidates = (positions.size() + stride - 1u) / stride;
+	const size_t nBorrowed = std::min(static_cast<size_t>(BORROWED_POINTS), nCandidates);
+	pool.parallelFor(0u, emptyPatches.size(), [&](size_t e) {
+		Patch &patch = m_vPatches[emptyPatches[e]];
+
+		std::vector<std::pair<float, unsigned int>> distances(nCandidates);
+		for (size_t c = 0u; c < nCandidates; ++c)
+		{
+			glm::vec3 d = positions[c * stride] - patch.center;
+			distances[c] = std::make_pair(glm::dot(d, d), static_cast<unsigned int>(c * stride));
+		}
+
+		std::nth_element(distances.begin(), distances.begin() + (nBorrowed - 1u), distances.end());
+
+		patch.points.resize(nBorrowed);
+		for (size_t i = 0u; i < nBorrowed; ++i)
+			patch.points[i] = distances[i].second;
+
+		std::sort(patch.points.begin(), patch.points.end());
+		patch.borrowed = true;
+	});
+
+	unsigned int failed = solvePatches(allPatches, pool);
+
+	unsigned int maxPoints = 0u;
+	size_t totalPoints = 0u;
+	for (auto const &patch : m_vPatches)
+	{
+		maxPoints = std::max(maxPoints, static_cast<unsigned int>(patch.points.size()));
+		totalPoints += patch.points.size();
+	}
+
+	m_Report.patches = static_cast<unsigned int>(m_vPatches.size());
+	m_Report.borrowingPatches = static_cast<unsigned int>(emptyPatches.size());
+	m_Report.failedSolves = failed;
+	m_Report.maxPatchPoints = maxPoints;
+	m_Report.meanPatchPoints = static_cast<float>(totalPoints) / m_vPatches.size();
+	m_Report.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void PartitionOfUnityEvaluator::refit(const std::vector<unsigned int> &indices, const std::vector<glm::vec3> &values, ThreadPool &pool)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	m_vTouched.assign(m_vPatches.size(), false);
+
+	for (size_t n = 0u; n < indices.size(); ++n)
+	{
+		unsigned int i = indices[n];
+		m_matValues.row(i) << values[n].x, values[n].y, values[n].z;
+
+		glm::ivec3 lo, hi;
+		if (!patchRange(m_vPositions[i], lo, hi))
+			continue;
+
+		for (int z = lo.z; z <= hi.z; ++z)
+			for (int y = lo.y; y <= hi.y; ++y)
+				for (int x = lo.x; x <= hi.x; ++x)
+				{
+					unsigned int ind = (z * m_iPatchesPerAxis + y) * m_iPatchesPerAxis + x;
+					if (!m_vPatches[ind].borrowed && glm::length(m_vPositions[i] - m_vPatches[ind].center) < m_fPatchRadius)
+						m_vTouched[ind] = true;
+				}
+	}
+
+	// borrowed points can lie anywhere, so those patches look them up in their own lists
+	for (unsigned int ind = 0u; ind < m_vPatches.size(); ++ind)
+	{
+		const Patch &patch = m_vPatches[ind];
+		if (!patch.borrowed)
+			continue;
+
+		for (unsigned int i : indices)
+		{
+			if (std::binary_search(patch.points.begin(), patch.points.end(), i))
+			{
+				m_vTouched[ind] = true;
+				break;
+			}
+		}
+	}
+
+	m_vRefitPatches.clear();
+	for (unsigned int ind = 0u; ind < m_vTouched.size(); ++ind)
+		if (m_vTouched[ind])
+			m_vRefitPatches.push_back(ind);
+
+	m_RefitReport.resolvedPatches = static_cast<unsigned int>(m_vRefitPatches.size());
+	m_RefitReport.failedSolves = solvePatches(m_vRefitPatches, pool);
+	m_RefitReport.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+unsigned int PartitionOfUnityEvaluator::solvePatches(const std::vector<unsigned int> &patchIndices, ThreadPool &pool)
+{
+	std::atomic<unsigned int> failed(0u);
+
+	// patches are independent, so each index of the loop is one complete local fit
+	pool.parallelFor(0u, patchIndices.size(), [&](size_t p) {
+		Patch &patch = m_vPatches[patchIndices[p]];
+
+		Eigen::Index n = static_cast<Eigen::Index>(patch.points.size());
+		if (n == 0)
+			return;
+
+		std::vector<glm::vec3> positions(n);
+		Eigen::MatrixXf rhs(n, 3);
+		for (Eigen::Index i = 0; i < n; ++i)
+		{
+			positions[i] = m_vPositions[patch.points[i]];
+			rhs.row(i) = m_matValues.row(patch.points[i]);
+		}
+
+		Eigen::MatrixXf kernel(n, n);
+		for (Eigen::Index i = 0; i < n; ++i)
+		{
+			kernel(i, i) = 1.f;
+			for (Eigen::Index j = 0; j < i; ++j)
+			{
+				glm::vec3 d = positions[i] - positions[j];
+				kernel(i, j) = kernel(j, i) = std::exp(-m_fEta * glm::dot(d, d));
+			}
+		}
+
+		RBFSolver solver;
+		solver.setRegularization(m_fRegularization);
+
+		Eigen::MatrixXf lambdas;
+		patch.solved = solver.solve(kernel, rhs, lambdas);
+
+		if (!patch.solved)
+		{
+			++failed;
+			lambdas = Eigen::MatrixXf::Zero(n, 3);
+		}
+
+		if (!patch.interpolant)
+			patch.interpolant.reset(new RBFEvaluator());
+
+		patch.interpolant->setControlPoints(positions, lambdas.col(0), lambdas.col(1), lambdas.col(2), m_fEta);
+	});
+
+	return failed;
+}
+
+bool PartitionOfUnityEvaluator::patchRange(const glm::vec3 &pt, glm::ivec3 &lo, glm::ivec3 &hi) const
+{
+	if (m_iPatchesPerAxis == 0)
+		return false;
+
+	// patch centers sit at cell centers, origin + (i + 0.5) * cellSize
+	glm::vec3 rel = (pt - m_vec3Origin) / m_vec3CellSize - 0.5f;
+	glm::vec3 reach = glm::vec3(m_fPatchRadius) / m_vec3CellSize;
+
+	lo = glm::max(glm::ivec3(glm::ceil(rel - reach)), glm::ivec3(0));
+	hi = glm::min(glm::ivec3(glm::floor(rel + reach)), glm::ivec3(m_iPatchesPerAxis - 1));
+
+	return lo.x <= hi.x && lo.y <= hi.y && lo.z <= hi.z;
+}
+
+unsigned int PartitionOfUnityEvaluator::nearestPatch(const glm::vec3 &pt) const
+{
+	glm::vec3 rel = (pt - m_vec3Origin) / m_vec3CellSize - 0.5f;
+	glm::ivec3 cell = glm::clamp(glm::ivec3(glm::round(rel)), glm::ivec3(0), glm::ivec3(m_iPatchesPerAxis - 1));
+
+	return (cell.z * m_iPatchesPerAxis + cell.y) * m_iPatchesPerAxis + cell.x;
+}
+
+void PartitionOfUnityEvaluator::evaluate(const float *xyz, size_t n, float *out) const
+{
+	const float invRadius = 1.f / m_fPatchRadius;
+
+	// each point lists the patches that cover it; sorted by patch, every touched patch then evaluates
+	// its points in one batch
+	struct Cover {
+		unsigned int patch;
+		unsigned int point;
+		float weight;
+
+		bool operator<(const Cover &other) const { return patch < other.patch || (patch == other.patch && point < other.point); }
+	};
+
+	std::fill(out, out + 3u * n, 0.f);
+
+	if (m_vPatches.empty())
+		return;
+
+	// evaluate() runs on several threads at once, so its buffers are per thread; they are kept from call
+	// to call, and a stream of batches of similar size allocates nothing
+	thread_local std::vector<Cover> covers;
+	thread_local std::vector<float> weightSums, batch, result;
+
+	covers.clear();
+	weightSums.assign(n, 0.f);
+
+	for (size_t i = 0u; i < n; ++i)
+	{
+		glm::vec3 pt(xyz[3u * i + 0u], xyz[3u * i + 1u], xyz[3u * i + 2u]);
+
+		glm::ivec3 lo, hi;
+		if (patchRange(pt, lo, hi))
+		{
+			for (int z = lo.z; z <= hi.z; ++z)
+				for (int y = lo.y; y <= hi.y; ++y)
+					for (int x = lo.x; x <= hi.x; ++x)
+					{
+						unsigned int ind = (z * m_iPatchesPerAxis + y) * m_iPatchesPerAxis + x;
+
+						float w = CompactRBFEvaluator::basisFunction(CompactRBFEvaluator::WENDLAND_C2, glm::length(pt - m_vPatches[ind].center) * invRadius);
+						if (w <= 0.f)
+							continue;
+
+						Cover c = { ind, static_cast<unsigned int>(i), w };
+						covers.push_back(c);
+						weightSums[i] += w;
+					}
+		}
+
+		// beyond the lattice the nearest patch extrapolates on its own
+		if (weightSums[i] <= 0.f)
+		{
+			Cover c = { nearestPatch(pt), static_cast<unsigned int>(i), 1.f };
+			covers.push_back(c);
+			weightSums[i] = 1.f;
+		}
+	}
+
+	std::sort(covers.begin(), covers.end());
+
+	for (size_t first = 0u; first < covers.size();)
+	{
+		size_t last = first;
+		while (last < covers.size() && covers[last].patch == covers[first].patch)
+			++last;
+
+		size_t count = last - first;
+		batch.resize(3u * count);
+		result.resize(3u * count);
+		for (size_t k = 0u; k < count; ++k)
+			std::copy(xyz + 3u * covers[first + k].point, xyz + 3u * covers[first + k].point + 3u, &batch[3u * k]);
+
+		m_vPatches[covers[first].patch].interpolant->evaluate(batch.data(), count, result.data());
+
+		for (size_t k = 0u; k < count; ++k)
+		{
+			unsigned int i = covers[first + k].point;
+
+			// Shepard weights: each patch weight over the sum of the covering patches' weights
+			float w = covers[first + k].weight / weightSums[i];
+
+			out[3u * i + 0u] += w * result[3u * k + 0u];
+			out[3u * i + 1u] += w * result[3u * k + 1u];
+			out[3u * i + 2u] += w * result[3u * k + 2u];
+		}
+
+		first = last;
+	}
+}
+
+const char* PartitionOfUnityEvaluator::getName() const
+{
+	return "partition of unity";
+}
+
+const PartitionOfUnityEvaluator::Report& PartitionOfUnityEvaluator::getReport() const
+{
+	return m_Report;
+}
+
+const PartitionOfUnityEvaluator::RefitReport& PartitionOfUnityEvaluator::getRefitReport() const
+{
+	return m_RefitReport;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+
+#include <glm/glm.hpp>
+
+#include <Eigen/Dense>
+
+#include "FieldEvaluator.h"
+#include "RBFEvaluator.h"
+
+class ThreadPool;
+
+// Fits and evaluates a Gaussian RBF vector field as a partition of unity: the data's bounding box, joined
+// with the given domain, is covered by a lattice of overlapping spherical patches, each patch gets its own
+// small kernel solve over the data points inside it, and evaluation blends the patch interpolants with
+// Wendland C2 weights normalized to sum to one (Shepard). One O(N^3) solve becomes many independent O(n^3)
+// ones that run in parallel, and a local edit only re-solves the patches that contain the edited points.
+// A patch without data of its own borrows its nearest points, so the blend is continuous over the whole
+// lattice; points outside every patch take the nearest patch's interpolant.
+class PartitionOfUnityEvaluator : public FieldEvaluator
+{
+public:
+	// Patch lattice size aimed for when none is given: about this many points per lattice cell
+	static const unsigned int POINTS_PER_CELL = 32u;
+
+	// Upper bound on the lattice size picked automatically
+	static const unsigned int MAX_PATCHES_PER_AXIS = 32u;
+
+	// Points a patch without data of its own borrows from its surroundings, and the size of the sample of the
+	// data they are taken from
+	static const unsigned int BORROWED_POINTS = 16u;
+	static const unsigned int BORROW_CANDIDATES = 4096u;
+
+	// Of the last fit()
+	struct Report {
+		unsigned int patches;          // patches on the lattice
+		unsigned int borrowingPatches; // of those, the ones fitted to borrowed points
+		unsigned int failedSolves;
+		unsigned int maxPatchPoints;
+		float meanPatchPoints;
+		double seconds;
+	};
+
+	// Of the last refit()
+	struct RefitReport {
+		unsigned int resolvedPatches;
+		unsigned int failedSolves;
+		double seconds;
+	};
+
+public:
+	PartitionOfUnityEvaluator();
+	~PartitionOfUnityEvaluator();
+
+	// values holds one row per position. The lattice spans the positions' bounding box and [domainMin, domainMax];
+	// patchesPerAxis = 0 picks its size from the point density in the bounding box, and overlap scales the patch radius relative to
+	// the half diagonal of a lattice cell (must be > 1 for coverage). Each patch is solved with the solver's
+	// LLT -> LDLT -> LU fallback and Tikhonov parameter mu.
+	void fit(const std::vector<glm::vec3> &positions, const Eigen::MatrixXf &values, float eta, float mu, const glm::vec3 &domainMin, const glm::vec3 &domainMax, unsigned int patchesPerAxis, float overlap, ThreadPool &pool);
+
+	// Replace the values of the given points and re-solve only the patches that contain them
+	void refit(const std::vector<unsigned int> &indices, const std::vector<glm::vec3> &values, ThreadPool &pool);
+
+	void evaluate(const float *xyz, size_t n, float *out) const override;
+
+	const char* getName() const override;
+
+	const Report& getReport() const;
+	const RefitReport& getRefitReport() const;
+
+private:
+	struct Patch {
+		glm::vec3 center;
+		std::vector<unsigned int> points;
+		std::unique_ptr<RBFEvaluator> interpolant;
+		bool solved;
+		bool borrowed; // points are the nearest ones rather than those inside the sphere; kept sorted
+	};
+
+	// Range of lattice indices along each axis whose patch spheres can contain pt
+	bool patchRange(const glm::vec3 &pt, glm::ivec3 &lo, glm::ivec3 &hi) const;
+
+	// Lattice index of the patch whose center is nearest to pt
+	unsigned int nearestPatch(const glm::vec3 &pt) const;
+
+	// Returns the number of failed solves
+	unsigned int solvePatches(const std::vector<unsigned int> &patchIndices, ThreadPool &pool);
+
+private:
+	std::vector<glm::vec3> m_vPositions;
+	Eigen::MatrixXf m_matValues; // N x 3
+
+	float m_fEta;
+	float m_fRegularization;
+	float m_fPatchRadius;
+
+	glm::vec3 m_vec3Origin;
+	glm::vec3 m_vec3CellSize;
+	int m_iPatchesPerAxis;
+
+	std::vector<Patch> m_vPatches; // lattice order, x fastest
+
+	// refit() scratch
+	std::vector<bool> m_vTouched; // per patch
+	std::vector<unsigned int> m_vRefitPatches;
+
+	Report m_Report;
+	RefitReport m_RefitReport;
+};
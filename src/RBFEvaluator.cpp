@@ -0,0 +1,999 @@
+#include "RBFEvaluator.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define VFG_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// GCC/Clang only emit wider instructions inside functions tagged for them; MSVC always allows the intrinsics
+#if defined(__GNUC__)
+#define VFG_TARGET(isa) __attribute__((target(isa)))
+#else
+#define VFG_TARGET(isa)
+#endif
+
+// AVX-512 intrinsics first shipped with VS2017 15.3
+#if defined(VFG_X86) && (!defined(_MSC_VER) || _MSC_VER >= 1911)
+#define VFG_AVX512
+#endif
+
+namespace
+{
+	const unsigned int ALIGNMENT = 64u;
+
+	void scalarKernel(const RBFEvaluator::SoA &cp, unsigned int begin, unsigned int end, const float *pt, float *out)
+	{
+		float sumX = 0.f, sumY = 0.f, sumZ = 0.f;
+		for (unsigned int m = begin; m < end; ++m)
+		{
+			float dx = pt[0] - cp.x[m];
+			float dy = pt[1] - cp.y[m];
+			float dz = pt[2] - cp.z[m];
+			float gaussian = std::exp(-cp.eta * (dx * dx + dy * dy + dz * dz));
+
+			sumX += cp.lambdaX[m] * gaussian;
+			sumY += cp.lambdaY[m] * gaussian;
+			sumZ += cp.lambdaZ[m] * gaussian;
+		}
+
+		out[0] += sumX;
+		out[1] += sumY;
+		out[2] += sumZ;
+	}
+
+	void scalarJacobianKernel(const RBFEvaluator::SoA &cp, unsigned int begin, unsigned int end, const float *pt, float *out, float *moments)
+	{
+		float sum[3] = { 0.f, 0.f, 0.f };
+		float moment[9] = { 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f };
+		for (unsigned int m = begin; m < end; ++m)
+		{
+			float d[3] = { pt[0] - cp.x[m], pt[1] - cp.y[m], pt[2] - cp.z[m] };
+			float gaussian = std::exp(-cp.eta * (d[0] * d[0] + d[1] * d[1] + d[2] * d[2]));
+			float weighted[3] = { cp.lambdaX[m] * gaussian, cp.lambdaY[m] * gaussian, cp.lambdaZ[m] * gaussian };
+
+			for (unsigned int c = 0u; c < 3u; ++c)
+			{
+				sum[c] += weighted[c];
+				for (unsigned int k = 0u; k < 3u; ++k)
+					moment[3u * c + k] += weighted[c] * d[k];
+			}
+		}
+
+		for (unsigned int c = 0u; c < 3u; ++c)
+			out[c] += sum[c];
+		for (unsigned int k = 0u; k < 9u; ++k)
+			moments[k] += moment[k];
+	}
+
+#ifdef VFG_X86
+	// Polynomial exp after Cephes' expf: range reduce to 2^n * e^r with |r| <= ln(2)/2, then
+	// a degree-6 minimax polynomial for e^r. Max relative error is around 2 ulp over the clamped range.
+	const float EXP_HI = 88.3762626647949f;
+	const float EXP_LO = -88.3762626647949f;
+	const float LOG2EF = 1.44269504088896341f;
+	const float EXP_C1 = 0.693359375f;
+	const float EXP_C2 = -2.12194440e-4f;
+	const float EXP_P0 = 1.9875691500e-4f;
+	const float EXP_P1 = 1.3981999507e-3f;
+	const float EXP_P2 = 8.3334519073e-3f;
+	const float EXP_P3 = 4.1665795894e-2f;
+	const float EXP_P4 = 1.6666665459e-1f;
+	const float EXP_P5 = 5.0000001201e-1f;
+
+	VFG_TARGET("sse4.1")
+	inline __m128 exp128(__m128 x)
+	{
+		x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(EXP_LO)), _mm_set1_ps(EXP_HI));
+
+		__m128 fx = _mm_floor_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(LOG2EF)), _mm_set1_ps(0.5f)));
+		x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(EXP_C1)));
+		x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(EXP_C2)));
+
+		__m128 z = _mm_mul_ps(x, x);
+		__m128 y = _mm_set1_ps(EXP_P0);
+		y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P1));
+		y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P2));
+		y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P3));
+		y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P4));
+		y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P5));
+		y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(y, z), x), _mm_set1_ps(1.f));
+
+		__m128i n = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(fx), _mm_set1_epi32(127)), 23);
+
+		return _mm_mul_ps(y, _mm_castsi128_ps(n));
+	}
+
+	VFG_TARGET("sse4.1")
+	inline float hsum128(__m128 v)
+	{
+		__m128 shuf = _mm_movehdup_ps(v);
+		__m128 sums = _mm_add_ps(v, shuf);
+		shuf = _mm_movehl_ps(shuf, sums);
+		return _mm_cvtss_f32(_mm_add_ss(sums, shuf));
+	}
+
+	VFG_TARGET("sse4.1")
+	void sse4Kernel(const RBFEvaluator::SoA &cp, unsigned int begin, unsigned int end, const float *pt, float *out)
+	{
+		const __m128 px = _mm_set1_ps(pt[0]);
+		const __m128 py = _mm_set1_ps(pt[1]);
+		const __m128 pz = _mm_set1_ps(pt[2]);
+		const __m128 negEta = _mm_set1_ps(-cp.eta);
+
+		__m128 sumX = _mm_setzero_ps();
+		__m128 sumY = _mm_setzero_ps();
+		__m128 sumZ = _mm_setzero_ps();
+
+		for (unsigned int m = begin; m < end; m += 4u)
+		{
+			__m128 dx = _mm_sub_ps(px, _mm_load_ps(cp.x + m));
+			__m128 dy = _mm_sub_ps(py, _mm_load_ps(cp.y + m));
+			__m128 dz = _mm_sub_ps(pz, _mm_load_ps(cp.z + m));
+			__m128 r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+			__m128 gaussian = exp128(_mm_mul_ps(negEta, r2));
+
+			sumX = _mm_add_ps(sumX, _mm_mul_ps(gaussian, _mm_load_ps(cp.lambdaX + m)));
+			sumY = _mm_add_ps(sumY, _mm_mul_ps(gaussian, _mm_load_ps(cp.lambdaY + m)));
+			sumZ = _mm_add_ps(sumZ, _mm_mul_ps(gaussian, _mm_load_ps(cp.lambdaZ + m)));
+		}
+
+		out[0] += hsum128(sumX);
+		out[1] += hsum128(sumY);
+		out[2] += hsum128(sumZ);
+	}
+
+	VFG_TARGET("sse4.1")
+	void sse4JacobianKernel(const RBFEvaluator::SoA &cp, unsigned int begin, unsigned int end, const float *pt, float *out, float *moments)
+	{
+		const __m128 p[3] = { _mm_set1_ps(pt[0]), _mm_set1_ps(pt[1]), _mm_set1_ps(pt[2]) };
+		const __m128 negEta = _mm_set1_ps(-cp.eta);
+		const float *centers[3] = { cp.x, cp.y, cp.z };
+		const float *lambdas[3] = { cp.lambdaX, cp.lambdaY, cp.lambdaZ };
+
+		__m128 sum[3], moment[9];
+		for (unsigned int k = 0u; k < 3u; ++k)
+			sum[k] = _mm_setzero_ps();
+		for (unsigned int k = 0u; k < 9u; ++k)
+			moment[k] = _mm_setzero_ps();
+
+		for (unsigned int m = begin; m < end; m += 4u)
+		{
+			__m128 d[3];
+			for (unsigned int k = 0u; k < 3u; ++k)
+				d[k] = _mm_sub_ps(p[k], _mm_load_ps(centers[k] + m));
+
+			__m128 r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(d[0], d[0]), _mm_mul_ps(d[1], d[1])), _mm_mul_ps(d[2], d[2]));
+			__m128 gaussian = exp128(_mm_mul_ps(negEta, r2));
+
+			// one Gaussian feeds the value and all nine moments
+			for (unsigned int c = 0u; c < 3u; ++c)
+			{
+				__m128 weighted = _mm_mul_ps(gaussian, _mm_load_ps(lambdas[c] + m));
+				sum[c] = _mm_add_ps(sum[c], weighted);
+				for (unsigned int k = 0u; k < 3u; ++k)
+					moment[3u * c + k] = _mm_add_ps(moment[3u * c + k], _mm_mul_ps(weighted, d[k]));
+			}
+		}
+
+		for (unsigned int c = 0u; c < 3u; ++c)
+			out[c] += hsum128(sum[c]);
+		for (unsigned int k = 0u; k < 9u; ++k)
+			moments[k] += hsum128(moment[k]);
+	}
+
+	VFG_TARGET("sse4.1")
+	void sse4PacketKernel(const RBFEvaluator::SoA &cp, unsigned int begin, unsigned int end, const float *px, const float *py, const float *pz, float *outX, float *outY, float *outZ)
+	{
+		const __m128 x = _mm_loadu_ps(px);
+		const __m128 y = _mm_loadu_ps(py);
+		const __m128 z = _mm_loadu_ps(pz);
+		const __m128 negEta = _mm_set1_ps(-cp.eta);
+
+		__m128 sumX = _mm_setzero_ps();
+		__m128 sumY = _mm_setzero_ps();
+		__m128 sumZ = _mm_setzero_ps();
+
+		for (unsigned int m = begin; m < end; ++m)
+		{
+			__m128 dx = _mm_sub_ps(x, _mm_set1_ps(cp.x[m]));
+			__m128 dy = _mm_sub_ps(y, _mm_set1_ps(cp.y[m]));
+			__m128 dz = _mm_sub_ps(z, _mm_set1_ps(cp.z[m]));
+			__m128 r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+			__m128 gaussian = exp128(_mm_mul_ps(negEta, r2));
+
+			sumX = _mm_add_ps(sumX, _mm_mul_ps(gaussian, _mm_set1_ps(cp.lambdaX[m])));
+			sumY = _mm_add_ps(sumY, _mm_mul_ps(gaussian, _mm_set1_ps(cp.lambdaY[m])));
+			sumZ = _mm_add_ps(sumZ, _mm_mul_ps(gaussian, _mm_set1_ps(cp.lambdaZ[m])));
+		}
+
+		_mm_storeu_ps(outX, _mm_add_ps(_mm_loadu_ps(outX), sumX));
+		_mm_storeu_ps(outY, _mm_add_ps(_mm_loadu_ps(outY), sumY));
+		_mm_storeu_ps(outZ, _mm_add_ps(_mm_loadu_ps(outZ), sumZ));
+	}
+
+	VFG_TARGET("sse4.1")
+	void sse4PacketJacobianKernel(const RBFEvaluator::SoA &cp, unsigned int begin, unsigned int end, const float *px, const float *py, const float *pz, float *out, float *moments, size_t stride)
+	{
+		const __m128 p[3] = { _mm_loadu_ps(px), _mm_loadu_ps(py), _mm_loadu_ps(pz) };
+		const __m128 negEta = _mm_set1_ps(-cp.eta);
+		const float *centers[3] = { cp.x, cp.y, cp.z };
+		const float *lambdas[3] = { cp.lambdaX, cp.lambdaY, cp.lambdaZ };
+
+		__m128 sum[3], moment[9];
+		for (unsigned int k = 0u; k < 3u; ++k)
+			sum[k] = _mm_setzero_ps();
+		for (unsigned int k = 0u; k < 9u; ++k)
+			moment[k] = _mm_setzero_ps();
+
+		for (unsigned int m = begin; m < end; ++m)
+		{
+			__m128 d[3];
+			for (unsigned int k = 0u; k < 3u; ++k)
+				d[k] = _mm_sub_ps(p[k], _mm_set1_ps(centers[k][m]));
+
+			__m128 r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(d[0], d[0]), _mm_mul_ps(d[1], d[1])), _mm_mul_ps(d[2], d[2]));
+			__m128 gaussian = exp128(_mm_mul_ps(negEta, r2));
+
+			// one Gaussian per lane feeds the value and all nine moments of that lane's point
+			for (unsigned int c = 0u; c < 3u; ++c)
+			{
+				__m128 weighted = _mm_mul_ps(gaussian, _mm_set1_ps(lambdas[c][m]));
+				sum[c] = _mm_add_ps(sum[c], weighted);
+				for (unsigned int k = 0u; k < 3u; ++k)
+					moment[3u * c + k] = _mm_add_ps(moment[3u * c + k], _mm_mul_ps(weighted, d[k]));
+			}
+		}
+
+		for (unsigned int c = 0u; c < 3u; ++c)
+			_mm_storeu_ps(out + c * stride, _mm_add_ps(_mm_loadu_ps(out + c * stride), sum[c]));
+		for (unsigned int k = 0u; k < 9u; ++k)
+			_mm_storeu_ps(moments + k * stride, _mm_add_ps(_mm_loadu_ps(moments + k * stride), moment[k]));
+	}
+
+	VFG_TARGET("avx2,fma")
+	inline __m256 exp256(__m256 x)
+	{
+		x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(EXP_LO)), _mm256_set1_ps(EXP_HI));
+
+		__m256 fx = _mm256_floor_ps(_mm256_fmadd_ps(x, _mm256_set1_ps(LOG2EF), _mm256_set1_ps(0.5f)));
+		x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(EXP_C1), x);
+		x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(EXP_C2), x);
+
+		__m256 z = _mm256_mul_ps(x, x);
+		__m256 y = _mm256_set1_ps(EXP_P0);
+		y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P1));
+		y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P2));
+		y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P3));
+		y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P4));
+		y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P5));
+		y = _mm256_add_ps(_mm256_fmadd_ps(y, z, x), _mm256_set1_ps(1.f));
+
+		__m256i n = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(fx), _mm256_set1_epi32(127)), 23);
+
+		return _mm256_mul_ps(y, _mm256_castsi256_ps(n));
+	}
+
+	VFG_TARGET("avx2,fma")
+	inline float hsum256(__m256 v)
+	{
+		__m128 lo = _mm256_castps256_ps128(v);
+		__m128 hi = _mm256_extractf128_ps(v, 1);
+		lo = _mm_add_ps(lo, hi);
+		__m128 shuf = _mm_movehdup_ps(lo);
+		__m128 sums = _mm_add_ps(lo, shuf);
+		shuf = _mm_movehl_ps(shuf, sums);
+		return _mm_cvtss_f32(_mm_add_ss(sums, shuf));
+	}
+
+	VFG_TARGET("avx2,fma")
+	void avx2Kernel(const RBFEvaluator::SoA &cp, unsigned int begin, unsigned int end, const float *pt, float *out)
+	{
+		const __m256 px = _mm256_set1_ps(pt[0]);
+		const __m256 py = _mm256_set1_ps(pt[1]);
+		const __m256 pz = _mm256_set1_ps(pt[2]);
+		const __m256 negEta = _mm256_set1_ps(-cp.eta);
+
+		__m256 sumX = _mm256_setzero_ps();
+		__m256 sumY = _mm256_setzero_ps();
+		__m256 sumZ = _mm256_setzero_ps();
+
+		for (unsigned int m = begin; m < end; m += 8u)
+		{
+			__m256 dx = _mm256_sub_ps(px, _mm256_load_ps(cp.x + m));
+			__m256 dy = _mm256_sub_ps(py, _mm256_load_ps(cp.y + m));
+			__m256 dz = _mm256_sub_ps(pz, _mm256_load_ps(cp.z + m));
+			__m256 r2 = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx)));
+			__m256 gaussian = exp256(_mm256_mul_ps(negEta, r2));
+
+			sumX = _mm256_fmadd_ps(gaussian, _mm256_load_ps(cp.lambdaX + m), sumX);
+			sumY = _mm256_fmadd_ps(gaussian, _mm256_load_ps(cp.lambdaY + m), sumY);
+			sumZ = _mm256_fmadd_ps(gaussian, _mm256_load_ps(cp.lambdaZ + m), sumZ);
+		}
+
+		out[0] += hsum256(sumX);
+		out[1] += hsum256(sumY);
+		out[2] += hsum256(sumZ);
+	}
+
+	VFG_TARGET("avx2,fma")
+	void avx2JacobianKernel(const RBFEvaluator::SoA &cp, unsigned int begin, unsigned int end, const float *pt, float *out, float *moments)
+	{
+		const __m256 p[3] = { _mm256_set1_ps(pt[0]), _mm256_set1_ps(pt[1]), _mm256_set1_ps(pt[2]) };
+		const __m256 negEta = _mm256_set1_ps(-cp.eta);
+		const float *centers[3] = { cp.x, cp.y, cp.z };
+		const float *lambdas[3] = { cp.lambdaX, cp.lambdaY, cp.lambdaZ };
+
+		__m256 sum[3], moment[9];
+		for (unsigned int k = 0u; k < 3u; ++k)
+			sum[k] = _mm256_setzero_ps();
+		for (unsigned int k = 0u; k < 9u; ++k)
+			moment[k] = _mm256_setzero_ps();
+
+		for (unsigned int m = begin; m < end; m += 8u)
+		{
+			__m256 d[3];
+			for (unsigned int k = 0u; k < 3u; ++k)
+				d[k] = _mm256_sub_ps(p[k], _mm256_load_ps(centers[k] + m));
+
+			__m256 r2 = _mm256_fmadd_ps(d[2], d[2], _mm256_fmadd_ps(d[1], d[1], _mm256_mul_ps(d[0], d[0])));
+			__m256 gaussian = exp256(_mm256_mul_ps(negEta, r2));
+
+			// one Gaussian feeds the value and all nine moments
+			for (unsigned int c = 0u; c < 3u; ++c)
+			{
+				__m256 weighted = _mm256_mul_ps(gaussian, _mm256_load_ps(lambdas[c] + m));
+				sum[c] = _mm256_add_ps(sum[c], weighted);
+				for (unsigned int k = 0u; k < 3u; ++k)
+					moment[3u * c + k] = _mm256_fmadd_ps(weighted, d[k], moment[3u * c + k]);
+			}
+		}
+
+		for (unsigned int c = 0u; c < 3u; ++c)
+			out[c] += hsum256(sum[c]);
+		for (unsigned int k = 0u; k < 9u; ++k)
+			moments[k] += hsum256(moment[k]);
+	}
+
+	VFG_TARGET("avx2,fma")
+	void avx2PacketKernel(const RBFEvaluator::SoA &cp, unsigned int begin, unsigned int end, const float *px, const float *py, const float *pz, float *outX, float *outY, float *outZ)
+	{
+		const __m256 x = _mm256_loadu_ps(px);
+		const __m256 y = _mm256_loadu_ps(py);
+		const __m256 z = _mm256_loadu_ps(pz);
+		const __m256 negEta = _mm256_set1_ps(-cp.eta);
+
+		__m256 sumX = _mm256_setzero_ps();
+		__m256 sumY = _mm256_setzero_ps();
+		__m256 sumZ = _mm256_setzero_ps();
+
+		for (unsigned int m = begin; m < end; ++m)
+		{
+			__m256 dx = _mm256_sub_ps(x, _mm256_broadcast_ss(cp.x + m));
+			__m256 dy = _mm256_sub_ps(y, _mm256_broadcast_ss(cp.y + m));
+			__m256 dz = _mm256_sub_ps(z, _mm256_broadcast_ss(cp.z + m));
+			__m256 r2 = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx)));
+			__m256 gaussian = exp256(_mm256_mul_ps(negEta, r2));
+
+			sumX = _mm256_fmadd_ps(gaussian, _mm256_broadcast_ss(cp.lambdaX + m), sumX);
+			sumY = _mm256_fmadd_ps(gaussian, _mm256_broadcast_ss(cp.lambdaY + m), sumY);
+			sumZ = _mm256_fmadd_ps(gaussian, _mm256_broadcast_ss(cp.lambdaZ + m), sumZ);
+		}
+
+		_mm256_storeu_ps(outX, _mm256_add_ps(_mm256_loadu_ps(outX), sumX));
+		_mm256_storeu_ps(outY, _mm256_add_ps(_mm256_loadu_ps(outY), sumY));
+		_mm256_storeu_ps(outZ, _mm256_add_ps(_mm256_loadu_ps(outZ), sumZ));
+	}
+
+	VFG_TARGET("avx2,fma")
+	void avx2PacketJacobianKernel(const RBFEvaluator::SoA &cp, unsigned int begin, unsigned int end, const float *px, const float *py, const float *pz, float *out, float *moments, size_t stride)
+	{
+		const __m256 p[3] = { _mm256_loadu_ps(px), _mm256_loadu_ps(py), _mm256_loadu_ps(pz) };
+		const __m256 negEta = _mm256_set1_ps(-cp.eta);
+		const float *centers[3] = { cp.x, cp.y, cp.z };
+		const float *lambdas[3] = { cp.lambdaX, cp.lambdaY, cp.lambdaZ };
+
+		__m256 sum[3], moment[9];
+		for (unsigned int k = 0u; k < 3u; ++k)
+			sum[k] = _mm256_setzero_ps();
+		for (unsigned int k = 0u; k < 9u; ++k)
+			moment[k] = _mm256_setzero_ps();
+
+		for (unsigned int m = begin; m < end; ++m)
+		{
+			__m256 d[3];
+			for (unsigned int k = 0u; k < 3u; ++k)
+				d[k] = _mm256_sub_ps(p[k], _mm256_broadcast_ss(centers[k] + m));
+
+			__m256 r2 = _mm256_fmadd_ps(d[2], d[2], _mm256_fmadd_ps(d[1], d[1], _mm256_mul_ps(d[0], d[0])));
+			__m256 gaussian = exp256(_mm256_mul_ps(negEta, r2));
+
+			// one Gaussian per lane feeds the value and all nine moments of that lane's point
+			for (unsigned int c = 0u; c < 3u; ++c)
+			{
+				__m256 weighted = _mm256_mul_ps(gaussian, _mm256_broadcast_ss(lambdas[c] + m));
+				sum[c] = _mm256_add_ps(sum[c], weighted);
+				for (unsigned int k = 0u; k < 3u; ++k)
+					moment[3u * c + k] = _mm256_fmadd_ps(weighted, d[k], moment[3u * c + k]);
+			}
+		}
+
+		for (unsigned int c = 0u; c < 3u; ++c)
+			_mm256_storeu_ps(out + c * stride, _mm256_add_ps(_mm256_loadu_ps(out + c * stride), sum[c]));
+		for (unsigned int k = 0u; k < 9u; ++k)
+			_mm256_storeu_ps(moments + k * stride, _mm256_add_ps(_mm256_loadu_ps(moments + k * stride), moment[k]));
+	}
+
+#ifdef VFG_AVX512
+	VFG_TARGET("avx512f")
+	inline __m512 exp512(__m512 x)
+	{
+		x = _mm512_min_ps(_mm512_max_ps(x, _mm512_set1_ps(EXP_LO)), _mm512_set1_ps(EXP_HI));
+
+		__m512 fx = _mm512_roundscale_ps(_mm512_fmadd_ps(x, _mm512_set1_ps(LOG2EF), _mm512_set1_ps(0.5f)), _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+		x = _mm512_fnmadd_ps(fx, _mm512_set1_ps(EXP_C1), x);
+		x = _mm512_fnmadd_ps(fx, _mm512_set1_ps(EXP_C2), x);
+
+		__m512 z = _mm512_mul_ps(x, x);
+		__m512 y = _mm512_set1_ps(EXP_P0);
+		y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P1));
+		y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P2));
+		y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P3));
+		y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P4));
+		y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P5));
+		y = _mm512_add_ps(_mm512_fmadd_ps(y, z, x), _mm512_set1_ps(1.f));
+
+		__m512i n = _mm512_slli_epi32(_mm512_add_epi32(_mm512_cvttps_epi32(fx), _mm512_set1_epi32(127)), 23);
+
+		return _mm512_mul_ps(y, _mm512_castsi512_ps(n));
+	}
+
+	VFG_TARGET("avx512f")
+	void avx512Kernel(const RBFEvaluator::SoA &cp, unsigned int begin, unsigned int end, const float *pt, float *out)
+	{
+		const __m512 px = _mm512_set1_ps(pt[0]);
+		const __m512 py = _mm512_set1_ps(pt[1]);
+		const __m512 pz = _mm512_set1_ps(pt[2]);
+		const __m512 negEta = _mm512_set1_ps(-cp.eta);
+
+		__m512 sumX = _mm512_setzero_ps();
+		__m512 sumY = _mm512_setzero_ps();
+		__m512 sumZ = _mm512_setzero_ps();
+
+		for (unsigned int m = begin; m < end; m += 16u)
+		{
+			__m512 dx = _mm512_sub_ps(px, _mm512_load_ps(cp.x + m));
+			__m512 dy = _mm512_sub_ps(py, _mm512_load_ps(cp.y + m));
+			__m512 dz = _mm512_sub_ps(pz, _mm512_load_ps(cp.z + m));
+			__m512 r2 = _mm512_fmadd_ps(dz, dz, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dx, dx)));
+			__m512 gaussian = exp512(_mm512_mul_ps(negEta, r2));
+
+			sumX = _mm512_fmadd_ps(gaussian, _mm512_load_ps(cp.lambdaX + m), sumX);
+			sumY = _mm512_fmadd_ps(gaussian, _mm512_load_ps(cp.lambdaY + m), sumY);
+			sumZ = _mm512_fmadd_ps(gaussian, _mm512_load_ps(cp.lambdaZ + m), sumZ);
+		}
+
+		out[0] += _mm512_reduce_add_ps(sumX);
+		out[1] += _mm512_reduce_add_ps(sumY);
+		out[2] += _mm512_reduce_add_ps(sumZ);
+	}
+
+	VFG_TARGET("avx512f")
+	void avx512JacobianKernel(const RBFEvaluator::SoA &cp, unsigned int begin, unsigned int end, const float *pt, float *out, float *moments)
+	{
+		const __m512 p[3] = { _mm512_set1_ps(pt[0]), _mm512_set1_ps(pt[1]), _mm512_set1_ps(pt[2]) };
+		const __m512 negEta = _mm512_set1_ps(-cp.eta);
+		const float *centers[3] = { cp.x, cp.y, cp.z };
+		const float *lambdas[3] = { cp.lambdaX, cp.lambdaY, cp.lambdaZ };
+
+		__m512 sum[3], moment[9];
+		for (unsigned int k = 0u; k < 3u; ++k)
+			sum[k] = _mm512_setzero_ps();
+		for (unsigned int k = 0u; k < 9u; ++k)
+			moment[k] = _mm512_setzero_ps();
+
+		for (unsigned int m = begin; m < end; m += 16u)
+		{
+			__m512 d[3];
+			for (unsigned int k = 0u; k < 3u; ++k)
+				d[k] = _mm512_sub_ps(p[k], _mm512_load_ps(centers[k] + m));
+
+			__m512 r2 = _mm512_fmadd_ps(d[2], d[2], _mm512_fmadd_ps(d[1], d[1], _mm512_mul_ps(d[0], d[0])));
+			__m512 gaussian = exp512(_mm512_mul_ps(negEta, r2));
+
+			// one Gaussian feeds the value and all nine moments
+			for (unsigned int c = 0u; c < 3u; ++c)
+			{
+				__m512 weighted = _mm512_mul_ps(gaussian, _mm512_load_ps(lambdas[c] + m));
+				sum[c] = _mm512_add_ps(sum[c], weighted);
+				for (unsigned int k = 0u; k < 3u; ++k)
+					moment[3u * c + k] = _mm512_fmadd_ps(weighted, d[k], moment[3u * c + k]);
+			}
+		}
+
+		for (unsigned int c = 0u; c < 3u; ++c)
+			out[c] += _mm512_reduce_add_ps(sum[c]);
+		for (unsigned int k = 0u; k < 9u; ++k)
+			moments[k] += _mm512_reduce_add_ps(moment[k]);
+	}
+
+	VFG_TARGET("avx512f")
+	void avx512PacketKernel(const RBFEvaluator::SoA &cp, unsigned int begin, unsigned int end, const float *px, const float *py, const float *pz, float *outX, float *outY, float *outZ)
+	{
+		const __m512 x = _mm512_loadu_ps(px);
+		const __m512 y = _mm512_loadu_ps(py);
+		const __m512 z = _mm512_loadu_ps(pz);
+		const __m512 negEta = _mm512_set1_ps(-cp.eta);
+
+		__m512 sumX = _mm512_setzero_ps();
+		__m512 sumY = _mm512_setzero_ps();
+		__m512 sumZ = _mm512_setzero_ps();
+
+		for (unsigned int m = begin; m < end; ++m)
+		{
+			__m512 dx = _mm512_sub_ps(x, _mm512_set1_ps(cp.x[m]));
+			__m512 dy = _mm512_sub_ps(y, _mm512_set1_ps(cp.y[m]));
+			__m512 dz = _mm512_sub_ps(z, _mm512_set1_ps(cp.z[m]));
+			__m512 r2 = _mm512_fmadd_ps(dz, dz, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dx, dx)));
+			__m512 gaussian = exp512(_mm512_mul_ps(negEta, r2));
+
+			sumX = _mm512_fmadd_ps(gaussian, _mm512_set1_ps(cp.lambdaX[m]), sumX);
+			sumY = _mm512_fmadd_ps(gaussian, _mm512_set1_ps(cp.lambdaY[m]), sumY);
+			sumZ = _mm512_fmadd_ps(gaussian, _mm512_set1_ps(cp.lambdaZ[m]), sumZ);
+		}
+
+		_mm512_storeu_ps(outX, _mm512_add_ps(_mm512_loadu_ps(outX), sumX));
+		_mm512_storeu_ps(outY, _mm512_add_ps(_mm512_loadu_ps(outY), sumY));
+		_mm512_storeu_ps(outZ, _mm512_add_ps(_mm512_loadu_ps(outZ), sumZ));
+	}
+
+	VFG_TARGET("avx512f")
+	void avx512PacketJacobianKernel(const RBFEvaluator::SoA &cp, unsigned int begin, unsigned int end, const float *px, const float *py, const float *pz, float *out, float *moments, size_t stride)
+	{
+		const __m512 p[3] = { _mm512_loadu_ps(px), _mm512_loadu_ps(py), _mm512_loadu_ps(pz) };
+		const __m512 negEta = _mm512_set1_ps(-cp.eta);
+		const float *centers[3] = { cp.x, cp.y, cp.z };
+		const float *lambdas[3] = { cp.lambdaX, cp.lambdaY, cp.lambdaZ };
+
+		__m512 sum[3], moment[9];
+		for (unsigned int k = 0u; k < 3u; ++k)
+			sum[k] = _mm512_setzero_ps();
+		for (unsigned int k = 0u; k < 9u; ++k)
+			moment[k] = _mm512_setzero_ps();
+
+		for (unsigned int m = begin; m < end; ++m)
+		{
+			__m512 d[3];
+			for (unsigned int k = 0u; k < 3u; ++k)
+				d[k] = _mm512_sub_ps(p[k], _mm512_set1_ps(centers[k][m]));
+
+			__m512 r2 = _mm512_fmadd_ps(d[2], d[2], _mm512_fmadd_ps(d[1], d[1], _mm512_mul_ps(d[0], d[0])));
+			__m512 gaussian = exp512(_mm512_mul_ps(negEta, r2));
+
+			// one Gaussian per lane feeds the value and all nine moments of that lane's point
+			for (unsigned int c = 0u; c < 3u; ++c)
+			{
+				__m512 weighted = _mm512_mul_ps(gaussian, _mm512_set1_ps(lambdas[c][m]));
+				sum[c] = _mm512_add_ps(sum[c], weighted);
+				for (unsigned int k = 0u; k < 3u; ++k)
+					moment[3u * c + k] = _mm512_fmadd_ps(weighted, d[k], moment[3u * c + k]);
+			}
+		}
+
+		for (unsigned int c = 0u; c < 3u; ++c)
+			_mm512_storeu_ps(out + c * stride, _mm512_add_ps(_mm512_loadu_ps(out + c * stride), sum[c]));
+		for (unsigned int k = 0u; k < 9u; ++k)
+			_mm512_storeu_ps(moments + k * stride, _mm512_add_ps(_mm512_loadu_ps(moments + k * stride), moment[k]));
+	}
+#endif // VFG_AVX512
+
+	void cpuid(int info[4], int leaf, int subleaf)
+	{
+#ifdef _MSC_VER
+		__cpuidex(info, leaf, subleaf);
+#else
+		unsigned int a, b, c, d;
+		__cpuid_count(leaf, subleaf, a, b, c, d);
+		info[0] = a; info[1] = b; info[2] = c; info[3] = d;
+#endif
+	}
+
+	unsigned long long xgetbv(unsigned int index)
+	{
+#ifdef _MSC_VER
+		return _xgetbv(index);
+#else
+		unsigned int eax, edx;
+		__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(index));
+		return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+	}
+#endif // VFG_X86
+}
+
+RBFEvaluator::RBFEvaluator()
+	: m_pBuffer(NULL)
+	, m_uiCapacity(0u)
+	, m_uiControlPoints(0u)
+{
+	memset(&m_SoA, 0, sizeof(m_SoA));
+
+	setISA(detectISA());
+}
+
+RBFEvaluator::~RBFEvaluator()
+{
+#ifdef VFG_X86
+	if (m_pBuffer)
+		_mm_free(m_pBuffer);
+#else
+	delete[] m_pBuffer;
+#endif
+}
+
+void RBFEvaluator::reserve(unsigned int paddedCount)
+{
+	if (paddedCount <= m_uiCapacity)
+		return;
+
+#ifdef VFG_X86
+	if (m_pBuffer)
+		_mm_free(m_pBuffer);
+	m_pBuffer = static_cast<float*>(_mm_malloc(6u * paddedCount * sizeof(float), ALIGNMENT));
+#else
+	delete[] m_pBuffer;
+	m_pBuffer = new float[6u * paddedCount];
+#endif
+
+	m_uiCapacity = paddedCount;
+}
+
+void RBFEvaluator::setControlPoints(const std::vector<glm::vec3> &positions, const Eigen::VectorXf &lambdaX, const Eigen::VectorXf &lambdaY, const Eigen::VectorXf &lambdaZ, float eta)
+{
+	m_uiControlPoints = static_cast<unsigned int>(positions.size());
+
+	unsigned int padded = ((m_uiControlPoints + SIMD_WIDTH - 1u) / SIMD_WIDTH) * SIMD_WIDTH;
+	reserve(padded);
+
+	// component arrays sit back to back; padding entries get zero weight so they add nothing to the sum
+	float *x = m_pBuffer;
+	float *y = x + padded;
+	float *z = y + padded;
+	float *lx = z + padded;
+	float *ly = lx + padded;
+	float *lz = ly + padded;
+
+	memset(m_pBuffer, 0, 6u * padded * sizeof(float));
+
+	for (unsigned int i = 0u; i < m_uiControlPoints; ++i)
+	{
+		x[i] = positions[i].x;
+		y[i] = positions[i].y;
+		z[i] = positions[i].z;
+		lx[i] = lambdaX[i];
+		ly[i] = lambdaY[i];
+		lz[i] = lambdaZ[i];
+	}
+
+	m_SoA.x = x;
+	m_SoA.y = y;
+	m_SoA.z = z;
+	m_SoA.lambdaX = lx;
+	m_SoA.lambdaY = ly;
+	m_SoA.lambdaZ = lz;
+	m_SoA.count = padded;
+	m_SoA.eta = eta;
+}
+
+void RBFEvaluator::setWeights(const Eigen::MatrixXf &lambdas)
+{
+	// padding entries keep their zero weight
+	float *lx = const_cast<float*>(m_SoA.lambdaX);
+	float *ly = const_cast<float*>(m_SoA.lambdaY);
+	float *lz = const_cast<float*>(m_SoA.lambdaZ);
+
+	for (unsigned int i = 0u; i < m_uiControlPoints; ++i)
+	{
+		lx[i] = lambdas(i, 0);
+		ly[i] = lambdas(i, 1);
+		lz[i] = lambdas(i, 2);
+	}
+}
+
+glm::vec3 RBFEvaluator::interpolate(glm::vec3 pt) const
+{
+	float in[3] = { pt.x, pt.y, pt.z };
+	float out[3];
+
+	evaluate(in, 1u, out);
+
+	return glm::vec3(out[0], out[1], out[2]);
+}
+
+void RBFEvaluator::evaluate(const float *xyz, size_t n, float *out) const
+{
+	// the packet kernels read the points of a block as coordinate arrays; the padding centers carry zero weight,
+	// so they stop at the real centers
+	float packetX[POINT_BLOCK], packetY[POINT_BLOCK], packetZ[POINT_BLOCK];
+	float packetU[POINT_BLOCK], packetV[POINT_BLOCK], packetW[POINT_BLOCK];
+
+	// tile points against control point blocks so a block of CP data stays in L1 while
+	// every point of the current point block is summed against it
+	for (size_t p0 = 0u; p0 < n; p0 += POINT_BLOCK)
+	{
+		size_t p1 = std::min(p0 + POINT_BLOCK, n);
+		size_t packed = m_uiPacketWidth ? p0 + (p1 - p0) / m_uiPacketWidth * m_uiPacketWidth : p0;
+
+		for (size_t p = p0; p < packed; ++p)
+		{
+			packetX[p - p0] = xyz[3u * p + 0u];
+			packetY[p - p0] = xyz[3u * p + 1u];
+			packetZ[p - p0] = xyz[3u * p + 2u];
+			packetU[p - p0] = packetV[p - p0] = packetW[p - p0] = 0.f;
+		}
+
+		memset(out + 3u * packed, 0, 3u * (p1 - packed) * sizeof(float));
+
+		for (unsigned int c0 = 0u; c0 < m_SoA.count; c0 += CONTROL_POINT_BLOCK)
+		{
+			unsigned int c1 = std::min(c0 + CONTROL_POINT_BLOCK, m_SoA.count);
+			unsigned int real1 = std::min(c1, m_uiControlPoints);
+
+			for (size_t q = 0u; q < packed - p0; q += m_uiPacketWidth)
+				m_pfnPacketKernel(m_SoA, c0, real1, packetX + q, packetY + q, packetZ + q, packetU + q, packetV + q, packetW + q);
+
+			for (size_t p = packed; p < p1; ++p)
+				m_pfnKernel(m_SoA, c0, c1, xyz + 3u * p, out + 3u * p);
+		}
+
+		for (size_t p = p0; p < packed; ++p)
+		{
+			out[3u * p + 0u] = packetU[p - p0];
+			out[3u * p + 1u] = packetV[p - p0];
+			out[3u * p + 2u] = packetW[p - p0];
+		}
+	}
+}
+
+void RBFEvaluator::evaluateJacobian(const float *xyz, size_t n, float *out, float *jacobian) const
+{
+	// d/dx_d of lambda_c exp(-eta r^2) is -2 eta lambda_c exp(-eta r^2) (x_d - c_d), so the kernels sum the
+	// moments lambda_c exp(-eta r^2) (x_d - c_d) next to the value and the factor is applied once at the end.
+	// As in evaluate(), full packets go through the packet kernel, one point per lane; its values and moments are
+	// arrays of POINT_BLOCK floats, one per component
+	float packetX[POINT_BLOCK], packetY[POINT_BLOCK], packetZ[POINT_BLOCK];
+	float packetValues[3u * POINT_BLOCK], packetMoments[9u * POINT_BLOCK];
+
+	for (size_t p0 = 0u; p0 < n; p0 += POINT_BLOCK)
+	{
+		size_t p1 = std::min(p0 + POINT_BLOCK, n);
+		size_t packed = m_uiPacketWidth ? p0 + (p1 - p0) / m_uiPacketWidth * m_uiPacketWidth : p0;
+
+		for (size_t p = p0; p < packed; ++p)
+		{
+			packetX[p - p0] = xyz[3u * p + 0u];
+			packetY[p - p0] = xyz[3u * p + 1u];
+			packetZ[p - p0] = xyz[3u * p + 2u];
+		}
+
+		memset(packetValues, 0, sizeof(packetValues));
+		memset(packetMoments, 0, sizeof(packetMoments));
+		memset(out + 3u * packed, 0, 3u * (p1 - packed) * sizeof(float));
+		memset(jacobian + 9u * packed, 0, 9u * (p1 - packed) * sizeof(float));
+
+		for (unsigned int c0 = 0u; c0 < m_SoA.count; c0 += CONTROL_POINT_BLOCK)
+		{
+			unsigned int c1 = std::min(c0 + CONTROL_POINT_BLOCK, m_SoA.count);
+			unsigned int real1 = std::min(c1, m_uiControlPoints);
+
+			for (size_t q = 0u; q < packed - p0; q += m_uiPacketWidth)
+				m_pfnPacketJacobianKernel(m_SoA, c0, real1, packetX + q, packetY + q, packetZ + q, packetValues + q, packetMoments + q, POINT_BLOCK);
+
+			for (size_t p = packed; p < p1; ++p)
+				m_pfnJacobianKernel(m_SoA, c0, c1, xyz + 3u * p, out + 3u * p, jacobian + 9u * p);
+		}
+
+		for (size_t p = p0; p < packed; ++p)
+		{
+			for (unsigned int c = 0u; c < 3u; ++c)
+				out[3u * p + c] = packetValues[c * POINT_BLOCK + (p - p0)];
+			for (unsigned int k = 0u; k < 9u; ++k)
+				jacobian[9u * p + k] = packetMoments[k * POINT_BLOCK + (p - p0)];
+		}
+
+		for (size_t k = 9u * p0; k < 9u * p1; ++k)
+			jacobian[k] *= -2.f * m_SoA.eta;
+	}
+}
+
+const char* RBFEvaluator::getName() const
+{
+	return "direct";
+}
+
+unsigned int RBFEvaluator::getControlPointCount() const
+{
+	return m_uiControlPoints;
+}
+
+unsigned int RBFEvaluator::getPacketWidth() const
+{
+	return m_uiPacketWidth;
+}
+
+void RBFEvaluator::setISA(ISA isa)
+{
+	if (!isSupported(isa))
+		isa = detectISA();
+
+	m_eISA = isa;
+	m_pfnKernel = getKernel(isa);
+	m_pfnJacobianKernel = getJacobianKernel(isa);
+	m_pfnPacketKernel = getPacketKernel(isa, m_uiPacketWidth);
+	m_pfnPacketJacobianKernel = getPacketJacobianKernel(isa);
+}
+
+RBFEvaluator::ISA RBFEvaluator::getISA() const
+{
+	return m_eISA;
+}
+
+RBFEvaluator::KernelFunc RBFEvaluator::getKernel(ISA isa)
+{
+	switch (isa)
+	{
+#ifdef VFG_X86
+	case ISA_SSE4:
+		return sse4Kernel;
+	case ISA_AVX2:
+		return avx2Kernel;
+#ifdef VFG_AVX512
+	case ISA_AVX512:
+		return avx512Kernel;
+#endif
+#endif
+	default:
+		return scalarKernel;
+	}
+}
+
+RBFEvaluator::JacobianKernelFunc RBFEvaluator::getJacobianKernel(ISA isa)
+{
+	switch (isa)
+	{
+#ifdef VFG_X86
+	case ISA_SSE4:
+		return sse4JacobianKernel;
+	case ISA_AVX2:
+		return avx2JacobianKernel;
+#ifdef VFG_AVX512
+	case ISA_AVX512:
+		return avx512JacobianKernel;
+#endif
+#endif
+	default:
+		return scalarJacobianKernel;
+	}
+}
+
+RBFEvaluator::PacketKernelFunc RBFEvaluator::getPacketKernel(ISA isa, unsigned int &width)
+{
+	switch (isa)
+	{
+#ifdef VFG_X86
+	case ISA_SSE4:
+		width = 4u;
+		return sse4PacketKernel;
+	case ISA_AVX2:
+		width = 8u;
+		return avx2PacketKernel;
+#ifdef VFG_AVX512
+	case ISA_AVX512:
+		width = 16u;
+		return avx512PacketKernel;
+#endif
+#endif
+	default:
+		width = 0u;
+		return NULL;
+	}
+}
+
+RBFEvaluator::PacketJacobianKernelFunc RBFEvaluator::getPacketJacobianKernel(ISA isa)
+{
+	// same widths as getPacketKernel()
+	switch (isa)
+	{
+#ifdef VFG_X86
+	case ISA_SSE4:
+		return sse4PacketJacobianKernel;
+	case ISA_AVX2:
+		return avx2PacketJacobianKernel;
+#ifdef VFG_AVX512
+	case ISA_AVX512:
+		return avx512PacketJacobianKernel;
+#endif
+#endif
+	default:
+		return NULL;
+	}
+}
+
+RBFEvaluator::ISA RBFEvaluator::detectISA()
+{
+	if (isSupported(ISA_AVX512))
+		return ISA_AVX512;
+	if (isSupported(ISA_AVX2))
+		return ISA_AVX2;
+	if (isSupported(ISA_SSE4))
+		return ISA_SSE4;
+
+	return ISA_SCALAR;
+}
+
+bool RBFEvaluator::isSupported(ISA isa)
+{
+	if (isa == ISA_SCALAR)
+		return true;
+
+#ifdef VFG_X86
+	int info[4];
+	cpuid(info, 0, 0);
+	int maxLeaf = info[0];
+
+	cpuid(info, 1, 0);
+	bool sse41 = (info[2] & (1 << 19)) != 0;
+	bool fma = (info[2] & (1 << 12)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+
+	if (isa == ISA_SSE4)
+		return sse41;
+
+	// the OS must save the wider register state across context switches
+	unsigned long long xcr0 = osxsave ? xgetbv(0) : 0ull;
+	bool ymmState = (xcr0 & 0x6ull) == 0x6ull;
+	bool zmmState = (xcr0 & 0xE6ull) == 0xE6ull;
+
+	bool avx2 = false, avx512f = false;
+	if (maxLeaf >= 7)
+	{
+		cpuid(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+		avx512f = (info[1] & (1 << 16)) != 0;
+	}
+
+	if (isa == ISA_AVX2)
+		return avx && avx2 && fma && ymmState;
+
+#ifdef VFG_AVX512
+	if (isa == ISA_AVX512)
+		return avx512f && zmmState;
+#endif
+#endif
+
+	return false;
+}
+
+const char* RBFEvaluator::getISAName(ISA isa)
+{
+	switch (isa)
+	{
+	case ISA_SSE4:
+		return "SSE4.1";
+	case ISA_AVX2:
+		return "AVX2";
+	case ISA_AVX512:
+		return "AVX-512";
+	default:
+		return "scalar";
+	}
+}
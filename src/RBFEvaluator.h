@@ -0,0 +1,114 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <Eigen/Dense>
+
+#include "FieldEvaluator.h"
+
+// Evaluates a Gaussian RBF vector field from control point positions and lambda weights
+// kept in aligned structure-of-arrays buffers. The inner kernel is picked at runtime from
+// the widest instruction set the CPU supports (SSE4.1, AVX2+FMA or AVX-512). Batches go through packet
+// kernels that hold one point per lane and broadcast the centers, so few centers still fill every lane; the
+// single point kernels, with one center per lane, take the points left over.
+class RBFEvaluator : public FieldEvaluator
+{
+public:
+	enum ISA {
+		ISA_SCALAR = 0,
+		ISA_SSE4,
+		ISA_AVX2,
+		ISA_AVX512
+	};
+
+	// Read-only view of the SoA buffers handed to the kernels
+	struct SoA {
+		const float *x, *y, *z;
+		const float *lambdaX, *lambdaY, *lambdaZ;
+		unsigned int count; // padded to a multiple of SIMD_WIDTH
+		float eta;
+	};
+
+	// Buffers are padded to the widest kernel (16 lanes) with zero-weight centers
+	static const unsigned int SIMD_WIDTH = 16u;
+
+	// Tile sizes for batched evaluation; a CP block is 6 floats per center (24 KB at 1024 centers). POINT_BLOCK
+	// is a multiple of every packet width.
+	static const size_t POINT_BLOCK = 64u;
+	static const unsigned int CONTROL_POINT_BLOCK = 1024u;
+
+public:
+	RBFEvaluator();
+	~RBFEvaluator();
+
+	void setControlPoints(const std::vector<glm::vec3> &positions, const Eigen::VectorXf &lambdaX, const Eigen::VectorXf &lambdaY, const Eigen::VectorXf &lambdaZ, float eta);
+
+	// Replace the weights only (N x 3, one column per component); the positions stay as they are
+	void setWeights(const Eigen::MatrixXf &lambdas);
+
+	glm::vec3 interpolate(glm::vec3 pt) const;
+
+	// Evaluate the field at n points given as packed xyz triples, writing packed xyz vectors to out
+	void evaluate(const float *xyz, size_t n, float *out) const override;
+
+	// Same pass over the centers, also summing lambda * exp(-eta r^2) * (x - c) for the analytic Jacobian; full
+	// packets go through packet Jacobian kernels like evaluate()
+	void evaluateJacobian(const float *xyz, size_t n, float *out, float *jacobian) const override;
+
+	const char* getName() const override;
+
+	unsigned int getControlPointCount() const;
+
+	// Points per packet kernel call for the active ISA (4, 8 or 16; 0 for the scalar kernel, which has none)
+	unsigned int getPacketWidth() const;
+
+	// Force a specific kernel (falls back to the best supported one if unavailable)
+	void setISA(ISA isa);
+	ISA getISA() const;
+
+	static ISA detectISA();
+	static bool isSupported(ISA isa);
+	static const char* getISAName(ISA isa);
+
+private:
+	// Adds the contribution of centers [begin, end) at one point to out
+	typedef void (*KernelFunc)(const SoA &cp, unsigned int begin, unsigned int end, const float *pt, float *out);
+
+	// As KernelFunc, also adding sum lambda_c * gaussian * (pt_d - center_d) to moments[3c + d]
+	typedef void (*JacobianKernelFunc)(const SoA &cp, unsigned int begin, unsigned int end, const float *pt, float *out, float *moments);
+
+	// Adds the contribution of centers [begin, end) at packet-width points given as coordinate arrays to the
+	// output arrays
+	typedef void (*PacketKernelFunc)(const SoA &cp, unsigned int begin, unsigned int end, const float *px, const float *py, const float *pz, float *outX, float *outY, float *outZ);
+
+	// As PacketKernelFunc, also adding the moments of JacobianKernelFunc. Values and moments are per-component
+	// arrays stride floats apart: out + c * stride for component c, moments + (3c + d) * stride for moment 3c + d
+	typedef void (*PacketJacobianKernelFunc)(const SoA &cp, unsigned int begin, unsigned int end, const float *px, const float *py, const float *pz, float *out, float *moments, size_t stride);
+
+	static KernelFunc getKernel(ISA isa);
+	static JacobianKernelFunc getJacobianKernel(ISA isa);
+	static PacketKernelFunc getPacketKernel(ISA isa, unsigned int &width);
+	static PacketJacobianKernelFunc getPacketJacobianKernel(ISA isa);
+
+	void reserve(unsigned int paddedCount);
+
+private:
+	float *m_pBuffer; // single aligned allocation holding all six component arrays
+	unsigned int m_uiCapacity;
+	unsigned int m_uiControlPoints;
+
+	SoA m_SoA;
+
+	ISA m_eISA;
+	KernelFunc m_pfnKernel;
+	JacobianKernelFunc m_pfnJacobianKernel;
+	PacketKernelFunc m_pfnPacketKernel;
+	PacketJacobianKernelFunc m_pfnPacketJacobianKernel;
+	unsigned int m_uiPacketWidth;
+
+private:
+	RBFEvaluator(const RBFEvaluator&);
+	RBFEvaluator& operator=(const RBFEvaluator&);
+};
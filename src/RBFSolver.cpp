@@ -0,0 +1,613 @@
+#include "RBFSolver.h"
+
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <numeric>
+
+#include "RBFEvaluator.h"
+#include "ThreadPool.h"
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	// points per parallelFor index when applying the kernel
+	const size_t MATVEC_CHUNK = 256u;
+
+	// centers of the Nystrom approximation that preconditions solveMatrixFree(), and the seed that picks them
+	const Eigen::Index PRECONDITIONER_LANDMARKS = 1000;
+	const unsigned int LANDMARK_SEED = 0x5EEDu;
+
+	double secondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+}
+
+RBFSolver::RBFSolver()
+	: m_eMethod(METHOD_LLT)
+	, m_fRegularization(0.f)
+	, m_fTolerance(1e-4f)
+	, m_uiMaxIterations(1000u)
+{
+	m_Report.method = m_eMethod;
+	m_Report.success = false;
+	m_Report.regularization = 0.f;
+	m_Report.conditionEstimate = 0.f;
+	m_Report.factorSeconds = 0.0;
+	m_Report.solveSeconds = 0.0;
+	m_Report.iterations = 0u;
+	m_Report.residual = 0.f;
+	m_Report.nonZeros = 0u;
+}
+
+RBFSolver::~RBFSolver()
+{
+}
+
+void RBFSolver::setMethod(Method method)
+{
+	m_eMethod = method;
+}
+
+RBFSolver::Method RBFSolver::getMethod() const
+{
+	return m_eMethod;
+}
+
+void RBFSolver::setRegularization(float mu)
+{
+	m_fRegularization = mu;
+}
+
+float RBFSolver::getRegularization() const
+{
+	return m_fRegularization;
+}
+
+void RBFSolver::setTolerance(float tolerance)
+{
+	m_fTolerance = tolerance;
+}
+
+float RBFSolver::getTolerance() const
+{
+	return m_fTolerance;
+}
+
+void RBFSolver::setMaxIterations(unsigned int maxIterations)
+{
+	m_uiMaxIterations = maxIterations;
+}
+
+unsigned int RBFSolver::getMaxIterations() const
+{
+	return m_uiMaxIterations;
+}
+
+bool RBFSolver::solve(const Eigen::MatrixXf &kernel, const Eigen::MatrixXf &rhs, Eigen::MatrixXf &solution)
+{
+	m_Report.method = m_eMethod > METHOD_LDLT ? METHOD_LLT : m_eMethod;
+	m_Report.regularization = m_fRegularization;
+	m_Report.success = false;
+	m_Report.iterations = 0u;
+	m_Report.residual = 0.f;
+	m_Report.nonZeros = static_cast<size_t>(kernel.size());
+
+	// factor time includes any attempts that had to fall back to a more robust method
+	Clock::time_point factorStart = Clock::now();
+
+	if (m_Report.method == METHOD_LLT)
+	{
+		factor(m_LLT, kernel);
+
+		if (m_LLT.info() == Eigen::Success)
+		{
+			m_Report.factorSeconds = secondsSince(factorStart);
+
+			Clock::time_point solveStart = Clock::now();
+			solution = m_LLT.solve(rhs);
+			m_Report.solveSeconds = secondsSince(solveStart);
+
+			m_Report.conditionEstimate = 1.f / m_LLT.rcond();
+			m_Report.success = solution.allFinite();
+
+			if (m_Report.success)
+				return true;
+		}
+
+		// rounding can leave a Gaussian kernel of clustered points slightly indefinite, or so near singular that
+		// the factorization succeeds but the solve overflows
+		m_Report.method = METHOD_LDLT;
+	}
+
+	if (m_Report.method == METHOD_LDLT)
+	{
+		factor(m_LDLT, kernel);
+
+		if (m_LDLT.info() == Eigen::Success)
+		{
+			m_Report.factorSeconds = secondsSince(factorStart);
+
+			Clock::time_point solveStart = Clock::now();
+			solution = m_LDLT.solve(rhs);
+			m_Report.solveSeconds = secondsSince(solveStart);
+
+			m_Report.conditionEstimate = 1.f / m_LDLT.rcond();
+			m_Report.success = solution.allFinite();
+
+			if (m_Report.success)
+				return true;
+		}
+
+		// numerically singular, or factored but with a solve that overflows; full-pivot LU still returns a
+		// least-squares-like answer, as the original solver did
+		m_Report.method = METHOD_FULL_PIV_LU;
+	}
+
+	factor(m_LU, kernel);
+	m_Report.factorSeconds = secondsSince(factorStart);
+
+	Clock::time_point solveStart = Clock::now();
+	solution = m_LU.solve(rhs);
+	m_Report.solveSeconds = secondsSince(solveStart);
+
+	m_Report.conditionEstimate = 1.f / m_LU.rcond();
+	m_Report.success = solution.allFinite();
+
+	return m_Report.success;
+}
+
+bool RBFSolver::leaveOneOut(const Eigen::MatrixXf &kernel, const Eigen::MatrixXf &rhs, Eigen::MatrixXf &errors)
+{
+	m_Report.method = METHOD_LLT;
+	m_Report.regularization = m_fRegularization;
+	m_Report.success = false;
+	m_Report.iterations = 0u;
+	m_Report.residual = 0.f;
+	m_Report.nonZeros = static_cast<size_t>(kernel.size());
+
+	Eigen::Index n = kernel.rows();
+	Eigen::MatrixXf coefficients;
+	Eigen::VectorXf inverseDiagonal;
+
+	Clock::time_point factorStart = Clock::now();
+
+	factor(m_LLT, kernel);
+
+	if (m_LLT.info() == Eigen::Success)
+	{
+		m_Report.factorSeconds = secondsSince(factorStart);
+
+		Clock::time_point solveStart = Clock::now();
+		coefficients = m_LLT.solve(rhs);
+
+		// K^-1 = L^-T * L^-1, so its diagonal is the squared column norms of L^-1; one triangular inverse is
+		// a third of the work of inverting K
+		Eigen::MatrixXf inverseL = Eigen::MatrixXf::Identity(n, n);
+		m_LLT.matrixL().solveInPlace(inverseL);
+		inverseDiagonal = inverseL.colwise().squaredNorm().transpose();
+
+		m_Report.solveSeconds = secondsSince(solveStart);
+		m_Report.conditionEstimate = 1.f / m_LLT.rcond();
+	}
+	else
+	{
+		factor(m_LDLT, kernel);
+		m_Report.method = METHOD_LDLT;
+		m_Report.factorSeconds = secondsSince(factorStart);
+
+		// the errors of a numerically singular kernel are rounding noise, so there is no LU fallback here
+		if (m_LDLT.info() != Eigen::Success)
+			return false;
+
+		Clock::time_point solveStart = Clock::now();
+		coefficients = m_LDLT.solve(rhs);
+		inverseDiagonal = m_LDLT.solve(Eigen::MatrixXf::Identity(n, n)).diagonal();
+
+		m_Report.solveSeconds = secondsSince(solveStart);
+		m_Report.conditionEstimate = 1.f / m_LDLT.rcond();
+	}
+
+	errors = coefficients.array().colwise() / inverseDiagonal.array();
+
+	m_Report.success = errors.allFinite();
+
+	return m_Report.success;
+}
+
+bool RBFSolver::solveSparse(const Eigen::SparseMatrix<float> &kernel, const Eigen::MatrixXf &rhs, Eigen::MatrixXf &solution)
+{
+	m_Report.method = METHOD_SPARSE_LDLT;
+	m_Report.regularization = m_fRegularization;
+	m_Report.success = false;
+	m_Report.conditionEstimate = 0.f; // not available from the sparse factorizations
+	m_Report.iterations = 0u;
+	m_Report.residual = 0.f;
+	m_Report.nonZeros = static_cast<size_t>(kernel.nonZeros());
+
+	releaseFactorizations();
+
+	Eigen::SparseMatrix<float> regularized;
+	const Eigen::SparseMatrix<float> *system = &kernel;
+	if (m_fRegularization > 0.f)
+	{
+		Eigen::SparseMatrix<float> identity(kernel.rows(), kernel.cols());
+		identity.setIdentity();
+		regularized = kernel + m_fRegularization * identity;
+		system = &regularized;
+	}
+
+	if (m_eMethod == METHOD_CG)
+	{
+		m_Report.method = METHOD_CG;
+		m_Report.factorSeconds = 0.0;
+
+		Clock::time_point solveStart = Clock::now();
+
+		// no factorization and no fill-in: memory and cost per iteration follow the nonzeros, and when the support
+		// radius shrinks with the point spacing the condition number, and so the iteration count, stays bounded
+		Eigen::ConjugateGradient<Eigen::SparseMatrix<float>, Eigen::Lower | Eigen::Upper> cg;
+		cg.setTolerance(m_fTolerance);
+		cg.setMaxIterations(static_cast<Eigen::Index>(m_uiMaxIterations));
+		cg.compute(*system);
+
+		bool warmStart = solution.rows() == kernel.rows() && solution.cols() == 3;
+		if (!warmStart)
+			solution = Eigen::MatrixXf::Zero(kernel.rows(), 3);
+
+		bool converged = true;
+		for (int c = 0; c < 3; ++c)
+		{
+			solution.col(c) = cg.solveWithGuess(rhs.col(c), Eigen::VectorXf(solution.col(c)));
+
+			converged = converged && cg.info() == Eigen::Success;
+			m_Report.iterations = std::max(m_Report.iterations, static_cast<unsigned int>(cg.iterations()));
+			m_Report.residual = std::max(m_Report.residual, static_cast<float>(cg.error()));
+		}
+
+		m_Report.solveSeconds = secondsSince(solveStart);
+		m_Report.success = converged && solution.allFinite();
+
+		return m_Report.success;
+	}
+
+	Clock::time_point factorStart = Clock::now();
+
+	// Wendland kernels are positive definite, so the fill-reducing sparse Cholesky normally succeeds
+	Eigen::SimplicialLDLT<Eigen::SparseMatrix<float>> ldlt(*system);
+
+	if (ldlt.info() == Eigen::Success)
+	{
+		m_Report.factorSeconds = secondsSince(factorStart);
+
+		Clock::time_point solveStart = Clock::now();
+		solution = ldlt.solve(rhs);
+		m_Report.solveSeconds = secondsSince(solveStart);
+
+		m_Report.success = ldlt.info() == Eigen::Success && solution.allFinite();
+
+		if (m_Report.success)
+			return true;
+	}
+
+	m_Report.method = METHOD_SPARSE_LU;
+
+	Eigen::SparseLU<Eigen::SparseMatrix<float>> lu;
+	lu.analyzePattern(*system);
+	lu.factorize(*system);
+	m_Report.factorSeconds = secondsSince(factorStart);
+
+	if (lu.info() != Eigen::Success)
+		return false;
+
+	Clock::time_point solveStart = Clock::now();
+	solution = lu.solve(rhs);
+	m_Report.solveSeconds = secondsSince(solveStart);
+
+	m_Report.success = solution.allFinite();
+
+	return m_Report.success;
+}
+
+bool RBFSolver::solveMatrixFree(const std::vector<glm::vec3> &positions, float eta, const Eigen::MatrixXf &rhs, Eigen::MatrixXf &solution, ThreadPool &pool)
+{
+	m_Report.method = METHOD_CG;
+	m_Report.regularization = m_fRegularization;
+	m_Report.success = false;
+	m_Report.conditionEstimate = 0.f; // not available without a factorization
+	m_Report.iterations = 0u;
+	m_Report.residual = 0.f;
+	m_Report.nonZeros = 0u;
+
+	releaseFactorizations();
+
+	const Eigen::Index n = static_cast<Eigen::Index>(positions.size());
+	const float mu = m_fRegularization;
+
+	Clock::time_point factorStart = Clock::now();
+
+	// the kernel product K * X is the field with weights X evaluated at the control points themselves
+	RBFEvaluator op;
+	Eigen::VectorXf zero = Eigen::VectorXf::Zero(n);
+	op.setControlPoints(positions, zero, zero, zero, eta);
+
+	std::vector<float> points(3u * n);
+	for (Eigen::Index i = 0; i < n; ++i)
+	{
+		points[3 * i + 0] = positions[i].x;
+		points[3 * i + 1] = positions[i].y;
+		points[3 * i + 2] = positions[i].z;
+	}
+
+	typedef Eigen::Matrix<float, Eigen::Dynamic, 3, Eigen::RowMajor> PackedMatrix;
+	PackedMatrix packed(n, 3);
+	Eigen::MatrixXf weights(n, 3);
+
+	const size_t nChunks = (static_cast<size_t>(n) + MATVEC_CHUNK - 1u) / MATVEC_CHUNK;
+
+	// the kernel product runs in float on the SIMD evaluator; the CG vectors are kept in double
+	// so the recursive residual does not drift away from the true one over hundreds of iterations
+	auto applyKernel = [&](const Eigen::MatrixXd &x, Eigen::MatrixXd &result)
+	{
+		weights = x.cast<float>();
+		op.setWeights(weights);
+
+		pool.parallelFor(0u, nChunks, [&](size_t chunk)
+		{
+			size_t begin = chunk * MATVEC_CHUNK;
+			size_t count = std::min(MATVEC_CHUNK, static_cast<size_t>(n) - begin);
+			op.evaluate(&points[3u * begin], count, packed.data() + 3u * begin);
+		});
+
+		result = packed.cast<double>();
+		if (mu > 0.f)
+			result += static_cast<double>(mu) * x;
+	};
+
+	// Plain CG stalls here: a wide Gaussian has a few hundred large eigenvalues and all the others sit near mu,
+	// and block Jacobi over spatial cells (local LLT per cell) measured no better. The Nystrom approximation
+	// K ~ C W^-1 C^T, with C the kernel columns of m landmark centers and W their own kernel, captures exactly those
+	// large eigenvalues, and by Woodbury
+	//   (C W^-1 C^T + mu I)^-1 = (I - C (mu W + C^T C)^-1 C^T) / mu
+	// needs only an m x m factorization. C is never stored; its row blocks are recomputed in double for both
+	// products, since the division by mu magnifies float rounding and an inconsistent C^T and C would make the
+	// preconditioner unsymmetric. It needs mu > 0, so unregularized solves run plain CG.
+	const Eigen::Index nLandmarks = mu > 0.f ? std::min(n, PRECONDITIONER_LANDMARKS) : 0;
+
+	Eigen::Matrix<double, Eigen::Dynamic, 3> points64(n, 3), landmarks64(nLandmarks, 3);
+	Eigen::VectorXd pointNorms, landmarkNorms;
+	Eigen::LDLT<Eigen::MatrixXd> core;
+
+	for (Eigen::Index i = 0; i < n; ++i)
+		points64.row(i) << positions[i].x, positions[i].y, positions[i].z;
+
+	// the m x (end - begin) block of C^T for points [begin, end)
+	auto landmarkBlock = [&](size_t begin, size_t end, Eigen::MatrixXd &block)
+	{
+		Eigen::Index rows = static_cast<Eigen::Index>(end - begin);
+		block.noalias() = landmarks64 * points64.middleRows(begin, rows).transpose();
+		block = ((2.0 * block).colwise() - landmarkNorms).rowwise() - pointNorms.segment(begin, rows).transpose();
+		block = (static_cast<double>(eta) * block.cwiseMin(0.0)).array().exp().matrix();
+	};
+
+	std::vector<Eigen::MatrixXd> blocks(pool.getThreadCount());
+
+	if (nLandmarks > 0)
+	{
+		// a fixed-seed random subset, so refits of the same points precondition the same way
+		std::vector<unsigned int> order(n);
+		std::iota(order.begin(), order.end(), 0u);
+		std::mt19937 rng(LANDMARK_SEED);
+		for (Eigen::Index i = 0; i < nLandmarks; ++i)
+			std::swap(order[i], order[std::uniform_int_distribution<Eigen::Index>(i, n - 1)(rng)]);
+
+		for (Eigen::Index i = 0; i < nLandmarks; ++i)
+			landmarks64.row(i) = points64.row(order[i]);
+
+		pointNorms = points64.rowwise().squaredNorm();
+		landmarkNorms = landmarks64.rowwise().squaredNorm();
+
+		// C^T C in row blocks of C, one partial sum per thread
+		std::vector<Eigen::MatrixXd> partial(pool.getThreadCount(), Eigen::MatrixXd::Zero(nLandmarks, nLandmarks));
+		pool.parallelForStealing(0u, static_cast<size_t>(n), MATVEC_CHUNK, [&](size_t begin, size_t end, unsigned int thread)
+		{
+			landmarkBlock(begin, end, blocks[thread]);
+			partial[thread].selfadjointView<Eigen::Lower>().rankUpdate(blocks[thread]);
+		});
+
+		Eigen::MatrixXd system = Eigen::MatrixXd::Zero(nLandmarks, nLandmarks);
+		for (const Eigen::MatrixXd &sum : partial)
+			system += sum;
+
+		for (Eigen::Index i = 0; i < nLandmarks; ++i)
+		{
+			for (Eigen::Index j = 0; j <= i; ++j)
+				system(i, j) += static_cast<double>(mu) * std::exp(-eta * (landmarks64.row(i) - landmarks64.row(j)).squaredNorm());
+		}
+
+		core.compute(system);
+	}
+
+	std::vector<Eigen::Matrix<double, Eigen::Dynamic, 3> > projections(pool.getThreadCount());
+
+	auto applyPreconditioner = [&](const Eigen::MatrixXd &r, Eigen::MatrixXd &z)
+	{
+		if (nLandmarks == 0)
+		{
+			z = r;
+			return;
+		}
+
+		// C^T r
+		for (Eigen::Matrix<double, Eigen::Dynamic, 3> &projection : projections)
+			projection.setZero(nLandmarks, 3);
+
+		pool.parallelForStealing(0u, static_cast<size_t>(n), MATVEC_CHUNK, [&](size_t begin, size_t end, unsigned int thread)
+		{
+			landmarkBlock(begin, end, blocks[thread]);
+			projections[thread].noalias() += blocks[thread] * r.middleRows(begin, end - begin);
+		});
+
+		for (size_t t = 1u; t < projections.size(); ++t)
+			projections[0] += projections[t];
+
+		// (r - C (mu W + C^T C)^-1 C^T r) / mu
+		Eigen::Matrix<double, Eigen::Dynamic, 3> t = core.solve(projections[0]);
+
+		z.resize(n, 3);
+		pool.parallelForStealing(0u, static_cast<size_t>(n), MATVEC_CHUNK, [&](size_t begin, size_t end, unsigned int thread)
+		{
+			landmarkBlock(begin, end, blocks[thread]);
+			z.middleRows(begin, end - begin).noalias() = (r.middleRows(begin, end - begin) - blocks[thread].transpose() * t) / static_cast<double>(mu);
+		});
+	};
+
+	m_Report.factorSeconds = secondsSince(factorStart);
+
+	Clock::time_point solveStart = Clock::now();
+
+	Eigen::MatrixXd x;
+	if (solution.rows() == n && solution.cols() == 3)
+		x = solution.cast<double>();
+	else
+		x = Eigen::MatrixXd::Zero(n, 3);
+
+	const Eigen::MatrixXd b = rhs.cast<double>();
+
+	// the three columns share one kernel product and one preconditioner application per iteration
+	Eigen::MatrixXd r(n, 3), z(n, 3), p(n, 3), q(n, 3);
+
+	applyKernel(x, q);
+	r = b - q;
+	applyPreconditioner(r, z);
+	p = z;
+
+	double rhsNorm[3], rz[3];
+	bool converged[3], brokeDown[3];
+	for (int c = 0; c < 3; ++c)
+	{
+		rhsNorm[c] = std::max(b.col(c).norm(), 1e-30);
+		rz[c] = r.col(c).dot(z.col(c));
+		converged[c] = r.col(c).norm() <= m_fTolerance * rhsNorm[c];
+		brokeDown[c] = false;
+	}
+
+	// a column is done once it converges or breaks down
+	auto done = [&](int c) { return converged[c] || brokeDown[c]; };
+
+	unsigned int iteration = 0u;
+	while (!(done(0) && done(1) && done(2)) && iteration < m_uiMaxIterations)
+	{
+		applyKernel(p, q);
+		++iteration;
+
+		for (int c = 0; c < 3; ++c)
+		{
+			// finished columns are frozen; they still ride along in the shared products
+			if (done(c))
+				continue;
+
+			double pq = p.col(c).dot(q.col(c));
+			if (!(pq > 0.0))
+			{
+				// float rounding in the kernel product broke positive definiteness; the column stops where it is
+				// and the solve fails
+				brokeDown[c] = true;
+				continue;
+			}
+
+			double alpha = rz[c] / pq;
+			x.col(c) += alpha * p.col(c);
+			r.col(c) -= alpha * q.col(c);
+
+			converged[c] = r.col(c).norm() <= m_fTolerance * rhsNorm[c];
+		}
+
+		if (done(0) && done(1) && done(2))
+			break;
+
+		applyPreconditioner(r, z);
+
+		for (int c = 0; c < 3; ++c)
+		{
+			if (done(c))
+				continue;
+
+			double rzNew = r.col(c).dot(z.col(c));
+			if (!(rzNew > 0.0))
+			{
+				// likewise for the float products inside the preconditioner
+				brokeDown[c] = true;
+				continue;
+			}
+
+			p.col(c) = z.col(c) + (rzNew / rz[c]) * p.col(c);
+			rz[c] = rzNew;
+		}
+	}
+
+	m_Report.solveSeconds = secondsSince(solveStart);
+	m_Report.iterations = iteration;
+
+	solution = x.cast<float>();
+
+	// report the true residual of the float weights rather than the recursive one
+	applyKernel(solution.cast<double>(), q);
+	r = b - q;
+
+	float worst = 0.f;
+	for (int c = 0; c < 3; ++c)
+		worst = std::max(worst, static_cast<float>(r.col(c).norm() / rhsNorm[c]));
+	m_Report.residual = worst;
+
+	m_Report.success = solution.allFinite() && converged[0] && converged[1] && converged[2];
+
+	return m_Report.success;
+}
+
+template <typename Factorization>
+void RBFSolver::factor(Factorization &factorization, const Eigen::MatrixXf &kernel)
+{
+	// compute() copies its argument into the factorization's own matrix, resized only if N changed; passing
+	// K + mu * I as an expression adds the regularization during that copy instead of in a temporary N x N
+	if (m_fRegularization > 0.f)
+		factorization.compute(kernel + m_fRegularization * Eigen::MatrixXf::Identity(kernel.rows(), kernel.cols()));
+	else
+		factorization.compute(kernel);
+}
+
+void RBFSolver::releaseFactorizations()
+{
+	m_LLT = Eigen::LLT<Eigen::MatrixXf>();
+	m_LDLT = Eigen::LDLT<Eigen::MatrixXf>();
+	m_LU = Eigen::FullPivLU<Eigen::MatrixXf>();
+}
+
+const RBFSolver::Report& RBFSolver::getReport() const
+{
+	return m_Report;
+}
+
+const char* RBFSolver::getMethodName(Method method)
+{
+	switch (method)
+	{
+	case METHOD_FULL_PIV_LU:
+		return "FullPivLU";
+	case METHOD_LLT:
+		return "LLT";
+	case METHOD_LDLT:
+		return "LDLT";
+	case METHOD_CG:
+		return "CG";
+	case METHOD_SPARSE_LDLT:
+		return "SparseLDLT";
+	case METHOD_SPARSE_LU:
+		return "SparseLU";
+	default:
+		return "unknown";
+	}
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+
+class ThreadPool;
+
+// Solves the RBF interpolation system K * Lambda = F for all three field components at once.
+// The kernel matrix is factorized a single time and the factorization is applied to the N x 3
+// right-hand side. An optional Tikhonov term solves (K + mu * I) instead, for near-singular layouts.
+// For control point counts where an N x N matrix no longer fits in memory, solveMatrixFree() runs
+// conjugate gradients preconditioned with a Nystrom approximation of K and applies the kernel on the fly
+// with the SIMD evaluator. Kernels of compactly
+// supported bases are sparse and go through solveSparse() instead.
+class RBFSolver
+{
+public:
+	enum Method {
+		METHOD_FULL_PIV_LU, // most robust, most expensive; the original solver
+		METHOD_LLT,         // Cholesky; falls back to LDLT if K is not numerically positive definite
+		METHOD_LDLT,        // pivoted Cholesky; falls back to full-pivot LU if K is numerically singular
+		METHOD_CG,          // conjugate gradients (solveMatrixFree, or solveSparse on the assembled sparse kernel)
+		METHOD_SPARSE_LDLT, // sparse Cholesky (solveSparse only); falls back to sparse LU
+		METHOD_SPARSE_LU
+	};
+
+	struct Report {
+		Method method;           // factorization that actually produced the solution
+		bool success;
+		float regularization;
+		float conditionEstimate; // 1 / rcond(), an estimate of the L1 condition number of the (regularized) kernel
+		double factorSeconds;
+		double solveSeconds;
+		unsigned int iterations; // METHOD_CG only
+		float residual;          // METHOD_CG only: largest relative residual |F - K * Lambda| / |F| over the three columns
+		size_t nonZeros;         // stored kernel entries (N^2 for dense solves, 0 for matrix-free)
+	};
+
+public:
+	RBFSolver();
+	~RBFSolver();
+
+	void setMethod(Method method);
+	Method getMethod() const;
+
+	// Tikhonov parameter mu added to the kernel diagonal (0 = exact interpolation)
+	void setRegularization(float mu);
+	float getRegularization() const;
+
+	// Stopping criteria for METHOD_CG: relative residual and iteration cap
+	void setTolerance(float tolerance);
+	float getTolerance() const;
+	void setMaxIterations(unsigned int maxIterations);
+	unsigned int getMaxIterations() const;
+
+	// Direct solve of an assembled kernel (METHOD_CG is treated as METHOD_LLT here)
+	bool solve(const Eigen::MatrixXf &kernel, const Eigen::MatrixXf &rhs, Eigen::MatrixXf &solution);
+
+	// Leave-one-out cross-validation errors of the interpolant (Rippa): with c = K^-1 * F, the error of predicting
+	// point i from all the others is c_i / (K^-1)_ii, so one factorization yields all N errors of all three columns
+	// instead of N separate solves. Uses LLT, then LDLT, and the regularization of solve(); a kernel neither can
+	// factor fails, as its errors would only reflect rounding.
+	bool leaveOneOut(const Eigen::MatrixXf &kernel, const Eigen::MatrixXf &rhs, Eigen::MatrixXf &errors);
+
+	// Sparse solve of a compactly supported kernel: METHOD_CG runs conjugate gradients (warm started if solution
+	// is already N x 3), any other method the sparse LDLT -> LU chain
+	bool solveSparse(const Eigen::SparseMatrix<float> &kernel, const Eigen::MatrixXf &rhs, Eigen::MatrixXf &solution);
+
+	// Conjugate gradient solve of the Gaussian kernel system at the given positions without forming K.
+	// With mu > 0 it is preconditioned by the Nystrom approximation on m = min(N, 1000) landmark centers,
+	// which takes a few iterations where plain CG stalls; without mu it runs plain CG. Memory is O(N + m^2);
+	// each iteration costs one multithreaded O(N^2) kernel product and 2 N m kernel entries for the preconditioner.
+	// If solution is already N x 3 it is used as the starting guess (e.g. lambdas from a previous fit).
+	bool solveMatrixFree(const std::vector<glm::vec3> &positions, float eta, const Eigen::MatrixXf &rhs, Eigen::MatrixXf &solution, ThreadPool &pool);
+
+	const Report& getReport() const;
+
+	static const char* getMethodName(Method method);
+
+private:
+	// Factors kernel + mu * I into the given member factorization
+	template <typename Factorization>
+	void factor(Factorization &factorization, const Eigen::MatrixXf &kernel);
+
+	void releaseFactorizations();
+
+private:
+	Method m_eMethod;
+	float m_fRegularization;
+	float m_fTolerance;
+	unsigned int m_uiMaxIterations;
+	Report m_Report;
+
+	// Dense factorizations, kept so that refits with the same number of control points (e.g. the --onlyadvects
+	// retry loop) factor into the storage of the previous fit instead of allocating N x N again. The LDLT and LU
+	// only grow if a fit ever falls back to them; sparse and matrix-free solves release all three.
+	Eigen::LLT<Eigen::MatrixXf> m_LLT;
+	Eigen::LDLT<Eigen::MatrixXf> m_LDLT;
+	Eigen::FullPivLU<Eigen::MatrixXf> m_LU;
+};
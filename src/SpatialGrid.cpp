@@ -0,0 +1,66 @@
+#include "SpatialGrid.h"
+
+#include <cmath>
+
+SpatialGrid::SpatialGrid()
+	: m_vec3Origin(0.f)
+	, m_fCellSize(1.f)
+{
+	m_iDims[0] = m_iDims[1] = m_iDims[2] = 0;
+}
+
+SpatialGrid::~SpatialGrid()
+{
+}
+
+void SpatialGrid::build(const std::vector<glm::vec3> &positions, float radius)
+{
+	m_vCellStart.clear();
+	m_vOrder.clear();
+
+	if (positions.empty())
+		return;
+
+	glm::vec3 lo(positions[0]), hi(positions[0]);
+	for (auto const &p : positions)
+	{
+		lo = glm::min(lo, p);
+		hi = glm::max(hi, p);
+	}
+
+	glm::vec3 extent = hi - lo;
+	float maxExtent = std::max(extent.x, std::max(extent.y, extent.z));
+
+	// keep the cell count in the order of the point count; a small radius over sparse points would
+	// otherwise allocate mostly empty cells, and wider cells only add candidates, never lose neighbors
+	float maxCellsPerAxis = std::max(std::cbrt(2.f * static_cast<float>(positions.size())), 4.f);
+	m_fCellSize = std::max(std::max(radius, maxExtent / maxCellsPerAxis), 1e-6f);
+
+	m_vec3Origin = lo;
+	for (int a = 0; a < 3; ++a)
+		m_iDims[a] = static_cast<int>(extent[a] / m_fCellSize) + 1;
+
+	size_t nCells = static_cast<size_t>(m_iDims[0]) * m_iDims[1] * m_iDims[2];
+
+	// counting sort of the points by cell
+	std::vector<unsigned int> cellOf(positions.size());
+	m_vCellStart.assign(nCells + 1u, 0u);
+
+	for (size_t i = 0u; i < positions.size(); ++i)
+	{
+		glm::ivec3 c = glm::ivec3((positions[i] - m_vec3Origin) / m_fCellSize);
+		c = glm::clamp(c, glm::ivec3(0), glm::ivec3(m_iDims[0] - 1, m_iDims[1] - 1, m_iDims[2] - 1));
+
+		cellOf[i] = static_cast<unsigned int>((static_cast<size_t>(c.z) * m_iDims[1] + c.y) * m_iDims[0] + c.x);
+		++m_vCellStart[cellOf[i] + 1u];
+	}
+
+	for (size_t c = 0u; c < nCells; ++c)
+		m_vCellStart[c + 1u] += m_vCellStart[c];
+
+	std::vector<unsigned int> fill(m_vCellStart.begin(), m_vCellStart.end() - 1);
+	m_vOrder.resize(positions.size());
+
+	for (size_t i = 0u; i < positions.size(); ++i)
+		m_vOrder[fill[cellOf[i]]++] = static_cast<unsigned int>(i);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+// Uniform bucket grid over a set of points for fixed-radius neighbor queries. Cells are at least
+// one query radius wide, so every point within the radius of a query lies in the 3 x 3 x 3 block of
+// cells around it. Points are stored sorted by cell, so each cell is one contiguous index range.
+class SpatialGrid
+{
+public:
+	SpatialGrid();
+	~SpatialGrid();
+
+	void build(const std::vector<glm::vec3> &positions, float radius);
+
+	// Calls func(begin, end) with the sorted-order index range of each non-empty cell around pt
+	template <typename Func>
+	void forEachCellRange(const glm::vec3 &pt, Func func) const
+	{
+		if (m_vCellStart.empty())
+			return;
+
+		glm::vec3 cell = glm::floor((pt - m_vec3Origin) / m_fCellSize);
+
+		// a point more than a cell outside the bounds has no neighbors, which the clamping turns into an empty loop
+		int lo[3], hi[3];
+		for (int a = 0; a < 3; ++a)
+		{
+			float c = std::max(std::min(cell[a], static_cast<float>(m_iDims[a] + 1)), -2.f);
+			lo[a] = std::max(static_cast<int>(c) - 1, 0);
+			hi[a] = std::min(static_cast<int>(c) + 1, m_iDims[a] - 1);
+		}
+
+		for (int z = lo[2]; z <= hi[2]; ++z)
+		{
+			for (int y = lo[1]; y <= hi[1]; ++y)
+			{
+				// cells along x are adjacent in sorted order, so each row of the block is one range
+				size_t row = (static_cast<size_t>(z) * m_iDims[1] + y) * m_iDims[0];
+				unsigned int begin = m_vCellStart[row + lo[0]];
+				unsigned int end = m_vCellStart[row + hi[0] + 1];
+
+				if (begin < end)
+					func(begin, end);
+			}
+		}
+	}
+
+	// Original index of each point in sorted (cell) order
+	const std::vector<unsigned int>& getOrder() const { return m_vOrder; }
+
+	size_t getCellCount() const { return m_vCellStart.empty() ? 0u : m_vCellStart.size() - 1u; }
+	float getCellSize() const { return m_fCellSize; }
+
+private:
+	glm::vec3 m_vec3Origin;
+	float m_fCellSize;
+	int m_iDims[3];
+
+	std::vector<unsigned int> m_vCellStart; // cell count + 1 offsets into m_vOrder
+	std::vector<unsigned int> m_vOrder;
+};
@@ -0,0 +1,181 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int nThreads)
+	: m_pTask(NULL)
+	, m_NextIndex(0u)
+	, m_ullGeneration(0ull)
+	, m_uiFinishedWorkers(0u)
+	, m_bQuit(false)
+{
+	if (nThreads == 0u)
+		nThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+	m_pChunkRanges.reset(new std::atomic<unsigned long long>[nThreads]);
+	for (unsigned int i = 0u; i < nThreads; ++i)
+		m_pChunkRanges[i] = 0ull;
+
+	// the calling thread is thread 0
+	for (unsigned int i = 1u; i < nThreads; ++i)
+		m_vWorkers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_bQuit = true;
+	}
+	m_cvWork.notify_all();
+
+	for (auto &t : m_vWorkers)
+		t.join();
+}
+
+unsigned int ThreadPool::getThreadCount() const
+{
+	return static_cast<unsigned int>(m_vWorkers.size()) + 1u;
+}
+
+void ThreadPool::parallelFor(size_t begin, size_t end, const std::function<void(size_t)> &func)
+{
+	if (m_vWorkers.empty() || end - begin <= 1u)
+	{
+		for (size_t i = begin; i < end; ++i)
+			func(i);
+		return;
+	}
+
+	m_NextIndex = begin;
+
+	run([&](unsigned int) {
+		for (size_t i = m_NextIndex++; i < end; i = m_NextIndex++)
+			func(i);
+	});
+}
+
+void ThreadPool::parallelForStealing(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t, unsigned int)> &func)
+{
+	if (end <= begin)
+		return;
+
+	grain = std::max<size_t>(grain, 1u);
+	size_t nChunks = (end - begin + grain - 1u) / grain;
+
+	if (m_vWorkers.empty() || nChunks <= 1u)
+	{
+		for (size_t c = begin; c < end; c += grain)
+			func(c, std::min(c + grain, end), 0u);
+		return;
+	}
+
+	// equal contiguous shares to start with
+	unsigned int nThreads = getThreadCount();
+	for (unsigned int t = 0u; t < nThreads; ++t)
+	{
+		unsigned long long first = nChunks * t / nThreads;
+		unsigned long long last = nChunks * (t + 1u) / nThreads;
+		m_pChunkRanges[t] = (last << 32) | first;
+	}
+
+	run([&](unsigned int thread) {
+		unsigned int chunk;
+		while (nextChunk(thread, chunk))
+		{
+			size_t chunkBegin = begin + chunk * grain;
+			func(chunkBegin, std::min(chunkBegin + grain, end), thread);
+		}
+	});
+}
+
+bool ThreadPool::nextChunk(unsigned int thread, unsigned int &chunk)
+{
+	std::atomic<unsigned long long> &own = m_pChunkRanges[thread];
+
+	// own range first, from the front
+	unsigned long long range = own.load();
+	while (static_cast<unsigned int>(range) < static_cast<unsigned int>(range >> 32))
+	{
+		if (own.compare_exchange_weak(range, range + 1ull))
+		{
+			chunk = static_cast<unsigned int>(range);
+			return true;
+		}
+	}
+
+	// then the back half of the first other thread that has anything left
+	unsigned int nThreads = getThreadCount();
+	for (unsigned int offset = 1u; offset < nThreads; ++offset)
+	{
+		std::atomic<unsigned long long> &victim = m_pChunkRanges[(thread + offset) % nThreads];
+
+		range = victim.load();
+		while (true)
+		{
+			unsigned long long first = range & 0xFFFFFFFFull;
+			unsigned long long last = range >> 32;
+			if (first >= last)
+				break;
+
+			unsigned long long middle = first + (last - first) / 2u;
+			if (victim.compare_exchange_weak(range, (middle << 32) | first))
+			{
+				// run the first stolen chunk now and keep the rest as the new own range, open to thieves in turn
+				chunk = static_cast<unsigned int>(middle);
+				own = (last << 32) | (middle + 1u);
+				return true;
+			}
+		}
+	}
+
+	// chunks a thief holds between its two updates are not seen here, but that thief runs them
+	return false;
+}
+
+void ThreadPool::run(const std::function<void(unsigned int)> &task)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_pTask = &task;
+		m_uiFinishedWorkers = 0u;
+		++m_ullGeneration;
+	}
+	m_cvWork.notify_all();
+
+	task(0u);
+
+	// every worker has to check in before the next loop may reuse the shared job state
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_cvDone.wait(lock, [this] { return m_uiFinishedWorkers == m_vWorkers.size(); });
+	m_pTask = NULL;
+}
+
+void ThreadPool::workerLoop(unsigned int thread)
+{
+	unsigned long long seenGeneration = 0ull;
+
+	while (true)
+	{
+		const std::function<void(unsigned int)> *task;
+
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_cvWork.wait(lock, [&] { return m_bQuit || m_ullGeneration != seenGeneration; });
+
+			if (m_bQuit)
+				return;
+
+			seenGeneration = m_ullGeneration;
+			task = m_pTask;
+		}
+
+		(*task)(thread);
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			++m_uiFinishedWorkers;
+		}
+		m_cvDone.notify_one();
+	}
+}
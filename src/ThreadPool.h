@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+// Fixed-size pool of worker threads for data-parallel loops. The calling thread takes part in
+// every loop, so a pool of N threads runs N - 1 workers and a pool of 1 runs everything inline.
+class ThreadPool
+{
+public:
+	// nThreads == 0 uses one thread per hardware core
+	ThreadPool(unsigned int nThreads = 0u);
+	~ThreadPool();
+
+	unsigned int getThreadCount() const;
+
+	// Calls func(i) for every i in [begin, end) and returns once all calls have finished.
+	// Indices are handed out one at a time, so uneven work per index balances across threads.
+	void parallelFor(size_t begin, size_t end, const std::function<void(size_t)> &func);
+
+	// Calls func(chunkBegin, chunkEnd, thread) for consecutive chunks of at most grain indices covering
+	// [begin, end), with thread in [0, getThreadCount()) for per-thread scratch. Each thread starts on its own
+	// contiguous share of the chunks and, once that runs dry, steals the back half of another thread's rest,
+	// so a few long chunks cannot leave the other threads idle while no chunk needs a shared counter.
+	void parallelForStealing(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t, unsigned int)> &func);
+
+private:
+	// Runs task(thread) once on every thread of the pool and returns when all have finished
+	void run(const std::function<void(unsigned int)> &task);
+
+	void workerLoop(unsigned int thread);
+
+	// Next chunk of the thread's own range, or one stolen from another; false once all ranges are empty
+	bool nextChunk(unsigned int thread, unsigned int &chunk);
+
+private:
+	std::vector<std::thread> m_vWorkers;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_cvWork;
+	std::condition_variable m_cvDone;
+
+	const std::function<void(unsigned int)> *m_pTask;
+	std::atomic<size_t> m_NextIndex;
+
+	// parallelForStealing: per thread the chunk range [begin, end) still to do, packed as end << 32 | begin so
+	// the owner taking the front and a thief splitting off the back agree through one compare-and-swap
+	std::unique_ptr<std::atomic<unsigned long long>[]> m_pChunkRanges;
+	unsigned long long m_ullGeneration;
+	unsigned int m_uiFinishedWorkers;
+	bool m_bQuit;
+
+private:
+	ThreadPool(const ThreadPool&);
+	ThreadPool& operator=(const ThreadPool&);
+};
@@ -0,0 +1,393 @@
+#include "TrajectoryFile.h"
+
+#include <cstring>
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+static_assert(sizeof(glm::vec3) == 12u, "trajectory points are read and written as packed float triples");
+
+namespace
+{
+	const char MAGIC[4] = { 'V', 'F', 'G', 'T' };
+
+	// stdio buffer of the writer, so the many short trajectories go out in large writes
+	const size_t WRITE_BUFFER = 1u << 20;
+
+	float segmentDistance(glm::vec3 p, glm::vec3 a, glm::vec3 b)
+	{
+		glm::vec3 ab = b - a;
+		float lengthSq = glm::dot(ab, ab);
+		float t = lengthSq > 0.f ? glm::clamp(glm::dot(p - a, ab) / lengthSq, 0.f, 1.f) : 0.f;
+
+		return glm::length(p - (a + t * ab));
+	}
+}
+
+void TrajectoryFile::simplify(const glm::vec3 *points, size_t nPoints, float tolerance, std::vector<glm::vec3> &out, std::vector<size_t> &scratch)
+{
+	out.clear();
+
+	if (!(tolerance > 0.f) || nPoints <= 2u)
+	{
+		out.assign(points, points + nPoints);
+		return;
+	}
+
+	// a stack of index ranges still to split; a range is final when all its inner points are within tolerance
+	// of its chord, and the ranges come off the stack left to right, so their starts are the points kept
+	scratch.clear();
+	scratch.push_back(nPoints - 1u);
+	size_t first = 0u;
+
+	while (!scratch.empty())
+	{
+		size_t last = scratch.back();
+
+		float maxDistance = 0.f;
+		size_t farthest = first;
+		for (size_t i = first + 1u; i < last; ++i)
+		{
+			float distance = segmentDistance(points[i], points[first], points[last]);
+			if (distance > maxDistance)
+			{
+				maxDistance = distance;
+				farthest = i;
+			}
+		}
+
+		if (maxDistance > tolerance)
+		{
+			scratch.push_back(farthest);
+		}
+		else
+		{
+			out.push_back(points[first]);
+			first = last;
+			scratch.pop_back();
+		}
+	}
+
+	out.push_back(points[nPoints - 1u]);
+}
+
+TrajectoryWriter::TrajectoryWriter()
+	: m_pFile(NULL)
+	, m_fSimplification(0.f)
+	, m_bGood(false)
+	, m_ullPointCount(0u)
+{
+}
+
+TrajectoryWriter::~TrajectoryWriter()
+{
+	if (m_pFile)
+		fclose(m_pFile);
+}
+
+bool TrajectoryWriter::open(std::string path)
+{
+	if (m_pFile)
+		fclose(m_pFile);
+
+	m_pFile = NULL;
+#ifdef _WIN32
+	fopen_s(&m_pFile, path.c_str(), "wb");
+#else
+	m_pFile = fopen(path.c_str(), "wb");
+#endif
+
+	m_bGood = m_pFile != NULL;
+	if (m_bGood)
+		setvbuf(m_pFile, NULL, _IOFBF, WRITE_BUFFER);
+
+	return m_bGood;
+}
+
+void TrajectoryWriter::setSimplification(float tolerance)
+{
+	m_fSimplification = tolerance;
+}
+
+float TrajectoryWriter::getSimplification() const
+{
+	return m_fSimplification;
+}
+
+bool TrajectoryWriter::good() const
+{
+	return m_bGood;
+}
+
+uint64_t TrajectoryWriter::getPointCount() const
+{
+	return m_ullPointCount;
+}
+
+void TrajectoryWriter::begin(size_t nTrajectories, unsigned int nThreads)
+{
+	m_ullPointCount = 0u;
+	m_vIndex.assign(nTrajectories, TrajectoryFile::IndexEntry());
+	m_vScratch.resize(std::max(nThreads, 1u));
+
+	if (!m_pFile)
+	{
+		m_bGood = false;
+		return;
+	}
+
+	// a placeholder header, completed in end() once the counts are known
+	TrajectoryFile::Header header = {};
+	m_bGood = fwrite(&header, sizeof(header), 1u, m_pFile) == 1u;
+}
+
+void TrajectoryWriter::write(unsigned int thread, size_t trajectory, const Trajectory &metadata, const glm::vec3 *points, size_t nPoints)
+{
+	if (!m_pFile)
+		return;
+
+	if (m_fSimplification > 0.f)
+	{
+		Scratch &scratch = m_vScratch[thread];
+		TrajectoryFile::simplify(points, nPoints, m_fSimplification, scratch.points, scratch.stack);
+		points = scratch.points.data();
+		nPoints = scratch.points.size();
+	}
+
+	TrajectoryFile::IndexEntry &entry = m_vIndex[trajectory];
+	entry.pointCount = static_cast<uint32_t>(nPoints);
+	entry.steps = metadata.steps;
+	entry.seed[0] = metadata.seed.x;
+	entry.seed[1] = metadata.seed.y;
+	entry.seed[2] = metadata.seed.z;
+	entry.flags = metadata.exited ? TrajectoryFile::FLAG_EXITED : 0u;
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	entry.firstPoint = m_ullPointCount;
+	m_ullPointCount += nPoints;
+
+	if (nPoints > 0u && fwrite(points, sizeof(glm::vec3), nPoints, m_pFile) != nPoints)
+		m_bGood = false;
+}
+
+void TrajectoryWriter::end()
+{
+	if (!m_pFile)
+		return;
+
+	uint64_t pointBytes = m_ullPointCount * sizeof(glm::vec3);
+	uint64_t indexOffset = (sizeof(TrajectoryFile::Header) + pointBytes + 7u) & ~7ull;
+
+	const unsigned char padding[8] = {};
+	size_t nPadding = static_cast<size_t>(indexOffset - sizeof(TrajectoryFile::Header) - pointBytes);
+	if (nPadding > 0u && fwrite(padding, 1u, nPadding, m_pFile) != nPadding)
+		m_bGood = false;
+
+	if (!m_vIndex.empty() && fwrite(m_vIndex.data(), sizeof(TrajectoryFile::IndexEntry), m_vIndex.size(), m_pFile) != m_vIndex.size())
+		m_bGood = false;
+
+	TrajectoryFile::Header header = {};
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = TrajectoryFile::VERSION;
+	header.trajectoryCount = m_vIndex.size();
+	header.pointCount = m_ullPointCount;
+	header.indexOffset = indexOffset;
+	header.simplification = std::max(m_fSimplification, 0.f);
+
+	if (fseek(m_pFile, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1u, m_pFile) != 1u)
+		m_bGood = false;
+
+	if (fclose(m_pFile) != 0)
+		m_bGood = false;
+	m_pFile = NULL;
+
+	m_vIndex.clear();
+	m_vIndex.shrink_to_fit();
+}
+
+TrajectoryReader::TrajectoryReader()
+	: m_pData(NULL)
+	, m_ullSize(0u)
+	, m_pHeader(NULL)
+	, m_pIndex(NULL)
+	, m_pPoints(NULL)
+#ifdef _WIN32
+	, m_hFile(INVALID_HANDLE_VALUE)
+	, m_hMapping(NULL)
+#else
+	, m_iFile(-1)
+#endif
+{
+}
+
+TrajectoryReader::~TrajectoryReader()
+{
+	close();
+}
+
+bool TrajectoryReader::open(std::string path)
+{
+	close();
+
+#ifdef _WIN32
+	m_hFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (m_hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_hFile, &size) || size.QuadPart < static_cast<LONGLONG>(sizeof(TrajectoryFile::Header)))
+	{
+		close();
+		return false;
+	}
+	m_ullSize = static_cast<uint64_t>(size.QuadPart);
+
+	m_hMapping = CreateFileMappingA(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m_hMapping == NULL)
+	{
+		close();
+		return false;
+	}
+
+	m_pData = static_cast<const unsigned char*>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+#else
+	m_iFile = ::open(path.c_str(), O_RDONLY);
+	if (m_iFile < 0)
+		return false;
+
+	struct stat status;
+	if (fstat(m_iFile, &status) != 0 || status.st_size < static_cast<off_t>(sizeof(TrajectoryFile::Header)))
+	{
+		close();
+		return false;
+	}
+	m_ullSize = static_cast<uint64_t>(status.st_size);
+
+	void *mapping = mmap(NULL, static_cast<size_t>(m_ullSize), PROT_READ, MAP_SHARED, m_iFile, 0);
+	m_pData = mapping == MAP_FAILED ? NULL : static_cast<const unsigned char*>(mapping);
+#endif
+
+	if (m_pData == NULL)
+	{
+		close();
+		return false;
+	}
+
+	m_pHeader = reinterpret_cast<const TrajectoryFile::Header*>(m_pData);
+
+	// every count and offset checked against the file size before anything is dereferenced through them
+	const TrajectoryFile::Header &header = *m_pHeader;
+	uint64_t maxPoints = (m_ullSize - sizeof(TrajectoryFile::Header)) / sizeof(glm::vec3);
+	uint64_t maxTrajectories = m_ullSize / sizeof(TrajectoryFile::IndexEntry);
+
+	bool valid = memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0
+		&& header.version == TrajectoryFile::VERSION
+		&& header.pointCount <= maxPoints
+		&& header.trajectoryCount <= maxTrajectories
+		&& header.indexOffset % 8u == 0u
+		&& header.indexOffset >= sizeof(TrajectoryFile::Header) + header.pointCount * sizeof(glm::vec3)
+		&& header.indexOffset <= m_ullSize
+		&& header.trajectoryCount <= (m_ullSize - header.indexOffset) / sizeof(TrajectoryFile::IndexEntry);
+
+	if (valid)
+	{
+		m_pIndex = reinterpret_cast<const TrajectoryFile::IndexEntry*>(m_pData + header.indexOffset);
+		m_pPoints = reinterpret_cast<const glm::vec3*>(m_pData + sizeof(TrajectoryFile::Header));
+
+		for (uint64_t i = 0u; i < header.trajectoryCount && valid; ++i)
+			valid = m_pIndex[i].firstPoint <= header.pointCount && m_pIndex[i].pointCount <= header.pointCount - m_pIndex[i].firstPoint;
+	}
+
+	if (!valid)
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void TrajectoryReader::close()
+{
+#ifdef _WIN32
+	if (m_pData)
+		UnmapViewOfFile(m_pData);
+	if (m_hMapping != NULL)
+		CloseHandle(m_hMapping);
+	if (m_hFile != INVALID_HANDLE_VALUE)
+		CloseHandle(m_hFile);
+
+	m_hMapping = NULL;
+	m_hFile = INVALID_HANDLE_VALUE;
+#else
+	if (m_pData)
+		munmap(const_cast<unsigned char*>(m_pData), static_cast<size_t>(m_ullSize));
+	if (m_iFile >= 0)
+		::close(m_iFile);
+
+	m_iFile = -1;
+#endif
+
+	m_pData = NULL;
+	m_ullSize = 0u;
+	m_pHeader = NULL;
+	m_pIndex = NULL;
+	m_pPoints = NULL;
+}
+
+bool TrajectoryReader::isOpen() const
+{
+	return m_pHeader != NULL;
+}
+
+size_t TrajectoryReader::size() const
+{
+	return m_pHeader ? static_cast<size_t>(m_pHeader->trajectoryCount) : 0u;
+}
+
+uint64_t TrajectoryReader::getPointCount() const
+{
+	return m_pHeader ? m_pHeader->pointCount : 0u;
+}
+
+float TrajectoryReader::getSimplification() const
+{
+	return m_pHeader ? m_pHeader->simplification : 0.f;
+}
+
+TrajectorySink::Trajectory TrajectoryReader::getTrajectory(size_t trajectory) const
+{
+	const TrajectoryFile::IndexEntry &entry = m_pIndex[trajectory];
+
+	TrajectorySink::Trajectory metadata;
+	metadata.seed = glm::vec3(entry.seed[0], entry.seed[1], entry.seed[2]);
+	metadata.steps = entry.steps;
+	metadata.exited = (entry.flags & TrajectoryFile::FLAG_EXITED) != 0u;
+
+	return metadata;
+}
+
+TrajectorySet::Span TrajectoryReader::getPoints(size_t trajectory) const
+{
+	const TrajectoryFile::IndexEntry &entry = m_pIndex[trajectory];
+
+	TrajectorySet::Span span;
+	span.data = m_pPoints + entry.firstPoint;
+	span.count = entry.pointCount;
+
+	return span;
+}
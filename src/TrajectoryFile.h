@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+
+#include <glm/glm.hpp>
+
+#include "TrajectorySink.h"
+#include "TrajectorySet.h"
+
+// Binary trajectory file: a fixed header, the points of every trajectory as packed float32 xyz triples, then an
+// index with one entry per trajectory, in trajectory order, giving where its points start and how many there
+// are. Points go out in the order the trajectories finish, so the index is the only way to find them; with it,
+// any trajectory is one lookup away without reading the others. Little-endian, as written by the host.
+//
+//   Header | points (12 bytes each) | padding to 8 bytes | IndexEntry x trajectoryCount
+namespace TrajectoryFile
+{
+	const uint32_t VERSION = 1u;
+
+	// Left the cube rather than ran out of time (TrajectorySink::Trajectory::exited)
+	const uint32_t FLAG_EXITED = 1u;
+
+	struct Header {
+		char magic[4];              // "VFGT"
+		uint32_t version;
+		uint64_t trajectoryCount;
+		uint64_t pointCount;
+		uint64_t indexOffset;       // bytes from the start of the file
+		float simplification;       // Douglas-Peucker tolerance the points were written with, 0 if none
+		uint32_t reserved[7];
+	};
+
+	struct IndexEntry {
+		uint64_t firstPoint;        // in points, from the start of the point block
+		uint32_t pointCount;
+		uint32_t steps;             // integration steps, steps + 1 points before simplification
+		float seed[3];
+		uint32_t flags;
+	};
+
+	static_assert(sizeof(Header) == 64u, "trajectory file header must stay 64 bytes");
+	static_assert(sizeof(IndexEntry) == 32u, "trajectory file index entry must stay 32 bytes");
+
+	// Douglas-Peucker: the fewest of the points, first and last always among them, such that every point lies
+	// within tolerance of the polyline through the ones kept. Iterative, so long paths cannot overflow the stack;
+	// scratch is reused between calls. A tolerance of 0 or below keeps every point.
+	void simplify(const glm::vec3 *points, size_t nPoints, float tolerance, std::vector<glm::vec3> &out, std::vector<size_t> &scratch);
+}
+
+// Streams the trajectories a sink receives to a trajectory file. Points are written as soon as a trajectory
+// finishes, so memory stays at one index entry (32 bytes) per trajectory however long the paths; the index and
+// the final header go out in end().
+class TrajectoryWriter : public TrajectorySink
+{
+public:
+	TrajectoryWriter();
+	~TrajectoryWriter();
+
+	// Creates or truncates the file; false if it cannot be opened
+	bool open(std::string path);
+
+	// Douglas-Peucker tolerance applied to every trajectory before it is written, 0 (the default) for none
+	void setSimplification(float tolerance);
+	float getSimplification() const;
+
+	// False once any write has failed
+	bool good() const;
+
+	// Points written so far
+	uint64_t getPointCount() const;
+
+	void begin(size_t nTrajectories, unsigned int nThreads) override;
+	void write(unsigned int thread, size_t trajectory, const Trajectory &metadata, const glm::vec3 *points, size_t nPoints) override;
+	void end() override; // also closes the file
+
+private:
+	// Per-thread simplification buffers
+	struct Scratch {
+		std::vector<glm::vec3> points;
+		std::vector<size_t> stack;
+	};
+
+private:
+	FILE *m_pFile;
+	float m_fSimplification;
+	bool m_bGood;
+	uint64_t m_ullPointCount;
+	std::vector<TrajectoryFile::IndexEntry> m_vIndex;
+	std::vector<Scratch> m_vScratch;
+	std::mutex m_Mutex; // the file position and point count
+};
+
+// Memory-maps a trajectory file for random access: the points of a trajectory come back as a span straight into
+// the mapping, so opening is cheap and only the pages actually touched are read from disk
+class TrajectoryReader
+{
+public:
+	TrajectoryReader();
+	~TrajectoryReader();
+
+	// the mapping and file handles are owned, so a copy would unmap them twice
+	TrajectoryReader(const TrajectoryReader&) = delete;
+	TrajectoryReader& operator=(const TrajectoryReader&) = delete;
+
+	// Maps the file and checks the header and index against its size; false if it is not a valid trajectory file
+	bool open(std::string path);
+	void close();
+	bool isOpen() const;
+
+	// Number of trajectories
+	size_t size() const;
+	uint64_t getPointCount() const;
+	float getSimplification() const;
+
+	TrajectorySink::Trajectory getTrajectory(size_t trajectory) const;
+
+	// Valid until close()
+	TrajectorySet::Span getPoints(size_t trajectory) const;
+
+private:
+	const unsigned char *m_pData;
+	uint64_t m_ullSize;
+	const TrajectoryFile::Header *m_pHeader;
+	const TrajectoryFile::IndexEntry *m_pIndex;
+	const glm::vec3 *m_pPoints;
+#ifdef _WIN32
+	void *m_hFile;
+	void *m_hMapping;
+#else
+	int m_iFile;
+#endif
+};
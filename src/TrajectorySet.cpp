@@ -0,0 +1,100 @@
+#include "TrajectorySet.h"
+
+#include <algorithm>
+
+TrajectorySet::TrajectorySet()
+	: m_vOffsets(1u, 0u)
+{
+}
+
+TrajectorySet::~TrajectorySet()
+{
+}
+
+size_t TrajectorySet::size() const
+{
+	return m_vTrajectories.size();
+}
+
+size_t TrajectorySet::getPointCount() const
+{
+	return m_vOffsets.back();
+}
+
+const TrajectorySet::Trajectory& TrajectorySet::getTrajectory(size_t trajectory) const
+{
+	return m_vTrajectories[trajectory];
+}
+
+TrajectorySet::Span TrajectorySet::getPoints(size_t trajectory) const
+{
+	Span span;
+	span.data = m_vPoints.data() + m_vOffsets[trajectory];
+	span.count = m_vOffsets[trajectory + 1u] - m_vOffsets[trajectory];
+
+	return span;
+}
+
+TrajectorySet::Span TrajectorySet::getAllPoints() const
+{
+	Span span;
+	span.data = m_vPoints.data();
+	span.count = m_vOffsets.back();
+
+	return span;
+}
+
+const std::vector<size_t>& TrajectorySet::getOffsets() const
+{
+	return m_vOffsets;
+}
+
+void TrajectorySet::clear()
+{
+	m_vPoints.clear();
+	m_vOffsets.assign(1u, 0u);
+	m_vTrajectories.clear();
+}
+
+void TrajectorySet::begin(size_t nTrajectories, unsigned int nThreads)
+{
+	// sizes only shrink or grow; the capacity stays for the next fill
+	m_vTrajectories.resize(nTrajectories);
+	m_vOffsets.assign(nTrajectories + 1u, 0u);
+
+	m_vArenas.resize(std::max(nThreads, 1u));
+	for (auto &arena : m_vArenas)
+	{
+		arena.points.clear();
+		arena.pieces.clear();
+	}
+}
+
+void TrajectorySet::write(unsigned int thread, size_t trajectory, const Trajectory &metadata, const glm::vec3 *points, size_t nPoints)
+{
+	Arena &arena = m_vArenas[thread];
+	arena.pieces.push_back(std::make_pair(trajectory, arena.points.size()));
+	arena.points.insert(arena.points.end(), points, points + nPoints);
+
+	m_vTrajectories[trajectory] = metadata;
+
+	// the count goes one entry up, where the prefix sum of end() expects it
+	m_vOffsets[trajectory + 1u] = nPoints;
+}
+
+void TrajectorySet::end()
+{
+	for (size_t i = 1u; i < m_vOffsets.size(); ++i)
+		m_vOffsets[i] += m_vOffsets[i - 1u];
+
+	m_vPoints.resize(m_vOffsets.back());
+
+	for (auto const &arena : m_vArenas)
+	{
+		for (auto const &piece : arena.pieces)
+		{
+			size_t count = m_vOffsets[piece.first + 1u] - m_vOffsets[piece.first];
+			std::copy(arena.points.begin() + piece.second, arena.points.begin() + piece.second + count, m_vPoints.begin() + m_vOffsets[piece.first]);
+		}
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+
+#include <glm/glm.hpp>
+
+#include "TrajectorySink.h"
+
+// Advected particle paths in compressed sparse row layout: the points of all trajectories back to back in one
+// buffer, trajectory i holding points [offsets[i], offsets[i + 1]), plus a small metadata record per trajectory.
+// Consumers take spans straight out of the buffer, and refilling a set reuses its allocations.
+class TrajectorySet : public TrajectorySink
+{
+public:
+	// Contiguous, read-only run of points
+	struct Span {
+		const glm::vec3 *data;
+		size_t count;
+
+		const glm::vec3* begin() const { return data; }
+		const glm::vec3* end() const { return data + count; }
+		size_t size() const { return count; }
+		const glm::vec3& operator[](size_t i) const { return data[i]; }
+	};
+
+public:
+	TrajectorySet();
+	~TrajectorySet();
+
+	// Number of trajectories
+	size_t size() const;
+	size_t getPointCount() const;
+
+	const Trajectory& getTrajectory(size_t trajectory) const;
+	Span getPoints(size_t trajectory) const;
+
+	// Every point of every trajectory, in trajectory order
+	Span getAllPoints() const;
+
+	// size() + 1 entries, the first 0 and the last getPointCount()
+	const std::vector<size_t>& getOffsets() const;
+
+	void clear();
+
+	// Filling as a sink: each thread appends its finished trajectories to an arena of its own, and end() lays
+	// them out back to back in trajectory order once all their lengths are known
+	void begin(size_t nTrajectories, unsigned int nThreads) override;
+	void write(unsigned int thread, size_t trajectory, const Trajectory &metadata, const glm::vec3 *points, size_t nPoints) override;
+	void end() override;
+
+private:
+	// A thread's trajectories in the order they finished, each starting at first in points
+	struct Arena {
+		std::vector<glm::vec3> points;
+		std::vector<std::pair<size_t, size_t>> pieces; // trajectory, first
+	};
+
+private:
+	std::vector<glm::vec3> m_vPoints;
+	std::vector<size_t> m_vOffsets;
+	std::vector<Trajectory> m_vTrajectories;
+	std::vector<Arena> m_vArenas; // kept across fills
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+// Receives advected particle paths as they finish, from every worker thread of
+// VectorFieldGenerator::getAdvectedParticles at once, so a consumer can keep them (TrajectorySet) or stream them
+// out (TrajectoryWriter) without the whole set ever being gathered in between
+class TrajectorySink
+{
+public:
+	struct Trajectory {
+		glm::vec3 seed;
+		unsigned int steps; // accepted integration steps: steps + 1 points, the seed first, unless simplified
+		bool exited;        // left the cube (its last point clipped onto the boundary) rather than ran out of time
+	};
+
+public:
+	virtual ~TrajectorySink() {}
+
+	// Before the first trajectory: their number (indices 0 to nTrajectories - 1) and the number of threads that
+	// will write, for per-thread state
+	virtual void begin(size_t nTrajectories, unsigned int nThreads) = 0;
+
+	// One finished trajectory, points in order from the seed. Different threads call concurrently, each with its
+	// own thread index in [0, nThreads), every trajectory exactly once; the points are only valid during the call.
+	virtual void write(unsigned int thread, size_t trajectory, const Trajectory &metadata, const glm::vec3 *points, size_t nPoints) = 0;
+
+	// After the last trajectory, from the thread that called begin()
+	virtual void end() = 0;
+};
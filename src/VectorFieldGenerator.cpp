@@ -4,11 +4,91 @@
 #include <sstream>
 #include <fstream>
 #include <filesystem>
+#include <chrono>
+#include <limits>
+#include <algorithm>
 
 #include "DebugDrawer.h"
 
+namespace
+{
+	// Particles getAdvectedParticles integrates in lockstep: one RBFEvaluator point block, so a multiple of every
+	// SIMD packet width, and as many as one ParticleIntegrator step takes
+	const size_t ADVECTION_PACKET = ParticleIntegrator::MAX_PARTICLES;
+
+	// Seeds per unit of work stealing, fed into a packet as its lanes free up
+	const size_t ADVECTION_CHUNK = 256u;
+
+	// Coordinate in [-1, 1) from the splitmix64 hash of the base seed plus a counter: every particle's seed point
+	// is a pure function of its index, however the particles are spread over threads
+	float seedCoordinate(unsigned long long baseSeed, unsigned long long counter)
+	{
+		unsigned long long z = baseSeed + (counter + 1ull) * 0x9E3779B97F4A7C15ull;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		z ^= z >> 31;
+
+		// top 24 bits, exactly representable in a float
+		return static_cast<float>(z >> 40) * (2.f / 16777216.f) - 1.f;
+	}
+
+	// A GridSampler seen through one particle's cursor, so checkSphereAdvection keeps the stencil of its cell
+	// across steps and stages; unlike other FieldEvaluators it must not be shared between threads
+	class CursorSampler : public FieldEvaluator
+	{
+	public:
+		explicit CursorSampler(const GridSampler &sampler)
+			: m_Sampler(sampler)
+		{
+		}
+
+		void evaluate(const float *xyz, size_t n, float *out) const override
+		{
+			for (size_t i = 0u; i < n; ++i)
+			{
+				glm::vec3 v = m_Sampler.sample(glm::vec3(xyz[3u * i], xyz[3u * i + 1u], xyz[3u * i + 2u]), m_Cursor);
+				out[3u * i] = v.x;
+				out[3u * i + 1u] = v.y;
+				out[3u * i + 2u] = v.z;
+			}
+		}
+
+		const char* getName() const override
+		{
+			return m_Sampler.getName();
+		}
+
+	private:
+		const GridSampler &m_Sampler;
+		mutable GridSampler::Cursor m_Cursor;
+	};
+}
+
 VectorFieldGenerator::VectorFieldGenerator()
+	: m_uiGridResolution(0u)
+	, m_bGridCurrent(false)
+	, m_eGridEvaluation(GRID_SEPARABLE)
+	, m_fGaussianShape(1.2f)
+	, m_fShapeParameter(1.2f)
+	, m_bShapeSelection(false)
+	, m_fShapeMin(0.1f)
+	, m_fShapeMax(100.f)
+	, m_uiShapeCandidates(16u)
+	, m_eBasisFunction(BASIS_GAUSSIAN)
+	, m_fSupportRadius(1.f)
+	, m_eEvaluationEngine(EVAL_DIRECT)
+	, m_fFGTTolerance(1e-4f)
+	, m_bPartitionOfUnity(false)
+	, m_uiPatchesPerAxis(0u)
+	, m_fPatchOverlap(1.5f)
+	, m_bMultilevel(false)
+	, m_uiLevels(0u)
+	, m_pEvaluator(&m_RBFEvaluator)
+	, m_eAdvectionField(ADVECT_EXACT)
+	, m_pThreadPool(new ThreadPool(1u))
 {
+	m_GridSampler.setGrid(&m_Grid);
+
 	m_RNG.seed(std::random_device()());
 
 	m_Distribuion = std::uniform_real_distribution<float>(-1.f, 1.f);
@@ -20,15 +100,275 @@ VectorFieldGenerator::~VectorFieldGenerator()
 
 void VectorFieldGenerator::init(unsigned int nControlPoints, unsigned int gridResolution)
 {	
-	m_v3DGridPairs.clear();
+	fit(nControlPoints, gridResolution);
+
+	buildGrid();
+}
 
+void VectorFieldGenerator::init(const std::vector<glm::vec3> &positions, const std::vector<glm::vec3> &directions, unsigned int gridResolution)
+{
+	fit(positions, directions, gridResolution);
+
+	buildGrid();
+}
+
+void VectorFieldGenerator::fit(unsigned int nControlPoints, unsigned int gridResolution)
+{
 	m_uiGridResolution = gridResolution;
 
-	m_fGaussianShape = 1.2f;
+	m_fGaussianShape = m_fShapeParameter;
 
 	createControlPoints(nControlPoints);
+}
+
+void VectorFieldGenerator::fit(const std::vector<glm::vec3> &positions, const std::vector<glm::vec3> &directions, unsigned int gridResolution)
+{
+	m_uiGridResolution = gridResolution;
+
+	m_fGaussianShape = m_fShapeParameter;
+
+	m_vControlPoints.resize(positions.size());
+	for (size_t i = 0u; i < positions.size(); ++i)
+	{
+		m_vControlPoints[i].pos = positions[i];
+		m_vControlPoints[i].dir = directions[i];
+	}
+
+	fitControlPoints();
+}
+
+void VectorFieldGenerator::buildGrid()
+{
+	if (m_bGridCurrent || m_uiGridResolution < 2u)
+		return;
+
+	makeGrid(m_uiGridResolution, m_fGaussianShape);
+
+	m_bGridCurrent = true;
+}
+
+bool VectorFieldGenerator::isGridCurrent() const
+{
+	return m_bGridCurrent;
+}
+
+void VectorFieldGenerator::setSeed(unsigned int seed)
+{
+	m_RNG.seed(seed);
+}
+
+void VectorFieldGenerator::setThreadCount(unsigned int nThreads)
+{
+	m_pThreadPool.reset(new ThreadPool(nThreads));
+}
 
-	makeGrid(m_uiGridResolution, m_fGaussianShape);	
+unsigned int VectorFieldGenerator::getThreadCount() const
+{
+	return m_pThreadPool->getThreadCount();
+}
+
+void VectorFieldGenerator::setGridEvaluation(GridEvaluation mode)
+{
+	m_eGridEvaluation = mode;
+}
+
+VectorFieldGenerator::GridEvaluation VectorFieldGenerator::getGridEvaluation() const
+{
+	return m_eGridEvaluation;
+}
+
+void VectorFieldGenerator::setEvaluationEngine(EvaluationEngine engine)
+{
+	m_eEvaluationEngine = engine;
+
+	if (!m_vControlPoints.empty())
+		updateEvaluator();
+}
+
+VectorFieldGenerator::EvaluationEngine VectorFieldGenerator::getEvaluationEngine() const
+{
+	return m_eEvaluationEngine;
+}
+
+void VectorFieldGenerator::setFGTTolerance(float tolerance)
+{
+	m_fFGTTolerance = tolerance;
+
+	if (!m_vControlPoints.empty() && m_eEvaluationEngine == EVAL_FGT)
+		updateEvaluator();
+}
+
+void VectorFieldGenerator::setPartitionOfUnity(bool enable, unsigned int patchesPerAxis, float overlap)
+{
+	m_bPartitionOfUnity = enable;
+	m_uiPatchesPerAxis = patchesPerAxis;
+	m_fPatchOverlap = overlap;
+}
+
+const PartitionOfUnityEvaluator::Report& VectorFieldGenerator::getPartitionOfUnityReport() const
+{
+	return m_PUEvaluator.getReport();
+}
+
+void VectorFieldGenerator::setMultilevel(bool enable, unsigned int levels)
+{
+	m_bMultilevel = enable;
+	m_uiLevels = levels;
+}
+
+const std::vector<MultilevelEvaluator::Level>& VectorFieldGenerator::getMultilevelLevels() const
+{
+	return m_MultilevelEvaluator.getLevels();
+}
+
+double VectorFieldGenerator::getMultilevelSeconds() const
+{
+	return m_MultilevelEvaluator.getSeconds();
+}
+
+bool VectorFieldGenerator::setKernelField(const std::string &basis, const std::string &scalar)
+{
+	if (basis.empty())
+	{
+		m_pKernelField.reset();
+		return true;
+	}
+
+	std::unique_ptr<KernelField> field = KernelField::create(basis, scalar);
+	if (!field)
+		return false;
+
+	m_pKernelField = std::move(field);
+
+	return true;
+}
+
+const KernelField* VectorFieldGenerator::getKernelField() const
+{
+	return m_pKernelField.get();
+}
+
+void VectorFieldGenerator::setAdvectionField(AdvectionField field)
+{
+	m_eAdvectionField = field;
+
+	if (field != ADVECT_EXACT)
+		m_GridSampler.setInterpolation(field == ADVECT_TRICUBIC ? GridSampler::INTERPOLATION_TRICUBIC : GridSampler::INTERPOLATION_TRILINEAR);
+}
+
+VectorFieldGenerator::AdvectionField VectorFieldGenerator::getAdvectionField() const
+{
+	return m_eAdvectionField;
+}
+
+GridSampler::ErrorReport VectorFieldGenerator::measureSamplingError(GridSampler::Interpolation interpolation, size_t nSamples)
+{
+	buildGrid();
+
+	GridSampler sampler;
+	sampler.setGrid(&m_Grid);
+	sampler.setInterpolation(interpolation);
+
+	return sampler.measureError(*m_pEvaluator, nSamples);
+}
+
+const FieldEvaluator& VectorFieldGenerator::getAdvectionEvaluator() const
+{
+	if (m_eAdvectionField == ADVECT_EXACT)
+		return *m_pEvaluator;
+
+	return m_GridSampler;
+}
+
+void VectorFieldGenerator::updateControlPoints(const std::vector<unsigned int> &indices, const std::vector<glm::vec3> &directions)
+{
+	for (size_t n = 0u; n < indices.size(); ++n)
+		m_vControlPoints[indices[n]].dir = directions[n];
+
+	if (usePartitionOfUnity() && m_vFitPositions.size() == m_vControlPoints.size())
+	{
+		m_PUEvaluator.refit(indices, directions, *m_pThreadPool);
+
+		for (size_t n = 0u; n < indices.size(); ++n)
+		{
+			m_vCPXVals(indices[n]) = directions[n].x;
+			m_vCPYVals(indices[n]) = directions[n].y;
+			m_vCPZVals(indices[n]) = directions[n].z;
+		}
+	}
+	else
+		fitControlPoints();
+
+	m_bGridCurrent = false;
+	buildGrid();
+}
+
+bool VectorFieldGenerator::usePartitionOfUnity() const
+{
+	return m_bPartitionOfUnity && m_eBasisFunction == BASIS_GAUSSIAN && !m_bMultilevel && !m_pKernelField;
+}
+
+bool VectorFieldGenerator::useMultilevel() const
+{
+	return m_bMultilevel && !m_pKernelField;
+}
+
+void VectorFieldGenerator::setGaussianShape(float eta)
+{
+	m_fShapeParameter = eta;
+}
+
+float VectorFieldGenerator::getGaussianShape() const
+{
+	return m_fGaussianShape;
+}
+
+void VectorFieldGenerator::setShapeSelection(bool automatic, float etaMin, float etaMax, unsigned int candidates)
+{
+	m_bShapeSelection = automatic;
+	m_fShapeMin = etaMin;
+	m_fShapeMax = etaMax;
+	m_uiShapeCandidates = std::max(candidates, 1u);
+}
+
+const std::vector<VectorFieldGenerator::ShapeCandidate>& VectorFieldGenerator::getShapeCandidates() const
+{
+	return m_vShapeCandidates;
+}
+
+void VectorFieldGenerator::setBasisFunction(BasisFunction basis, float supportRadius)
+{
+	m_eBasisFunction = basis;
+	m_fSupportRadius = supportRadius;
+}
+
+VectorFieldGenerator::BasisFunction VectorFieldGenerator::getBasisFunction() const
+{
+	return m_eBasisFunction;
+}
+
+void VectorFieldGenerator::setSolverMethod(RBFSolver::Method method)
+{
+	m_Solver.setMethod(method);
+}
+
+void VectorFieldGenerator::setRegularization(float mu)
+{
+	m_Solver.setRegularization(mu);
+}
+
+void VectorFieldGenerator::setSolverTolerance(float tolerance, unsigned int maxIterations)
+{
+	m_Solver.setTolerance(tolerance);
+	m_Solver.setMaxIterations(maxIterations);
+}
+
+const RBFSolver::Report& VectorFieldGenerator::getSolverReport() const
+{
+	if (useFixedKernel() && m_pFixedEvaluator)
+		return m_pFixedEvaluator->getReport();
+
+	return m_Solver.getReport();
 }
 
 void VectorFieldGenerator::createControlPoints(unsigned int nControlPoints)
@@ -36,11 +376,6 @@ void VectorFieldGenerator::createControlPoints(unsigned int nControlPoints)
 	if (m_vControlPoints.size() > 0u)	
 		m_vControlPoints.clear();
 
-	m_matControlPointKernel = Eigen::MatrixXf(nControlPoints, nControlPoints);
-	m_vCPXVals = Eigen::VectorXf(nControlPoints);
-	m_vCPYVals = Eigen::VectorXf(nControlPoints);
-	m_vCPZVals = Eigen::VectorXf(nControlPoints);
-
 	for (unsigned int i = 0u; i < nControlPoints; ++i)
 	{
 		// Create control point
@@ -49,172 +384,618 @@ void VectorFieldGenerator::createControlPoints(unsigned int nControlPoints)
 		cp.dir = glm::vec3(m_Distribuion(m_RNG), m_Distribuion(m_RNG), m_Distribuion(m_RNG));
 
 		m_vControlPoints.push_back(cp);
-		
+	}
+
+	fitControlPoints();
+}
+
+void VectorFieldGenerator::fitControlPoints()
+{
+	m_bGridCurrent = false;
+
+	if (useFixedKernel())
+	{
+		fitFixedControlPoints();
+		return;
+	}
+
+	// a fixed-size fit from before would be stale if the engine is switched back to it
+	m_pFixedEvaluator.reset();
+
+	unsigned int nControlPoints = static_cast<unsigned int>(m_vControlPoints.size());
+
+	// the fit buffers are members, so refitting the same number of points allocates nothing here
+	m_vCPXVals.resize(nControlPoints);
+	m_vCPYVals.resize(nControlPoints);
+	m_vCPZVals.resize(nControlPoints);
+
+	std::vector<glm::vec3> &positions = m_vPositionScratch;
+	positions.resize(nControlPoints);
+
+	for (unsigned int i = 0u; i < nControlPoints; ++i)
+	{
+		positions[i] = m_vControlPoints[i].pos;
+
 		// store each vector component of the control point value
 		m_vCPXVals(i) = m_vControlPoints[i].dir.x;
 		m_vCPYVals(i) = m_vControlPoints[i].dir.y;
 		m_vCPZVals(i) = m_vControlPoints[i].dir.z;
+	}
+
+	// solve for lambda coefficients in each (linearly independent) dimension
+	//     -the lambda coefficients are the interpolation weights for each control(/interpolation data) point
+	//     -all three components are solved together as an N x 3 right-hand side
+	Eigen::MatrixXf &rhs = m_matFitValues;
+	rhs.resize(nControlPoints, 3);
+	rhs << m_vCPXVals, m_vCPYVals, m_vCPZVals;
+
+	// a shape chosen for other data does not carry over, so selection reruns at every fit
+	if (m_bShapeSelection && m_eBasisFunction == BASIS_GAUSSIAN && !m_pKernelField && nControlPoints > 1u)
+		m_fGaussianShape = selectGaussianShape(positions, rhs);
+
+	Eigen::MatrixXf &lambdas = m_matFitWeights;
+	bool solved;
+
+	// at most one kernel representation is kept; the dense one keeps its storage when it is refilled
+	bool denseKernel = !m_pKernelField && !useMultilevel() && !usePartitionOfUnity() && m_eBasisFunction == BASIS_GAUSSIAN && m_Solver.getMethod() != RBFSolver::METHOD_CG;
+	if (!denseKernel)
+		m_matControlPointKernel.resize(0, 0);
+	m_matSparseKernel.resize(0, 0);
 
-		// fill in the distance matrix kernel entries for this control point
-		m_matControlPointKernel(i, i) = 1.f;
-		for (int j = static_cast<int>(i) - 1; j >= 0; --j)
+	if (m_pKernelField)
+	{
+		solved = m_pKernelField->fit(positions, rhs, m_fGaussianShape, m_Solver.getRegularization());
+
+		if (!solved)
+			std::cout << "Warning: " << m_pKernelField->getBasisName() << " kernel solve failed in " << m_pKernelField->getScalarName() << " precision" << std::endl;
+
+		// the weights live in the kernel field, in its own scalar type
+		solved = true;
+
+		lambdas.setZero(nControlPoints, 3);
+	}
+	else if (useMultilevel())
+	{
+		// the fine levels take the Wendland basis if one is selected; their support radii follow the point spacing
+		CompactRBFEvaluator::Basis basis = m_eBasisFunction == BASIS_WENDLAND_C4 ? CompactRBFEvaluator::WENDLAND_C4 : CompactRBFEvaluator::WENDLAND_C2;
+
+		m_MultilevelEvaluator.fit(positions, rhs, m_fGaussianShape, m_Solver.getRegularization(), basis, m_uiLevels, m_Solver.getTolerance(), *m_pThreadPool);
+
+		// the levels have weights of their own
+		solved = true;
+
+		lambdas.setZero(nControlPoints, 3);
+	}
+	else if (usePartitionOfUnity())
+	{
+		// the fit lives in the patches; there are no global weights
+		m_PUEvaluator.fit(positions, rhs, m_fGaussianShape, m_Solver.getRegularization(), glm::vec3(-1.f), glm::vec3(1.f), m_uiPatchesPerAxis, m_fPatchOverlap, *m_pThreadPool);
+
+		const PartitionOfUnityEvaluator::Report &report = m_PUEvaluator.getReport();
+		if (report.failedSolves > 0u)
+			std::cout << "Warning: " << report.failedSolves << " of " << report.patches << " partition of unity patch solves failed" << std::endl;
+
+		solved = true;
+
+		lambdas.setZero(nControlPoints, 3);
+	}
+	else if (m_eBasisFunction != BASIS_GAUSSIAN)
+	{
+		CompactRBFEvaluator::Basis basis = m_eBasisFunction == BASIS_WENDLAND_C4 ? CompactRBFEvaluator::WENDLAND_C4 : CompactRBFEvaluator::WENDLAND_C2;
+
+		// only pairs within the support radius have nonzero entries
+		CompactRBFEvaluator::assembleKernel(positions, basis, m_fSupportRadius, m_matSparseKernel);
+
+		// CG warm starts from an N x 3 solution, which only helps when refitting new values at the same positions;
+		// the weights of another layout are no better a guess than zero
+		if (positions == m_vFitPositions && m_vLambdaX.size() == nControlPoints)
 		{
-			float r = glm::length(m_vControlPoints[i].pos - m_vControlPoints[j].pos);
-			float gaussian = gaussianBasis(r, m_fGaussianShape);
-			m_matControlPointKernel(i, j) = m_matControlPointKernel(j, i) = gaussian;
+			lambdas.resize(nControlPoints, 3);
+			lambdas << m_vLambdaX, m_vLambdaY, m_vLambdaZ;
 		}
+		else
+			lambdas.setZero(nControlPoints, 3);
+
+		solved = m_Solver.solveSparse(m_matSparseKernel, rhs, lambdas);
 	}
+	else if (m_Solver.getMethod() == RBFSolver::METHOD_CG)
+	{
+		// the kernel is applied on the fly, so no N x N matrix is ever formed;
+		// refitting new values at the same positions starts from the previous weights
+		if (positions == m_vFitPositions && m_vLambdaX.size() == nControlPoints)
+		{
+			lambdas.resize(nControlPoints, 3);
+			lambdas << m_vLambdaX, m_vLambdaY, m_vLambdaZ;
+		}
+		else
+			lambdas.resize(0, 0);
 
-	// solve for lambda coefficients in each (linearly independent) dimension using LU decomposition of distance matrix
-	//     -the lambda coefficients are the interpolation weights for each control(/interpolation data) point
-	m_vLambdaX = m_matControlPointKernel.fullPivLu().solve(m_vCPXVals);
-	m_vLambdaY = m_matControlPointKernel.fullPivLu().solve(m_vCPYVals);
-	m_vLambdaZ = m_matControlPointKernel.fullPivLu().solve(m_vCPZVals);
+		solved = m_Solver.solveMatrixFree(positions, m_fGaussianShape, rhs, lambdas, *m_pThreadPool);
+	}
+	else
+	{
+		m_matControlPointKernel.resize(nControlPoints, nControlPoints);
+
+		// fill in the distance matrix kernel entries for each control point
+		for (unsigned int i = 0u; i < nControlPoints; ++i)
+		{
+			m_matControlPointKernel(i, i) = 1.f;
+			for (int j = static_cast<int>(i) - 1; j >= 0; --j)
+			{
+				float r = glm::length(positions[i] - positions[j]);
+				float gaussian = gaussianBasis(r, m_fGaussianShape);
+				m_matControlPointKernel(i, j) = m_matControlPointKernel(j, i) = gaussian;
+			}
+		}
+
+		// the kernel is factorized once for all three components
+		solved = m_Solver.solve(m_matControlPointKernel, rhs, lambdas);
+	}
+
+	if (!solved)
+		std::cout << "Warning: " << RBFSolver::getMethodName(m_Solver.getReport().method) << " kernel solve failed for " << nControlPoints << " control points" << std::endl;
+
+	// a failed solve leaves no solution or a non-finite one; fall back to a zero field rather than let NaN weights
+	// into the evaluators and the grid
+	if (!solved || lambdas.rows() != nControlPoints || lambdas.cols() != 3)
+		lambdas.setZero(nControlPoints, 3);
+
+	m_vLambdaX = lambdas.col(0);
+	m_vLambdaY = lambdas.col(1);
+	m_vLambdaZ = lambdas.col(2);
+
+	m_vFitPositions.swap(positions);
+
+	updateEvaluator();
 }
 
-void VectorFieldGenerator::makeGrid(unsigned int resolution, float gaussianShape)
+void VectorFieldGenerator::fitFixedControlPoints()
+{
+	unsigned int nControlPoints = static_cast<unsigned int>(m_vControlPoints.size());
+
+	// an instantiation is only created when the count moves to another size class, so regenerating a field
+	// of the same size (as the sphere advection retry loop does) reuses it
+	if (!m_pFixedEvaluator || m_pFixedEvaluator->getCapacity() != FixedRBFEvaluatorBase::getCapacityFor(nControlPoints))
+		m_pFixedEvaluator = FixedRBFEvaluatorBase::create(nControlPoints);
+
+	glm::vec3 positions[FixedRBFEvaluatorBase::MAX_CONTROL_POINTS];
+	glm::vec3 values[FixedRBFEvaluatorBase::MAX_CONTROL_POINTS];
+	for (unsigned int i = 0u; i < nControlPoints; ++i)
+	{
+		positions[i] = m_vControlPoints[i].pos;
+		values[i] = m_vControlPoints[i].dir;
+	}
+
+	if (!m_pFixedEvaluator->fit(positions, values, nControlPoints, m_fGaussianShape, m_Solver.getRegularization()))
+		std::cout << "Warning: " << RBFSolver::getMethodName(m_pFixedEvaluator->getReport().method) << " kernel solve failed for " << nControlPoints << " control points" << std::endl;
+
+	// the copies below keep metadata export and the other engines working; resizing to the same count does
+	// not reallocate
+	m_vCPXVals.resize(nControlPoints);
+	m_vCPYVals.resize(nControlPoints);
+	m_vCPZVals.resize(nControlPoints);
+	m_vLambdaX.resize(nControlPoints);
+	m_vLambdaY.resize(nControlPoints);
+	m_vLambdaZ.resize(nControlPoints);
+	m_vFitPositions.resize(nControlPoints);
+
+	for (unsigned int i = 0u; i < nControlPoints; ++i)
+	{
+		glm::vec3 lambda = m_pFixedEvaluator->getWeight(i);
+
+		m_vCPXVals(i) = values[i].x;
+		m_vCPYVals(i) = values[i].y;
+		m_vCPZVals(i) = values[i].z;
+		m_vLambdaX(i) = lambda.x;
+		m_vLambdaY(i) = lambda.y;
+		m_vLambdaZ(i) = lambda.z;
+		m_vFitPositions[i] = positions[i];
+	}
+
+	m_matControlPointKernel.resize(0, 0);
+	m_matSparseKernel.resize(0, 0);
+
+	updateEvaluator();
+}
+
+bool VectorFieldGenerator::useFixedKernel() const
+{
+	// only the plain global Gaussian fit with the direct engine has a fixed-size counterpart, and it is taken only
+	// where it measured faster; its solve runs the default LLT -> LDLT -> LU chain, so another solver set
+	// explicitly keeps the general path
+	return FixedRBFEvaluatorBase::isFasterFor(static_cast<unsigned int>(m_vControlPoints.size()))
+		&& m_eBasisFunction == BASIS_GAUSSIAN && m_eEvaluationEngine == EVAL_DIRECT && m_Solver.getMethod() == RBFSolver::METHOD_LLT
+		&& !m_bShapeSelection && !m_pKernelField && !useMultilevel() && !usePartitionOfUnity();
+}
+
+float VectorFieldGenerator::selectGaussianShape(const std::vector<glm::vec3> &positions, const Eigen::MatrixXf &values)
+{
+	// each candidate needs a dense N x N factorization, so large fits are cross-validated on a subset
+	std::vector<unsigned int> subset(positions.size());
+	for (unsigned int i = 0u; i < subset.size(); ++i)
+		subset[i] = i;
+
+	if (subset.size() > SHAPE_SELECTION_MAX_POINTS)
+	{
+		std::shuffle(subset.begin(), subset.end(), std::mt19937(0u));
+		subset.resize(SHAPE_SELECTION_MAX_POINTS);
+	}
+
+	Eigen::Index n = static_cast<Eigen::Index>(subset.size());
+	Eigen::MatrixXf rhs(n, 3);
+	for (Eigen::Index i = 0; i < n; ++i)
+		rhs.row(i) = values.row(subset[i]);
+
+	m_vShapeCandidates.resize(m_uiShapeCandidates);
+
+	float regularization = m_Solver.getRegularization();
+
+	// candidates are independent solves, so they spread across the thread pool like grid slices do
+	m_pThreadPool->parallelFor(0u, m_uiShapeCandidates, [&](size_t c) {
+		auto start = std::chrono::high_resolution_clock::now();
+
+		ShapeCandidate &candidate = m_vShapeCandidates[c];
+
+		float t = m_uiShapeCandidates > 1u ? static_cast<float>(c) / (m_uiShapeCandidates - 1u) : 0.f;
+		candidate.eta = m_fShapeMin * std::pow(m_fShapeMax / m_fShapeMin, t);
+
+		Eigen::MatrixXf kernel(n, n);
+		for (Eigen::Index i = 0; i < n; ++i)
+		{
+			kernel(i, i) = 1.f;
+			for (Eigen::Index j = 0; j < i; ++j)
+				kernel(i, j) = kernel(j, i) = gaussianBasis(glm::length(positions[subset[i]] - positions[subset[j]]), candidate.eta);
+		}
+
+		RBFSolver solver;
+		solver.setRegularization(regularization);
+
+		Eigen::MatrixXf errors;
+		if (solver.leaveOneOut(kernel, rhs, errors))
+			candidate.error = std::sqrt(errors.squaredNorm() / static_cast<float>(errors.size()));
+		else
+			candidate.error = std::numeric_limits<float>::infinity();
+
+		candidate.method = solver.getReport().method;
+		candidate.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	});
+
+	float bestEta = m_fGaussianShape;
+	float bestError = std::numeric_limits<float>::infinity();
+	for (auto const &candidate : m_vShapeCandidates)
+	{
+		if (candidate.error < bestError)
+		{
+			bestError = candidate.error;
+			bestEta = candidate.eta;
+		}
+	}
+
+	if (bestError == std::numeric_limits<float>::infinity())
+		std::cout << "Warning: no shape candidate could be cross-validated; keeping eta = " << bestEta << std::endl;
+
+	return bestEta;
+}
+
+void VectorFieldGenerator::updateEvaluator()
 {
-	m_v3DGridPairs.clear();
+	const std::vector<glm::vec3> &positions = m_vFitPositions;
+
+	if (m_pKernelField)
+	{
+		m_pEvaluator = m_pKernelField.get();
+		return;
+	}
+
+	if (useFixedKernel() && m_pFixedEvaluator)
+	{
+		m_pEvaluator = m_pFixedEvaluator.get();
+		return;
+	}
 
+	if (useMultilevel())
+	{
+		m_pEvaluator = &m_MultilevelEvaluator;
+		return;
+	}
+
+	if (usePartitionOfUnity())
+	{
+		m_pEvaluator = &m_PUEvaluator;
+		return;
+	}
+
+	if (m_eBasisFunction != BASIS_GAUSSIAN)
+	{
+		CompactRBFEvaluator::Basis basis = m_eBasisFunction == BASIS_WENDLAND_C4 ? CompactRBFEvaluator::WENDLAND_C4 : CompactRBFEvaluator::WENDLAND_C2;
+
+		// the Gaussian engines do not apply to a compact basis
+		m_CompactEvaluator.setControlPoints(positions, m_vLambdaX, m_vLambdaY, m_vLambdaZ, basis, m_fSupportRadius);
+		m_pEvaluator = &m_CompactEvaluator;
+
+		return;
+	}
+
+	// the direct evaluator is cheap to set up and always kept current
+	m_RBFEvaluator.setControlPoints(positions, m_vLambdaX, m_vLambdaY, m_vLambdaZ, m_fGaussianShape);
+	m_pEvaluator = &m_RBFEvaluator;
+
+	if (m_eEvaluationEngine == EVAL_GEMM)
+	{
+		m_GEMMEvaluator.setControlPoints(positions, m_vLambdaX, m_vLambdaY, m_vLambdaZ, m_fGaussianShape);
+		m_pEvaluator = &m_GEMMEvaluator;
+	}
+
+	if (m_eEvaluationEngine == EVAL_FGT)
+	{
+		m_FGTEvaluator.setControlPoints(positions, m_vLambdaX, m_vLambdaY, m_vLambdaZ, m_fGaussianShape, m_fFGTTolerance);
+		m_pEvaluator = &m_FGTEvaluator;
+	}
+}
+
+void VectorFieldGenerator::makeGrid(unsigned int resolution, float gaussianShape)
+{
 	// grid cell size when discretizing [-1, 1] cube
 	float cellSize = (2.f / static_cast<float>(m_uiGridResolution - 1));
 
+	// node positions are implicit in the grid, so only the flow vectors are stored
+	m_Grid.resize(m_uiGridResolution, glm::vec3(-1.f), cellSize);
+
+	// the separable factorization is a property of the global Gaussian sum
+	if (m_eGridEvaluation == GRID_SEPARABLE && m_eBasisFunction == BASIS_GAUSSIAN && !usePartitionOfUnity() && !useMultilevel() && !m_pKernelField)
+		makeGridSeparable();
+	else
+		makeGridDirect();
+}
+
+void VectorFieldGenerator::makeGridDirect()
+{
+	float cellSize = m_Grid.getSpacing();
+
+	float *u = m_Grid.getU();
+	float *v = m_Grid.getV();
+	float *w = m_Grid.getW();
+
 	// create a regular 3D grid at the given resolution and interpolate the field at its nodes
-	for (unsigned int i = 0; i < m_uiGridResolution; ++i)
-	{
-		std::vector<std::vector<std::pair<glm::vec3, glm::vec3>>> frame;
+	//     -z-slices are independent, so they are spread across the thread pool; each node is
+	//      computed by the same kernel either way, so the result does not depend on thread count
+	m_pThreadPool->parallelFor(0u, m_uiGridResolution, [&](size_t i) {
+		std::vector<glm::vec3> slicePoints(m_uiGridResolution * m_uiGridResolution);
+		std::vector<glm::vec3> sliceFlow(slicePoints.size());
+
 		for (unsigned int j = 0; j < m_uiGridResolution; ++j)
 		{
-			std::vector<std::pair<glm::vec3, glm::vec3>> row;
 			for (unsigned int k = 0; k < m_uiGridResolution; ++k)
 			{
 				// calculate grid point position
-				glm::vec3 point;
+				glm::vec3 &point = slicePoints[j * m_uiGridResolution + k];
 				point.x = -1.f + k * cellSize;
 				point.y = -1.f + j * cellSize;
 				point.z = -1.f + i * cellSize;
+			}
+		}
 
-				glm::vec3 flowHere = interpolate(point);
+		evaluate(&slicePoints[0].x, slicePoints.size(), &sliceFlow[0].x);
 
-				row.push_back(std::pair<glm::vec3, glm::vec3>(point, flowHere));
-			}
-			frame.push_back(row);
+		// a z-slice is one contiguous run of each component array
+		size_t sliceStart = i * m_Grid.getStrideZ();
+		for (size_t n = 0u; n < sliceFlow.size(); ++n)
+		{
+			u[sliceStart + n] = sliceFlow[n].x;
+			v[sliceStart + n] = sliceFlow[n].y;
+			w[sliceStart + n] = sliceFlow[n].z;
 		}
-		m_v3DGridPairs.push_back(frame);
-	}
+	});
 }
 
-glm::vec3 VectorFieldGenerator::interpolate(glm::vec3 pt)
+void VectorFieldGenerator::makeGridSeparable()
 {
-	// find interpolated 3D vector by summing influence from each CP via radial basis function (RBF)
-	glm::vec3 outVec(0.f);
-	for (int m = 0; m < m_vControlPoints.size(); ++m)
+	// exp(-eta * r^2) = exp(-eta * dx^2) * exp(-eta * dy^2) * exp(-eta * dz^2), and on the lattice dx, dy and dz
+	// only take R distinct values per CP, so tabulate the 1D factors once and fill the grid with multiply-adds
+	unsigned int res = m_uiGridResolution;
+	unsigned int nCPs = static_cast<unsigned int>(m_vControlPoints.size());
+	float cellSize = m_Grid.getSpacing();
+
+	// the tables and the slice coefficients live in member buffers, so regenerating a field of the same size
+	// allocates nothing
+	size_t tableSize = static_cast<size_t>(nCPs) * res;
+	m_vGridFactors.resize(3u * tableSize);
+	float *factorX = m_vGridFactors.data();
+	float *factorY = factorX + tableSize;
+	float *factorZ = factorY + tableSize;
+
+	for (unsigned int m = 0u; m < nCPs; ++m)
 	{
-		float r = glm::length(pt - m_vControlPoints[m].pos);
-		float gaussian = gaussianBasis(r, m_fGaussianShape);
-
-		// interpolate each separate (linearly independent) component of our 3D vector to get CP influence
-		float interpX = m_vLambdaX[m] * gaussian;
-		float interpY = m_vLambdaY[m] * gaussian;
-		float interpZ = m_vLambdaZ[m] * gaussian;
+		for (unsigned int n = 0u; n < res; ++n)
+		{
+			float coord = -1.f + n * cellSize;
+			glm::vec3 d = glm::vec3(coord) - m_vControlPoints[m].pos;
 
-		// add CP influence to resultant vector
-		outVec += glm::vec3(interpX, interpY, interpZ);
+			factorX[m * res + n] = std::exp(-m_fGaussianShape * d.x * d.x);
+			factorY[m * res + n] = std::exp(-m_fGaussianShape * d.y * d.y);
+			factorZ[m * res + n] = std::exp(-m_fGaussianShape * d.z * d.z);
+		}
 	}
 
-	return outVec;
-}
+	// one contiguous block of slices per thread, each with its own coefficient scratch
+	unsigned int nBlocks = std::min(m_pThreadPool->getThreadCount(), res);
+	m_vGridCoefficients.resize(static_cast<size_t>(nBlocks) * 3u * tableSize);
 
-std::vector<std::vector<glm::vec3>> VectorFieldGenerator::getAdvectedParticles(int numParticles, float dt, float totalTime)
-{
-	std::vector<std::vector<glm::vec3>> ret;
-	std::vector<glm::vec3> seedPoints;
+	// within z-slice i, U(j, k) = sum over CPs m of [lambdaX(m) * fz(m, i) * fy(m, j)] * fx(m, k), so each slice
+	// component is an (R x N) * (N x R) matrix product written straight into the grid's contiguous slice
+	//     -the closure only holds this, which keeps it in std::function's small buffer
+	m_pThreadPool->parallelFor(0u, nBlocks, [this](size_t block) {
+		typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowMajorMatrixXf;
 
-	for (int i = 0; i < numParticles; ++i)
-		seedPoints.push_back(glm::vec3(m_Distribuion(m_RNG), m_Distribuion(m_RNG), m_Distribuion(m_RNG)));
-	
-	for (auto &pt : seedPoints)
-	{
-		std::vector<glm::vec3> particlePath;
-		particlePath.push_back(pt);
+		unsigned int res = m_uiGridResolution;
+		unsigned int nCPs = static_cast<unsigned int>(m_vControlPoints.size());
+		size_t tableSize = static_cast<size_t>(nCPs) * res;
+		unsigned int nBlocks = static_cast<unsigned int>(m_vGridCoefficients.size() / (3u * tableSize));
 
-		for (float i = 0.f; i < totalTime; i += dt)
-		{
-			// advect point by one timestep to get new point
-			glm::vec3 newPt = pt + dt * interpolate(pt);
+		const float *factorX = m_vGridFactors.data();
+		const float *factorY = factorX + tableSize;
+		const float *factorZ = factorY + tableSize;
 
-			if (abs(newPt.x) > 1.f ||
-				abs(newPt.y) > 1.f ||
-				abs(newPt.z) > 1.f)
-			{
-				glm::vec3 clippedPt = newPt;
-				clippedPt.x = fmax(fmin(clippedPt.x, 1.f), -1.f);
-				clippedPt.y = fmax(fmin(clippedPt.y, 1.f), -1.f);
-				clippedPt.z = fmax(fmin(clippedPt.z, 1.f), -1.f);
+		Eigen::Map<const RowMajorMatrixXf> matFactorX(factorX, nCPs, res);
 
-				particlePath.push_back(clippedPt);
-				break;
-			}
+		float *scratch = m_vGridCoefficients.data() + block * 3u * tableSize;
+		Eigen::Map<RowMajorMatrixXf> coeffU(scratch, res, nCPs);
+		Eigen::Map<RowMajorMatrixXf> coeffV(scratch + tableSize, res, nCPs);
+		Eigen::Map<RowMajorMatrixXf> coeffW(scratch + 2u * tableSize, res, nCPs);
 
-			particlePath.push_back(newPt);
+		for (unsigned int i = static_cast<unsigned int>(block * res / nBlocks); i < (block + 1u) * res / nBlocks; ++i)
+		{
+			for (unsigned int j = 0u; j < res; ++j)
+			{
+				for (unsigned int m = 0u; m < nCPs; ++m)
+				{
+					float yz = factorZ[m * res + i] * factorY[m * res + j];
+					coeffU(j, m) = m_vLambdaX[m] * yz;
+					coeffV(j, m) = m_vLambdaY[m] * yz;
+					coeffW(j, m) = m_vLambdaZ[m] * yz;
+				}
+			}
 
-			pt = newPt;
+			size_t sliceStart = i * m_Grid.getStrideZ();
+			Eigen::Map<RowMajorMatrixXf>(m_Grid.getU() + sliceStart, res, res).noalias() = coeffU * matFactorX;
+			Eigen::Map<RowMajorMatrixXf>(m_Grid.getV() + sliceStart, res, res).noalias() = coeffV * matFactorX;
+			Eigen::Map<RowMajorMatrixXf>(m_Grid.getW() + sliceStart, res, res).noalias() = coeffW * matFactorX;
 		}
+	});
+}
 
-		ret.push_back(particlePath);
-	}
+const VectorFieldGrid& VectorFieldGenerator::getGrid()
+{
+	buildGrid();
 
-	return ret;
+	return m_Grid;
 }
 
-// Taken from http://stackoverflow.com/questions/5883169/intersection-between-a-line-and-a-sphere
-glm::vec3 lineSphereIntersection(glm::vec3 linePoint0, glm::vec3 linePoint1, glm::vec3 circleCenter, float circleRadius)
+void VectorFieldGenerator::evaluate(const float *xyz, size_t n, float *out) const
 {
-	// http://www.codeproject.com/Articles/19799/Simple-Ray-Tracing-in-C-Part-II-Triangles-Intersec
+	m_pEvaluator->evaluate(xyz, n, out);
+}
 
-	float cx = circleCenter.x;
-	float cy = circleCenter.y;
-	float cz = circleCenter.z;
+void VectorFieldGenerator::evaluateJacobian(const float *xyz, size_t n, float *out, float *jacobian) const
+{
+	m_pEvaluator->evaluateJacobian(xyz, n, out, jacobian);
+}
 
-	float px = linePoint0.x;
-	float py = linePoint0.y;
-	float pz = linePoint0.z;
+void VectorFieldGenerator::getAdvectedParticles(int numParticles, float dt, float totalTime, TrajectorySink &sink, const ParticleIntegrator &integrator)
+{
+	size_t nParticles = static_cast<size_t>(std::max(numParticles, 0));
+	sink.begin(nParticles, m_pThreadPool->getThreadCount());
 
-	float vx = linePoint1.x - px;
-	float vy = linePoint1.y - py;
-	float vz = linePoint1.z - pz;
+	// one draw from the generator per call; each seed point derives from it and the particle index alone, so the
+	// trajectories do not depend on the thread count or on which thread advects which particle
+	unsigned long long baseSeed = (static_cast<unsigned long long>(m_RNG()) << 32) | m_RNG();
 
-	float A = vx * vx + vy * vy + vz * vz;
-	float B = 2.f * (px * vx + py * vy + pz * vz - vx * cx - vy * cy - vz * cz);
-	float C = px * px - 2.f * px * cx + cx * cx + py * py - 2.f * py * cy + cy * cy +
-		pz * pz - 2.f * pz * cz + cz * cz - circleRadius * circleRadius;
+	// fixed steps: the step count of the original time loop, float accumulation included
+	bool adaptive = integrator.isAdaptive();
+	unsigned int nSteps = 0u;
+	for (float i = 0.f; i < totalTime; i += dt)
+		++nSteps;
 
-	// discriminant
-	float D = B * B - 4.f * A * C;
+	bool noSteps = adaptive ? !(totalTime > 0.f) : nSteps == 0u;
 
-	if (D < 0.f)
-		return glm::vec3(0.f);
+	if (m_eAdvectionField != ADVECT_EXACT)
+		buildGrid();
 
-	float t1 = (-B - sqrtf(D)) / (2.f * A);
+	const FieldEvaluator &advection = getAdvectionEvaluator();
 
-	glm::vec3 solution1(linePoint0.x * (1.f - t1) + t1 * linePoint1.x,
-		linePoint0.y * (1.f - t1) + t1 * linePoint1.y,
-		linePoint0.z * (1.f - t1) + t1 * linePoint1.z);
+	// every lane collects the points of its current particle and hands them to the sink when it finishes, so the
+	// memory held is one path per lane whatever the particle count
+	m_vAdvectionLanes.resize(m_pThreadPool->getThreadCount() * ADVECTION_PACKET);
 
-	if (D == 0.f)
-		return solution1;
+	// trajectories end at the cube boundary after anywhere from one to all time steps, so chunks of seeds are
+	// spread by work stealing rather than split evenly up front
+	m_pThreadPool->parallelForStealing(0u, nParticles, ADVECTION_CHUNK, [&](size_t first, size_t last, unsigned int thread) {
+		std::vector<glm::vec3> *points = &m_vAdvectionLanes[thread * ADVECTION_PACKET];
 
-	float t2 = (-B + sqrtf(D)) / (2.f * A);
-	glm::vec3 solution2(linePoint0.x * (1.f - t2) + t2 * linePoint1.x,
-		linePoint0.y * (1.f - t2) + t2 * linePoint1.y,
-		linePoint0.z * (1.f - t2) + t2 * linePoint1.z);
+		// a packet of particles advances in lockstep, one batched field evaluation per stage; a lane is masked off
+		// when its particle leaves the cube or runs out of time, and refilled from the chunk's pending seeds
+		glm::vec3 position[ADVECTION_PACKET], velocity[ADVECTION_PACKET];
+		float h[ADVECTION_PACKET], stepSize[ADVECTION_PACKET], time[ADVECTION_PACKET];
+		unsigned int particle[ADVECTION_PACKET];
+		size_t nLanes = 0u;
+		size_t nextSeed = first;
 
-	// prefer a solution that's on the line segment itself
+		while (true)
+		{
+			size_t firstNew = nLanes;
 
-	if (abs(t1 - 0.5f) < abs(t2 - 0.5f))
-		return solution1;
+			for (; nLanes < ADVECTION_PACKET && nextSeed < last; ++nextSeed)
+			{
+				glm::vec3 seedPoint(seedCoordinate(baseSeed, 3u * nextSeed), seedCoordinate(baseSeed, 3u * nextSeed + 1u), seedCoordinate(baseSeed, 3u * nextSeed + 2u));
+
+				if (noSteps)
+				{
+					TrajectorySink::Trajectory trajectory = { seedPoint, 0u, false };
+					sink.write(thread, nextSeed, trajectory, &seedPoint, 1u);
+					continue;
+				}
+
+				points[nLanes].assign(1u, seedPoint);
+				position[nLanes] = seedPoint;
+				particle[nLanes] = static_cast<unsigned int>(nextSeed);
+				time[nLanes] = 0.f;
+				h[nLanes] = dt;
+				++nLanes;
+			}
+
+			if (nLanes == 0u)
+				break;
+
+			// new lanes sit at the end; the field at their seeds is the first stage of their first step
+			if (firstNew < nLanes)
+				advection.evaluate(&position[firstNew].x, nLanes - firstNew, &velocity[firstNew].x);
+
+			// an adaptive step is cut short to end on totalTime
+			for (size_t l = 0u; l < nLanes; ++l)
+				stepSize[l] = adaptive ? std::min(h[l], totalTime - time[l]) : dt;
+
+			unsigned long long accepted = integrator.step(advection, nLanes, position, velocity, stepSize, h);
 
-	return solution2;
+			unsigned long long finished = 0u; // lane mask
+			for (size_t l = 0u; l < nLanes; ++l)
+			{
+				if (!(accepted & (1ull << l)))
+					continue;
+
+				bool outside = abs(position[l].x) > 1.f || abs(position[l].y) > 1.f || abs(position[l].z) > 1.f;
+
+				position[l] = glm::clamp(position[l], glm::vec3(-1.f), glm::vec3(1.f));
+				points[l].push_back(position[l]);
+
+				time[l] = stepSize[l] < totalTime - time[l] ? time[l] + stepSize[l] : totalTime;
+
+				unsigned int steps = static_cast<unsigned int>(points[l].size() - 1u);
+				if (outside || (adaptive ? time[l] >= totalTime : steps == nSteps))
+				{
+					TrajectorySink::Trajectory trajectory = { points[l].front(), steps, outside };
+					sink.write(thread, particle[l], trajectory, points[l].data(), points[l].size());
+					finished |= 1ull << l;
+				}
+			}
+
+			// retire the masked lanes, moving the last live lane into each hole (its points by swapping buffers)
+			for (size_t l = nLanes; l-- > 0u;)
+			{
+				if (!(finished & (1ull << l)))
+					continue;
+
+				--nLanes;
+				position[l] = position[nLanes];
+				velocity[l] = velocity[nLanes];
+				h[l] = h[nLanes];
+				time[l] = time[nLanes];
+				particle[l] = particle[nLanes];
+				points[l].swap(points[nLanes]);
+			}
+		}
+	});
+
+	sink.end();
 }
 
 bool VectorFieldGenerator::checkSphereAdvection(
@@ -225,35 +1006,158 @@ bool VectorFieldGenerator::checkSphereAdvection(
 	float &timeToAdvectSphere,
 	float &distanceToAdvectSphere,
 	float &totalAdvectionDistance,
-	glm::vec3 &exitPoint
+	glm::vec3 &exitPoint,
+	const ParticleIntegrator &integrator,
+	bool stopAtExit
 )
 {
-	bool advected = false;
-	timeToAdvectSphere = -1.f;
-	float distanceCounter = distanceToAdvectSphere = 0.f;
-	glm::vec3 pt = exitPoint = sphereCenter; // start at the center of the field
-	for (float i = 0.f; i < totalTime; i += dt)
+	// start at the center of the field
+	std::vector<SphereExit> &sphere = m_vSphereQuery;
+	sphere.resize(1u);
+	sphere[0].center = sphereCenter;
+	sphere[0].radius = sphereRadius;
+
+	bool advected = checkSphereExits(dt, totalTime, sphereCenter, sphere, totalAdvectionDistance, integrator, stopAtExit) > 0u;
+
+	timeToAdvectSphere = sphere[0].time;
+	distanceToAdvectSphere = sphere[0].distance;
+	exitPoint = sphere[0].point;
+
+	return advected;
+}
+
+size_t VectorFieldGenerator::checkSphereExits(
+	float dt,
+	float totalTime,
+	glm::vec3 start,
+	std::vector<SphereExit> &spheres,
+	float &totalAdvectionDistance,
+	const ParticleIntegrator &integrator,
+	bool stopAtExit
+)
+{
+	size_t nExited = 0u;
+	float distanceCounter = 0.f;
+	glm::vec3 pt = start;
+
+	// spheres still to leave, and whether the particle is inside each yet
+	std::vector<size_t> &pending = m_vPendingSpheres;
+	std::vector<char> &inside = m_vInsideSpheres;
+	pending.clear();
+	inside.resize(spheres.size());
+	for (size_t s = 0u; s < spheres.size(); ++s)
 	{
-		// advect point by one timestep to get new point
-		glm::vec3 newPt = pt + dt * interpolate(pt);
+		spheres[s].exited = false;
+		spheres[s].time = -1.f;
+		spheres[s].distance = 0.f;
+		spheres[s].point = start;
+		inside[s] = glm::length(start - spheres[s].center) < spheres[s].radius;
+		pending.push_back(s);
+	}
+
+	// a sampled grid keeps the stencil of the particle's cell across steps
+	if (m_eAdvectionField != ADVECT_EXACT)
+		buildGrid();
+
+	CursorSampler cursorSampler(m_GridSampler);
+	const FieldEvaluator &field = m_eAdvectionField != ADVECT_EXACT ? static_cast<const FieldEvaluator&>(cursorSampler) : *m_pEvaluator;
 
-		distanceCounter += glm::length(newPt - pt);
+	ParticleIntegrator::Step step;
+	step.v0 = glm::vec3(0.f);
+	field.evaluate(&pt.x, 1u, &step.v0.x);
 
-		if (glm::length(newPt - sphereCenter) >= sphereRadius && !advected)
+	// takes the particle to the end of a step begun at time stepStart, locating the exits on the integrator's
+	// dense output; false once the integration can stop
+	auto advance = [&](float stepStart) {
+		float lastExit = 0.f;
+
+		for (size_t p = 0u; p < pending.size();)
 		{
-			advected = true;
-			timeToAdvectSphere = i;
-			distanceToAdvectSphere = distanceCounter;
+			SphereExit &sphere = spheres[pending[p]];
+
+			// an entry in this step moves the search for the exit past it
+			float from = 0.f, theta;
+			if (!inside[pending[p]])
+			{
+				if (!integrator.findSphereCrossing(step, sphere.center, sphere.radius, false, 0.f, from))
+				{
+					++p;
+					continue;
+				}
+				inside[pending[p]] = true;
+			}
 
-			exitPoint = lineSphereIntersection(pt, newPt, glm::vec3(0.f), sphereRadius);
+			if (!integrator.findSphereCrossing(step, sphere.center, sphere.radius, true, from, theta))
+			{
+				++p;
+				continue;
+			}
+
+			sphere.exited = true;
+			sphere.time = stepStart + theta * step.h;
+			sphere.distance = distanceCounter + integrator.arcLength(step, theta);
+			sphere.point = integrator.denseOutput(step, theta);
+			lastExit = std::max(lastExit, sphere.distance);
+			++nExited;
+
+			pending[p] = pending.back();
+			pending.pop_back();
+		}
+
+		if (stopAtExit && pending.empty())
+		{
+			distanceCounter = lastExit;
+			return false;
+		}
+
+		distanceCounter += integrator.arcLength(step, 1.f);
+
+		pt = step.x1;
+		step.v0 = step.v1;
+
+		return true;
+	};
+
+	float h = dt;
+
+	if (integrator.isAdaptive())
+	{
+		float time = 0.f;
+		while (time < totalTime)
+		{
+			step.x0 = step.x1 = pt;
+			step.v1 = step.v0;
+			step.h = std::min(h, totalTime - time);
+
+			// advect point by one accepted step to get new point
+			if (!integrator.step(field, 1u, &step.x1, &step.v1, &step.h, &h))
+				continue;
+
+			if (!advance(time))
+				break;
+
+			time = step.h < totalTime - time ? time + step.h : totalTime;
 		}
+	}
+	else
+	{
+		for (float i = 0.f; i < totalTime; i += dt)
+		{
+			step.x0 = step.x1 = pt;
+			step.v1 = step.v0;
+			step.h = dt;
+
+			// advect point by one timestep to get new point
+			integrator.step(field, 1u, &step.x1, &step.v1, &step.h, &h);
 
-		pt = newPt;
+			if (!advance(i))
+				break;
+		}
 	}
 
 	totalAdvectionDistance = distanceCounter;
 
-	return advected;
+	return nExited;
 }
 
 float VectorFieldGenerator::gaussianBasis(float radius, float eta)
@@ -263,6 +1167,8 @@ float VectorFieldGenerator::gaussianBasis(float radius, float eta)
 
 bool VectorFieldGenerator::save(std::string path)
 {
+	buildGrid();
+
 	FILE *exportFile;
 
 	printf("opening: %s\n", path.c_str());
@@ -309,27 +1215,40 @@ bool VectorFieldGenerator::save(std::string path)
 		fwrite(&n, sizeof(float), 1, exportFile);
 	}
 
-	for (int x = 0; x < m_uiGridResolution; x++)
+	// one record per node: validity flag followed by the vector
+	struct GridRecord {
+		int valid;
+		float u, v, w;
+	};
+
+	const float *gridU = m_Grid.getU();
+	const float *gridV = m_Grid.getV();
+	const float *gridW = m_Grid.getW();
+	size_t strideZ = m_Grid.getStrideZ();
+
+	// the file is ordered x-major, so gather one x-plane of records at a time and write it in a single call
+	std::vector<GridRecord> plane(m_uiGridResolution * m_uiGridResolution);
+
+	for (unsigned int x = 0; x < m_uiGridResolution; x++)
 	{
-		for (int y = 0; y < m_uiGridResolution; y++)
+		GridRecord *rec = plane.data();
+
+		for (unsigned int y = 0; y < m_uiGridResolution; y++)
 		{
-			for (int z = 0; z < m_uiGridResolution; z++)
-			{
-				glm::vec3 dir = m_v3DGridPairs[z][y][x].second;
+			size_t ind = m_Grid.index(x, y, 0u);
 
+			for (unsigned int z = 0; z < m_uiGridResolution; z++, ind += strideZ)
+			{
 				// Change from +y up to +z up
-				float u, v, w;
-				u = dir.x;  // EAST
-				v = -dir.z; // NORTH
-				w = dir.y;  // UP (SKY)
-
-				int one = 1;
-				fwrite(&one, sizeof(int), 1, exportFile); //just write out 1 (true) for all
-				fwrite(&u, sizeof(float), 1, exportFile); // U
-				fwrite(&v, sizeof(float), 1, exportFile); // V
-				fwrite(&w, sizeof(float), 1, exportFile); // W
+				rec->valid = 1; //just write out 1 (true) for all
+				rec->u = gridU[ind];  // EAST
+				rec->v = -gridW[ind]; // NORTH
+				rec->w = gridV[ind];  // UP (SKY)
+				++rec;
 			}//end for z
 		}//end for y
+
+		fwrite(plane.data(), sizeof(GridRecord), plane.size(), exportFile);
 	}//end for x
 
 	fclose(exportFile);
@@ -355,12 +1274,66 @@ bool VectorFieldGenerator::save(std::string path)
 	{
 		metaFile << "CP" << i << "_POINT," << m_vControlPoints[i].pos.x << "," << m_vControlPoints[i].pos.y << "," << m_vControlPoints[i].pos.z << std::endl;
 		metaFile << "CP" << i << "_DIRECTION," << m_vControlPoints[i].dir.x << "," << m_vControlPoints[i].dir.y << "," << m_vControlPoints[i].dir.z << std::endl;
-		metaFile << "CP" << i << "_LAMBDA," << m_vLambdaX[i] << "," << m_vLambdaY[i] << "," << m_vLambdaZ[i] << std::endl;
+
+		// a partition of unity, multilevel fit or kernel field has weights of its own
+		if (!usePartitionOfUnity() && !useMultilevel() && !m_pKernelField)
+			metaFile << "CP" << i << "_LAMBDA," << m_vLambdaX[i] << "," << m_vLambdaY[i] << "," << m_vLambdaZ[i] << std::endl;
 	}
 
+	writeKernelMetadata(metaFile);
+
 	metaFile.close();
 
 	printf("Exported FlowGrid metadata file to %s\n", metaFileName.c_str());
 
 	return true;
 }
+
+void VectorFieldGenerator::writeKernelMetadata(std::ofstream &metaFile) const
+{
+	const RBFSolver::Report &solveReport = getSolverReport();
+	if (m_pKernelField)
+	{
+		metaFile << "KERNEL_FIT,KERNEL_FIELD" << std::endl;
+		metaFile << "KERNEL_FIELD," << m_pKernelField->getBasisName() << "," << m_pKernelField->getScalarName() << "," << m_pKernelField->getFactorization() << std::endl;
+		metaFile << "KERNEL_SHAPE," << m_fGaussianShape << std::endl;
+		metaFile << "KERNEL_REGULARIZATION," << m_Solver.getRegularization() << std::endl;
+
+		// the basis and fit settings below do not apply
+		return;
+	}
+
+	metaFile << "KERNEL_BASIS," << (m_eBasisFunction == BASIS_WENDLAND_C2 ? "WENDLAND_C2" : m_eBasisFunction == BASIS_WENDLAND_C4 ? "WENDLAND_C4" : "GAUSSIAN") << std::endl;
+	if (m_eBasisFunction == BASIS_GAUSSIAN || useMultilevel())
+		metaFile << "KERNEL_SHAPE," << m_fGaussianShape << std::endl;
+	if (m_bShapeSelection && m_eBasisFunction == BASIS_GAUSSIAN)
+	{
+		metaFile << "KERNEL_SHAPE_SELECTION,LOOCV" << std::endl;
+		for (size_t c = 0u; c < m_vShapeCandidates.size(); ++c)
+			metaFile << "KERNEL_SHAPE_CANDIDATE" << c << "," << m_vShapeCandidates[c].eta << "," << m_vShapeCandidates[c].error << "," << m_vShapeCandidates[c].seconds << "," << RBFSolver::getMethodName(m_vShapeCandidates[c].method) << std::endl;
+	}
+	if (m_eBasisFunction != BASIS_GAUSSIAN && !useMultilevel())
+		metaFile << "KERNEL_SUPPORT_RADIUS," << m_fSupportRadius << std::endl;
+	if (useMultilevel())
+	{
+		const std::vector<MultilevelEvaluator::Level> &levels = m_MultilevelEvaluator.getLevels();
+
+		metaFile << "KERNEL_FIT,MULTILEVEL" << std::endl;
+		metaFile << "KERNEL_LEVELS," << levels.size() << std::endl;
+		for (size_t l = 0u; l < levels.size(); ++l)
+			metaFile << "KERNEL_LEVEL" << l << "," << levels[l].points << "," << levels[l].supportRadius << "," << levels[l].residual << std::endl;
+		metaFile << "KERNEL_REGULARIZATION," << m_Solver.getRegularization() << std::endl;
+	}
+	else if (usePartitionOfUnity())
+	{
+		metaFile << "KERNEL_FIT,PARTITION_OF_UNITY" << std::endl;
+		metaFile << "KERNEL_PATCHES," << m_PUEvaluator.getReport().patches << std::endl;
+		metaFile << "KERNEL_REGULARIZATION," << m_Solver.getRegularization() << std::endl;
+	}
+	else
+	{
+		metaFile << "KERNEL_SOLVER," << RBFSolver::getMethodName(solveReport.method) << std::endl;
+		metaFile << "KERNEL_REGULARIZATION," << solveReport.regularization << std::endl;
+		metaFile << "KERNEL_CONDITION_ESTIMATE," << solveReport.conditionEstimate << std::endl;
+	}
+}
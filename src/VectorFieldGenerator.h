@@ -2,24 +2,197 @@
 
 #include <vector>
 #include <random>
+#include <memory>
+#include <iosfwd>
 
 #include <glm/glm.hpp>
 
 #include <Eigen/Dense>
+#include <Eigen/Sparse>
+
+#include "RBFEvaluator.h"
+#include "GEMMEvaluator.h"
+#include "FGTEvaluator.h"
+#include "CompactRBFEvaluator.h"
+#include "PartitionOfUnityEvaluator.h"
+#include "MultilevelEvaluator.h"
+#include "KernelField.h"
+#include "FixedRBFEvaluator.h"
+#include "GridSampler.h"
+#include "ParticleIntegrator.h"
+#include "TrajectorySink.h"
+#include "RBFSolver.h"
+#include "ThreadPool.h"
+#include "VectorFieldGrid.h"
 
 class VectorFieldGenerator
 {
+public:
+	// How makeGrid fills the lattice
+	enum GridEvaluation {
+		GRID_DIRECT,    // full RBF sum at every node
+		GRID_SEPARABLE  // Gaussian factored into per-axis 1D exponentials (3R exps per CP instead of R^3)
+	};
+
+	// Engine behind evaluate(), used by direct grid construction, advection and queries
+	enum EvaluationEngine {
+		EVAL_DIRECT, // SIMD RBF sum per point (RBFEvaluator)
+		EVAL_GEMM,   // tiled basis matrix products (GEMMEvaluator)
+		EVAL_FGT     // Fast Gauss Transform within a set tolerance (FGTEvaluator); only faster for wide Gaussians and N >= ~10,000
+	};
+
+	// Radial basis of the field
+	enum BasisFunction {
+		BASIS_GAUSSIAN,    // global support, dense kernel; the only basis for the engines above and GRID_SEPARABLE
+		BASIS_WENDLAND_C2, // compact support: sparse kernel, evaluated through a spatial grid (CompactRBFEvaluator)
+		BASIS_WENDLAND_C4
+	};
+
+	// Field the particles of checkSphereAdvection and getAdvectedParticles move through
+	enum AdvectionField {
+		ADVECT_EXACT,     // the fitted field itself, through evaluate()
+		ADVECT_TRILINEAR, // the grid built by init(), sampled by GridSampler
+		ADVECT_TRICUBIC
+	};
+
+	// Leave-one-out error of one Gaussian shape candidate
+	struct ShapeCandidate {
+		float eta;
+		float error;           // RMS over all points and components; infinite if the factorization failed
+		double seconds;        // kernel assembly, factorization and error evaluation
+		RBFSolver::Method method;
+	};
+
+	// A sphere for checkSphereExits, and on return the first time the particle left it. A particle starting outside
+	// a sphere has to enter it first.
+	struct SphereExit {
+		glm::vec3 center;
+		float radius;
+		bool exited;
+		float time;            // -1 if it never left
+		float distance;        // path length from the start to the exit
+		glm::vec3 point;
+	};
+
+	// Shape selection cross-validates on a random subset of at most this many points
+	static const unsigned int SHAPE_SELECTION_MAX_POINTS = 1000u;
+
 public:	
 	VectorFieldGenerator();
 	~VectorFieldGenerator();
 
 	void init(unsigned int nControlPoints, unsigned int gridResolution);
 
-	bool checkSphereAdvection(float dt, float totalTime, glm::vec3 sphereCenter, float sphereRadius, float &timeToAdvect, float &distanceToAdvect, float &totalDistance, glm::vec3 &exitPoint);
-	std::vector<std::vector<glm::vec3>> getAdvectedParticles(int numParticles, float dt, float totalTime);
+	// Fit the field to given (e.g. measured) vectors at scattered positions instead of random control points
+	void init(const std::vector<glm::vec3> &positions, const std::vector<glm::vec3> &directions, unsigned int gridResolution);
+
+	// init() is fit() followed by buildGrid(). Fitting alone leaves the grid stale until buildGrid() or its first
+	// use (save(), getGrid(), grid advection, measureSamplingError()), so a field that is tested on the exact
+	// evaluator and thrown away never pays for a grid. Refits of the same size reuse the fit buffers.
+	void fit(unsigned int nControlPoints, unsigned int gridResolution);
+	void fit(const std::vector<glm::vec3> &positions, const std::vector<glm::vec3> &directions, unsigned int gridResolution);
+	void buildGrid();
+	bool isGridCurrent() const;
+
+	// Seed of the generator behind the random control points and advection seed points (random unless set); the
+	// same seed reproduces both, at any thread count
+	void setSeed(unsigned int seed);
+
+	// Number of threads used for grid construction and particle advection (0 = one per hardware core)
+	void setThreadCount(unsigned int nThreads);
+	unsigned int getThreadCount() const;
+
+	void setGridEvaluation(GridEvaluation mode);
+	GridEvaluation getGridEvaluation() const;
+
+	void setEvaluationEngine(EvaluationEngine engine);
+	EvaluationEngine getEvaluationEngine() const;
+
+	// Error tolerance of EVAL_FGT, relative to the sum of |lambda|
+	void setFGTTolerance(float tolerance);
+
+	// Fit the Gaussian field as overlapping patches with independent local solves instead of one global
+	// solve (see PartitionOfUnityEvaluator); patchesPerAxis = 0 sizes the lattice from the point density.
+	// Takes effect at the next init() and is ignored for the Wendland bases, which are local already.
+	void setPartitionOfUnity(bool enable, unsigned int patchesPerAxis = 0u, float overlap = 1.5f);
+	const PartitionOfUnityEvaluator::Report& getPartitionOfUnityReport() const;
+
+	// Fit coarse to fine instead: a Gaussian level on a small subsample, then Wendland levels with shrinking support
+	// on ever more points, each fitting the residual of the levels above (see MultilevelEvaluator). levels = 0 picks
+	// the count from the number of points. Takes effect at the next init() and overrides the partition of unity.
+	void setMultilevel(bool enable, unsigned int levels = 0u);
+	const std::vector<MultilevelEvaluator::Level>& getMultilevelLevels() const;
+	double getMultilevelSeconds() const;
+
+	// Fit with a compile-time specialized basis and scalar type instead (see KernelField::create for the names),
+	// e.g. "imq" in "double" for a kernel too ill-conditioned for float. It takes precedence over the basis and
+	// fit settings above and uses the Gaussian shape as its eta. An empty basis returns to them; unknown names
+	// return false. Takes effect at the next init().
+	bool setKernelField(const std::string &basis, const std::string &scalar);
+	const KernelField* getKernelField() const;
+
+	// Change the vectors at some control points and refit; with a partition of unity only the patches
+	// containing them are re-solved
+	void updateControlPoints(const std::vector<unsigned int> &indices, const std::vector<glm::vec3> &directions);
+
+	// Shape parameter eta of the Gaussian exp(-eta * r^2), used unless it is selected automatically
+	void setGaussianShape(float eta);
+	float getGaussianShape() const; // the one in use, possibly selected
+
+	// Pick eta at every fit from candidates log-spaced over [etaMin, etaMax], by the smallest leave-one-out error
+	// (Rippa's formula, one factorization per candidate, candidates swept on the thread pool)
+	void setShapeSelection(bool automatic, float etaMin = 0.1f, float etaMax = 100.f, unsigned int candidates = 16u);
+	const std::vector<ShapeCandidate>& getShapeCandidates() const;
+
+	// The support radius only applies to the Wendland bases; takes effect at the next init()
+	void setBasisFunction(BasisFunction basis, float supportRadius = 1.f);
+	BasisFunction getBasisFunction() const;
+
+	// Factorization used for the kernel system and optional Tikhonov regularization of its diagonal. With the default
+	// METHOD_LLT, plain Gaussian fits with the direct engine go through the allocation-free fixed-size LLT -> LDLT -> LU
+	// instead where FixedRBFEvaluatorBase::isFasterFor() holds; any other method is always used as set.
+	void setSolverMethod(RBFSolver::Method method);
+	void setRegularization(float mu);
+	void setSolverTolerance(float tolerance, unsigned int maxIterations); // METHOD_CG only
+	const RBFSolver::Report& getSolverReport() const;
+
+	// Advect through the grid instead of the exact field: far cheaper per step for large fits, at the error
+	// measureSamplingError() reports; the grid resolution given to init() or fit() sets both
+	void setAdvectionField(AdvectionField field);
+	AdvectionField getAdvectionField() const;
+
+	// Sampled grid against the exact field at random points (the grid from the last init)
+	GridSampler::ErrorReport measureSamplingError(GridSampler::Interpolation interpolation, size_t nSamples = 100000u);
+
+	// Both advect with the given integrator (forward Euler by default); dt is its step, or the first step it
+	// tries if it adapts the step. Fixed steps run the float loop i = 0, dt, 2 dt, ... < totalTime, while an
+	// adaptive integrator ends on totalTime exactly and adds a trajectory point per accepted step.
+	// checkSphereAdvection locates the exit time and point by root finding on the integrator's dense output, so
+	// they stay accurate with large steps. With stopAtExit it ends the integration there (only the acceptance is
+	// wanted), and totalDistance then only covers the path up to the exit.
+	bool checkSphereAdvection(float dt, float totalTime, glm::vec3 sphereCenter, float sphereRadius, float &timeToAdvect, float &distanceToAdvect, float &totalDistance, glm::vec3 &exitPoint, const ParticleIntegrator &integrator = ParticleIntegrator(), bool stopAtExit = false);
+	// checkSphereExits does the same for any number of spheres in one integration from start, each step testing
+	// only the spheres it can cross; with stopAtExit it ends once the particle has left them all. Returns the
+	// number of spheres left.
+	size_t checkSphereExits(float dt, float totalTime, glm::vec3 start, std::vector<SphereExit> &spheres, float &totalDistance, const ParticleIntegrator &integrator = ParticleIntegrator(), bool stopAtExit = false);
+	// getAdvectedParticles writes one trajectory per particle from a random seed in the cube to the sink, each as
+	// soon as it finishes: a TrajectorySet keeps them all, a TrajectoryWriter streams them to a file
+	void getAdvectedParticles(int numParticles, float dt, float totalTime, TrajectorySink &sink, const ParticleIntegrator &integrator = ParticleIntegrator());
+
+	// Evaluate the field at n points given as packed xyz triples; out receives n packed xyz vectors
+	void evaluate(const float *xyz, size_t n, float *out) const;
+
+	// As evaluate(), plus the 3x3 Jacobian d out_c / d x_d per point, row-major in jacobian (9 floats per point).
+	// Analytic in the same pass for the direct SIMD engine, the fixed-size path and the kernel fields; the GEMM
+	// and FGT engines, the compactly supported, multilevel and partition of unity fits use FieldEvaluator's
+	// central differences.
+	void evaluateJacobian(const float *xyz, size_t n, float *out, float *jacobian) const;
 
 	bool save(std::string path);
 
+	// Built first if a fit() left it stale
+	const VectorFieldGrid& getGrid();
+
 private:
 	struct ControlPoint {
 		glm::vec3 pos;
@@ -31,18 +204,69 @@ private:
 	std::uniform_real_distribution<float> m_Distribuion;
 
 	std::vector<ControlPoint> m_vControlPoints;
+	std::vector<glm::vec3> m_vFitPositions; // CP positions the current lambdas were solved for
+	std::vector<glm::vec3> m_vPositionScratch; // next fit's positions, swapped with m_vFitPositions
 
 	unsigned int m_uiGridResolution;
+	bool m_bGridCurrent; // m_Grid holds the current fit
+	GridEvaluation m_eGridEvaluation;
 	float m_fGaussianShape;
+	float m_fShapeParameter; // fixed shape, copied to m_fGaussianShape by init()
+	bool m_bShapeSelection;
+	float m_fShapeMin, m_fShapeMax;
+	unsigned int m_uiShapeCandidates;
+	std::vector<ShapeCandidate> m_vShapeCandidates;
+	BasisFunction m_eBasisFunction;
+	float m_fSupportRadius;
 	Eigen::MatrixXf m_matControlPointKernel;
+	Eigen::SparseMatrix<float> m_matSparseKernel;
 	Eigen::VectorXf m_vCPXVals, m_vCPYVals, m_vCPZVals;
 	Eigen::VectorXf m_vLambdaX, m_vLambdaY, m_vLambdaZ;
-	std::vector<std::vector<std::vector<std::pair<glm::vec3, glm::vec3>>>> m_v3DGridPairs;
+	Eigen::MatrixXf m_matFitValues, m_matFitWeights; // N x 3 right-hand side and solution of the last fit
+	RBFSolver m_Solver;
+	VectorFieldGrid m_Grid;
+	std::vector<float> m_vGridFactors; // separable grid: 1D Gaussian factors, x, y and z tables of nCPs x res
+	std::vector<float> m_vGridCoefficients; // separable grid: per-thread slice coefficients, 3 x res x nCPs each
+	std::vector<SphereExit> m_vSphereQuery; // checkSphereAdvection's sphere
+	std::vector<size_t> m_vPendingSpheres; // checkSphereExits scratch, kept across calls so a retry loop does not allocate
+	std::vector<char> m_vInsideSpheres;
+	std::vector<std::vector<glm::vec3>> m_vAdvectionLanes; // getAdvectedParticles: points of each packet lane, per thread, kept across calls
+
+	EvaluationEngine m_eEvaluationEngine;
+	RBFEvaluator m_RBFEvaluator;
+	GEMMEvaluator m_GEMMEvaluator;
+	FGTEvaluator m_FGTEvaluator;
+	float m_fFGTTolerance;
+	CompactRBFEvaluator m_CompactEvaluator;
+	PartitionOfUnityEvaluator m_PUEvaluator;
+	bool m_bPartitionOfUnity;
+	unsigned int m_uiPatchesPerAxis;
+	float m_fPatchOverlap;
+	MultilevelEvaluator m_MultilevelEvaluator;
+	bool m_bMultilevel;
+	unsigned int m_uiLevels;
+	std::unique_ptr<KernelField> m_pKernelField;
+	std::unique_ptr<FixedRBFEvaluatorBase> m_pFixedEvaluator;
+	const FieldEvaluator *m_pEvaluator;
+	AdvectionField m_eAdvectionField;
+	GridSampler m_GridSampler;
+
+	std::unique_ptr<ThreadPool> m_pThreadPool;
 
 private:
 	void createControlPoints(unsigned int nControlPoints);
+	void fitControlPoints();
+	void fitFixedControlPoints();
+	bool useFixedKernel() const;
+	float selectGaussianShape(const std::vector<glm::vec3> &positions, const Eigen::MatrixXf &values);
+	bool usePartitionOfUnity() const;
+	bool useMultilevel() const;
+	void updateEvaluator();
 	void makeGrid(unsigned int resolution, float gaussianShape = 1.f);
-	glm::vec3 interpolate(glm::vec3 pt);
+	void makeGridDirect();
+	void makeGridSeparable();
+	const FieldEvaluator& getAdvectionEvaluator() const;
 	float gaussianBasis(float r, float eta);
+	void writeKernelMetadata(std::ofstream &metaFile) const;
 };
 
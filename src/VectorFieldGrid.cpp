@@ -0,0 +1,98 @@
+#include "VectorFieldGrid.h"
+
+#include <cstdint>
+#include <algorithm>
+
+namespace
+{
+	const size_t ALIGNMENT_FLOATS = 16u; // 64 bytes
+}
+
+VectorFieldGrid::VectorFieldGrid()
+	: m_pU(NULL)
+	, m_pV(NULL)
+	, m_pW(NULL)
+	, m_uiResolution(0u)
+	, m_nNodes(0u)
+	, m_vec3Origin(0.f)
+	, m_fSpacing(0.f)
+{
+}
+
+VectorFieldGrid::~VectorFieldGrid()
+{
+}
+
+VectorFieldGrid::VectorFieldGrid(const VectorFieldGrid &other)
+	: VectorFieldGrid()
+{
+	*this = other;
+}
+
+VectorFieldGrid::VectorFieldGrid(VectorFieldGrid &&other)
+	: VectorFieldGrid()
+{
+	*this = std::move(other);
+}
+
+VectorFieldGrid& VectorFieldGrid::operator=(const VectorFieldGrid &other)
+{
+	if (this == &other)
+		return *this;
+
+	resize(other.m_uiResolution, other.m_vec3Origin, other.m_fSpacing);
+
+	if (m_nNodes > 0u)
+	{
+		std::copy(other.m_pU, other.m_pU + m_nNodes, m_pU);
+		std::copy(other.m_pV, other.m_pV + m_nNodes, m_pV);
+		std::copy(other.m_pW, other.m_pW + m_nNodes, m_pW);
+	}
+
+	return *this;
+}
+
+VectorFieldGrid& VectorFieldGrid::operator=(VectorFieldGrid &&other)
+{
+	if (this == &other)
+		return *this;
+
+	// moving a vector keeps its buffer, so the pointers stay valid
+	m_vStorage = std::move(other.m_vStorage);
+	m_pU = other.m_pU;
+	m_pV = other.m_pV;
+	m_pW = other.m_pW;
+	m_uiResolution = other.m_uiResolution;
+	m_nNodes = other.m_nNodes;
+	m_vec3Origin = other.m_vec3Origin;
+	m_fSpacing = other.m_fSpacing;
+
+	other.m_vStorage.clear();
+	other.m_pU = other.m_pV = other.m_pW = NULL;
+	other.m_uiResolution = 0u;
+	other.m_nNodes = 0u;
+
+	return *this;
+}
+
+void VectorFieldGrid::resize(unsigned int resolution, glm::vec3 origin, float spacing)
+{
+	m_uiResolution = resolution;
+	m_nNodes = static_cast<size_t>(resolution) * resolution * resolution;
+	m_vec3Origin = origin;
+	m_fSpacing = spacing;
+
+	// pad each component array so all three start on an alignment boundary
+	size_t plane = ((m_nNodes + ALIGNMENT_FLOATS - 1u) / ALIGNMENT_FLOATS) * ALIGNMENT_FLOATS;
+
+	// vector::resize never gives memory back, so a same-size (or smaller) grid reuses the buffer
+	m_vStorage.resize(3u * plane + ALIGNMENT_FLOATS);
+
+	uintptr_t addr = reinterpret_cast<uintptr_t>(m_vStorage.data());
+	uintptr_t alignBytes = ALIGNMENT_FLOATS * sizeof(float);
+	size_t offset = ((alignBytes - addr % alignBytes) % alignBytes) / sizeof(float);
+
+	m_pU = m_vStorage.data() + offset;
+	m_pV = m_pU + plane;
+	m_pW = m_pV + plane;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Regular cubic grid of 3D vectors stored as three contiguous component arrays (u, v, w) in a
+// single aligned allocation. Node positions are implicit: origin + spacing * (x, y, z).
+// Nodes are laid out x-fastest, so the strides are 1 along x, R along y and R^2 along z.
+class VectorFieldGrid
+{
+public:
+	VectorFieldGrid();
+	~VectorFieldGrid();
+
+	// The component pointers point into the storage, so a copy re-derives them for its own buffer (whose
+	// alignment offset may differ) and a move takes them along with the buffer
+	VectorFieldGrid(const VectorFieldGrid &other);
+	VectorFieldGrid(VectorFieldGrid &&other);
+	VectorFieldGrid& operator=(const VectorFieldGrid &other);
+	VectorFieldGrid& operator=(VectorFieldGrid &&other);
+
+	// Storage is only reallocated when the node count grows, so re-running with the same resolution is allocation-free
+	void resize(unsigned int resolution, glm::vec3 origin, float spacing);
+
+	unsigned int getResolution() const { return m_uiResolution; }
+	size_t getNodeCount() const { return m_nNodes; }
+	glm::vec3 getOrigin() const { return m_vec3Origin; }
+	float getSpacing() const { return m_fSpacing; }
+
+	size_t getStrideX() const { return 1u; }
+	size_t getStrideY() const { return m_uiResolution; }
+	size_t getStrideZ() const { return static_cast<size_t>(m_uiResolution) * m_uiResolution; }
+
+	size_t index(unsigned int x, unsigned int y, unsigned int z) const
+	{
+		return (static_cast<size_t>(z) * m_uiResolution + y) * m_uiResolution + x;
+	}
+
+	glm::vec3 getPosition(unsigned int x, unsigned int y, unsigned int z) const
+	{
+		return m_vec3Origin + m_fSpacing * glm::vec3(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z));
+	}
+
+	glm::vec3 get(size_t ind) const { return glm::vec3(m_pU[ind], m_pV[ind], m_pW[ind]); }
+	glm::vec3 get(unsigned int x, unsigned int y, unsigned int z) const { return get(index(x, y, z)); }
+
+	void set(size_t ind, const glm::vec3 &val) { m_pU[ind] = val.x; m_pV[ind] = val.y; m_pW[ind] = val.z; }
+	void set(unsigned int x, unsigned int y, unsigned int z, const glm::vec3 &val) { set(index(x, y, z), val); }
+
+	// Raw component arrays, each getNodeCount() long and 64-byte aligned
+	float* getU() { return m_pU; }
+	float* getV() { return m_pV; }
+	float* getW() { return m_pW; }
+	const float* getU() const { return m_pU; }
+	const float* getV() const { return m_pV; }
+	const float* getW() const { return m_pW; }
+
+	size_t getMemoryUsage() const { return m_vStorage.capacity() * sizeof(float); }
+
+private:
+	std::vector<float> m_vStorage;
+	float *m_pU, *m_pV, *m_pW;
+
+	unsigned int m_uiResolution;
+	size_t m_nNodes;
+	glm::vec3 m_vec3Origin;
+	float m_fSpacing;
+};